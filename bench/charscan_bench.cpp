@@ -0,0 +1,176 @@
+//
+// Created by Park Yu on 2024/12/16.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "charscan.h"
+#include "preprocessor.h"
+#include "lexer.h"
+#include "intern.h"
+
+//bytes of every in memory buffer
+#define BUFFER_SIZE (16 * 1024 * 1024)
+#define ROUND_COUNT 5
+#define LONG_WORD_LENGTH 200
+#define LONG_STRING_LENGTH 400
+#define INDENT_LENGTH 24
+#define LINE_COUNT 40000
+
+enum RunKind {
+    RUN_WORD,
+    RUN_STRING,
+    RUN_BLANK,
+};
+
+static const CharScanLevel levels[] = {CHAR_SCAN_SCALAR, CHAR_SCAN_SSE2, CHAR_SCAN_AVX2, CHAR_SCAN_NEON};
+
+/**
+ * runs of word bytes of runLength, each closed by separator, the buffer is null terminated like the lexer's text.
+ */
+static char *createRuns(uint32_t runLength, char separator) {
+    char *buffer = (char *) malloc(BUFFER_SIZE + 1);
+    for (uint32_t i = 0; i < BUFFER_SIZE; i++) {
+        uint32_t offset = i % (runLength + 1);
+        buffer[i] = offset == runLength ? separator : (char) ('a' + offset % 26);
+    }
+    buffer[BUFFER_SIZE] = '\0';
+    return buffer;
+}
+
+static char *createIndents() {
+    char *buffer = (char *) malloc(BUFFER_SIZE + 1);
+    for (uint32_t i = 0; i < BUFFER_SIZE; i++) {
+        uint32_t offset = i % (INDENT_LENGTH + 2);
+        buffer[i] = offset == INDENT_LENGTH ? 'x' : offset == INDENT_LENGTH + 1 ? '\n' : ' ';
+    }
+    buffer[BUFFER_SIZE] = '\0';
+    return buffer;
+}
+
+/**
+ * walk the whole buffer the way the lexer does, one call per run and one step over the byte that ended it.
+ */
+static uint64_t walk(RunKind kind, const char *buffer) {
+    uint64_t stops = 0;
+    uint32_t position = 0;
+    while (position < BUFFER_SIZE) {
+        switch (kind) {
+            case RUN_WORD:
+                position = charScanner.skipWord(buffer, position, BUFFER_SIZE);
+                break;
+            case RUN_STRING:
+                position = charScanner.skipQuoted(buffer, position, BUFFER_SIZE, '"');
+                break;
+            case RUN_BLANK:
+                position = charScanner.skipBlanks(buffer, position, BUFFER_SIZE);
+                break;
+        }
+        position++;
+        stops++;
+    }
+    return stops;
+}
+
+static void benchScan(const char *name, RunKind kind, const char *buffer) {
+    for (CharScanLevel level: levels) {
+        if (!setCharScanLevel(level)) {
+            continue;
+        }
+        double bestMs = 0;
+        uint64_t stops = 0;
+        for (int round = 0; round < ROUND_COUNT; round++) {
+            auto start = std::chrono::steady_clock::now();
+            stops = walk(kind, buffer);
+            auto end = std::chrono::steady_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (round == 0 || ms < bestMs) {
+                bestMs = ms;
+            }
+        }
+        printf("%s %s: %llu stops, %.2f ms, %.1f MB/s\n", name, getCharScanLevelName(level),
+               (unsigned long long) stops, bestMs, BUFFER_SIZE / (1024.0 * 1024) * 1000 / bestMs);
+    }
+}
+
+static FILE *createFile(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "can not create %s\n", path);
+        exit(-1);
+    }
+    return file;
+}
+
+/**
+ * what the generators feed us: long identifiers and a big table of long string literals.
+ */
+static void generateSource(const char *path) {
+    FILE *file = createFile(path);
+    char word[LONG_WORD_LENGTH + 1];
+    char text[LONG_STRING_LENGTH + 1];
+    for (int i = 0; i < LONG_WORD_LENGTH; i++) {
+        word[i] = i % 37 == 36 ? '_' : (char) ('a' + i % 26);
+    }
+    word[LONG_WORD_LENGTH] = '\0';
+    for (int i = 0; i < LONG_STRING_LENGTH; i++) {
+        text[i] = i % 8 == 7 ? ' ' : (char) ('A' + i % 26);
+    }
+    text[LONG_STRING_LENGTH] = '\0';
+    for (int i = 0; i < LINE_COUNT; i++) {
+        fprintf(file, "        char *%s_%d = \"%s\\n\";\n", word, i, text);
+    }
+    fclose(file);
+}
+
+static void benchLexer(const char *path) {
+    for (CharScanLevel level: levels) {
+        if (!setCharScanLevel(level)) {
+            continue;
+        }
+        double bestMs = 0;
+        size_t size = 0;
+        uint64_t tokenCount = 0;
+        for (int round = 0; round < ROUND_COUNT; round++) {
+            ProcessedSource *source = preprocess(path);
+            auto start = std::chrono::steady_clock::now();
+            TokenList *tokens = buildTokens(source);
+            auto end = std::chrono::steady_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (round == 0 || ms < bestMs) {
+                bestMs = ms;
+            }
+            size = source->size;
+            tokenCount = tokens->count;
+            releasePreProcessorMemory();
+            releaseLexerMemory();
+            releaseInternMemory();
+        }
+        double mb = (double) size / (1024 * 1024);
+        printf("lexer %s: %.1f MB, %llu tokens: %.2f ms, %.1f MB/s\n", getCharScanLevelName(level), mb,
+               (unsigned long long) tokenCount, bestMs, mb * 1000 / bestMs);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "charscan_bench.c";
+    CharScanLevel best = getCharScanLevel();
+    printf("dispatch picked %s\n", getCharScanLevelName(best));
+
+    char *buffer = createRuns(LONG_WORD_LENGTH, ' ');
+    benchScan("words", RUN_WORD, buffer);
+    free(buffer);
+    buffer = createRuns(LONG_STRING_LENGTH, '"');
+    benchScan("strings", RUN_STRING, buffer);
+    free(buffer);
+    buffer = createIndents();
+    benchScan("blanks", RUN_BLANK, buffer);
+    free(buffer);
+
+    generateSource(path);
+    benchLexer(path);
+    remove(path);
+    setCharScanLevel(best);
+    return 0;
+}
@@ -0,0 +1,90 @@
+//
+// Created by Park Yu on 2024/12/6.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "file.h"
+
+//50MB image: two 25MB sections with page padding and a patched header
+#define SECTION_SIZE (25 * 1024 * 1024 - 1000)
+#define PAGE_SIZE 4096
+#define HEADER_SIZE 512
+#define ROUND_COUNT 5
+
+static double writeImage(const char *path, FileOutputMode mode, const char *text, const char *data) {
+    auto start = std::chrono::steady_clock::now();
+    setFileOutputMode(mode);
+    openFile(path);
+    uint64_t finalSize = alignTo(alignTo(PAGE_SIZE, PAGE_SIZE) + SECTION_SIZE, PAGE_SIZE) + SECTION_SIZE;
+    presizeFile(finalSize);
+    uint64_t headerOffset = reserveFile(HEADER_SIZE);
+    writeEmptyAlignment(PAGE_SIZE);
+    uint64_t textOffset = getCurrentFileOffset();
+    writeFileB(text, SECTION_SIZE);
+    writeEmptyAlignment(PAGE_SIZE);
+    uint64_t dataOffset = getCurrentFileOffset();
+    writeFileB(data, SECTION_SIZE);
+    uint64_t header[2] = {textOffset, dataOffset};
+    writeFileAt(headerOffset, header, sizeof(header));
+    closeFile();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static bool verifyImage(const char *path, const char *text, const char *data) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *content = (char *) malloc(size);
+    bool ok = fread(content, 1, size, file) == (size_t) size;
+    fclose(file);
+    uint64_t header[2];
+    memcpy(header, content, sizeof(header));
+    ok = ok && size == (long) (header[1] + SECTION_SIZE);
+    ok = ok && memcmp(content + header[0], text, SECTION_SIZE) == 0;
+    ok = ok && memcmp(content + header[1], data, SECTION_SIZE) == 0;
+    for (uint64_t i = sizeof(header); ok && i < header[0]; i++) {
+        ok = content[i] == 0;
+    }
+    free(content);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "file_bench.out";
+    char *text = (char *) malloc(SECTION_SIZE);
+    char *data = (char *) malloc(SECTION_SIZE);
+    for (int i = 0; i < SECTION_SIZE; i++) {
+        text[i] = (char) (i * 31 + 7);
+        data[i] = (char) (i * 17 + 3);
+    }
+    const char *modeNames[] = {"buffered", "mmap"};
+    FileOutputMode modes[] = {OUTPUT_BUFFERED, OUTPUT_MMAP};
+    for (int m = 0; m < 2; m++) {
+        //first round warms up the page cache
+        writeImage(path, modes[m], text, data);
+        double best = 0;
+        for (int r = 0; r < ROUND_COUNT; r++) {
+            double ms = writeImage(path, modes[m], text, data);
+            if (r == 0 || ms < best) {
+                best = ms;
+            }
+        }
+        bool ok = verifyImage(path, text, data);
+        double mb = (double) (2 * SECTION_SIZE + PAGE_SIZE) / (1024 * 1024);
+        printf("%-9s %6.1f MB %8.2f ms %8.1f MB/s %s\n", modeNames[m], mb, best, mb * 1000 / best,
+               ok ? "ok" : "CORRUPTED");
+        if (!ok) {
+            return -1;
+        }
+    }
+    remove(path);
+    return 0;
+}
@@ -0,0 +1,126 @@
+//
+// Created by Park Yu on 2024/12/13.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "preprocessor.h"
+#include "lexer.h"
+#include "intern.h"
+
+#define FUNCTION_COUNT 20000
+#define LONG_WORD_LINE_COUNT 4000
+//best of, the first round also pays for faulting in fresh memory
+#define ROUND_COUNT 5
+#define LONG_WORD_LENGTH 1000
+
+static FILE *createFile(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "can not create %s\n", path);
+        exit(-1);
+    }
+    return file;
+}
+
+/**
+ * ordinary code: declarations, expressions, calls and string literals, 10 lines per function.
+ */
+static void generateSource(const char *path) {
+    FILE *file = createFile(path);
+    for (int i = 0; i < FUNCTION_COUNT; i++) {
+        fprintf(file, "int method%d(int left, char *buffer, long count) {\n", i);
+        fprintf(file, "    int value%d = left * %d + count - (left / 3);\n", i, i);
+        fprintf(file, "    char *message = \"method %d says \\\"hello\\\"\\n\";\n", i);
+        fprintf(file, "    if (value%d >= %d && left != 0 || count <= 1) {\n", i, i);
+        fprintf(file, "        value%d = method%d(value%d, message, %d);\n", i, i / 2, i, i);
+        fprintf(file, "    }\n");
+        fprintf(file, "    while (value%d > 0) {\n", i);
+        fprintf(file, "        value%d = value%d - 1;\n", i, i);
+        fprintf(file, "    }\n");
+        fprintf(file, "    return value%d;\n}\n", i);
+    }
+    fclose(file);
+}
+
+/**
+ * identifiers and string literals of LONG_WORD_LENGTH bytes, the old scanner copied every word once per character.
+ */
+static void generateLongWordSource(const char *path) {
+    FILE *file = createFile(path);
+    char *word = (char *) malloc(LONG_WORD_LENGTH + 1);
+    for (int i = 0; i < LONG_WORD_LENGTH; i++) {
+        word[i] = 'a' + i % 26;
+    }
+    word[LONG_WORD_LENGTH] = '\0';
+    for (int i = 0; i < LONG_WORD_LINE_COUNT; i++) {
+        fprintf(file, "char *%s%d = \"%s\";\n", word, i, word);
+    }
+    free(word);
+    fclose(file);
+}
+
+static void bench(const char *name, const char *path) {
+    double bestMs = 0;
+    double bestStreamMs = 0;
+    uint64_t tokenCount = 0;
+    uint32_t lineCount = 0;
+    size_t size = 0;
+    InternStat internStat;
+    for (int round = 0; round < ROUND_COUNT; round++) {
+        ProcessedSource *source = preprocess(path);
+        auto start = std::chrono::steady_clock::now();
+        TokenList *tokens = buildTokens(source);
+        auto end = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        if (round == 0 || ms < bestMs) {
+            bestMs = ms;
+        }
+        tokenCount = tokens->count;
+        lineCount = source->lineCount;
+        size = source->size;
+        getInternStat(&internStat);
+        releasePreProcessorMemory();
+        releaseLexerMemory();
+        releaseInternMemory();
+
+        //the parser's path: the same window all along, no array of every token to fault in
+        source = preprocess(path);
+        start = std::chrono::steady_clock::now();
+        TokenStream *stream = openTokenStream(source, nullptr, false);
+        Token *token = stream->window;
+        while (token->tokenType != TOKEN_END) {
+            token = advanceTokenStream(stream, token);
+        }
+        end = std::chrono::steady_clock::now();
+        ms = std::chrono::duration<double, std::milli>(end - start).count();
+        if (round == 0 || ms < bestStreamMs) {
+            bestStreamMs = ms;
+        }
+        releasePreProcessorMemory();
+        releaseLexerMemory();
+        releaseInternMemory();
+    }
+    double mb = (double) size / (1024 * 1024);
+    printf("%s: %u lines, %.1f MB, %llu tokens: %.2f ms, %.1f MB/s, %.1f M tokens/s\n",
+           name, lineCount, mb, (unsigned long long) tokenCount, bestMs, mb * 1000 / bestMs,
+           tokenCount / bestMs / 1000);
+    printf("%s, streamed: %.2f ms, %.1f MB/s, %.1f M tokens/s\n",
+           name, bestStreamMs, mb * 1000 / bestStreamMs, tokenCount / bestStreamMs / 1000);
+    printf("%s: %u interned strings, %.1f KB, %llu lookups, %.2f probes per lookup\n",
+           name, internStat.stringCount, internStat.stringBytes / 1024.0, (unsigned long long) internStat.lookups,
+           internStat.lookups == 0 ? 0.0 : (double) internStat.probes / internStat.lookups);
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "lexer_bench.c";
+    generateSource(path);
+    bench("code", path);
+    remove(path);
+
+    generateLongWordSource(path);
+    bench("long words", path);
+    remove(path);
+    return 0;
+}
@@ -0,0 +1,126 @@
+//
+// Created by Park Yu on 2024/12/4.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "mspace.h"
+
+#define THREAD_COUNT 16
+#define ROUND_COUNT 8
+#define ALLOC_PER_ROUND 50000
+
+struct BenchNode {
+    long owner;
+    long index;
+    BenchNode *next;
+};
+
+/**
+ * every worker forks its own space from the shared parent, builds a list of nodes,
+ * frees every fourth node to exercise the free lists, verifies the rest and hands the space off.
+ */
+static void worker(MemSpace *parent, long owner, long *corrupted) {
+    for (int round = 0; round < ROUND_COUNT; round++) {
+        MemSpace *space = pccForkSpace(parent);
+        BenchNode *head = nullptr;
+        for (long i = 0; i < ALLOC_PER_ROUND; i++) {
+            BenchNode *node = pccNew<BenchNode>(space);
+            node->owner = owner;
+            node->index = i;
+            if (i % 4 == 3) {
+                pccSpaceFree(space, node);
+                continue;
+            }
+            node->next = head;
+            head = node;
+            //odd sized strings land in the other size classes
+            char *text = pccNewArray<char>(space, 1 + (i % 61));
+            text[0] = (char) owner;
+        }
+        for (BenchNode *p = head; p != nullptr; p = p->next) {
+            if (p->owner != owner) {
+                (*corrupted)++;
+            }
+        }
+        pccHandoffSpace(space);
+    }
+}
+
+static double runSpaces() {
+    MemSpace *parent = pccCreateSpace("bench");
+    long corrupted[THREAD_COUNT] = {0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (long i = 0; i < THREAD_COUNT; i++) {
+        threads.emplace_back(worker, parent, i, &corrupted[i]);
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    MemSpaceStat stat;
+    pccGetSpaceStat(parent, &stat);
+    auto end = std::chrono::steady_clock::now();
+    long totalCorrupted = 0;
+    for (long i = 0; i < THREAD_COUNT; i++) {
+        totalCorrupted += corrupted[i];
+    }
+    printf("spaces: blocks=%zu used=%zuKB reserved=%zuKB corrupted=%ld\n",
+           stat.blockCount, stat.usedBytes / 1024, stat.reservedBytes / 1024, totalCorrupted);
+    pccDestroySpace(parent);
+    if (totalCorrupted != 0) {
+        exit(-1);
+    }
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void mallocWorker(long owner, std::vector<void *> *blocks) {
+    for (int round = 0; round < ROUND_COUNT; round++) {
+        for (long i = 0; i < ALLOC_PER_ROUND; i++) {
+            BenchNode *node = (BenchNode *) calloc(1, sizeof(BenchNode));
+            node->owner = owner;
+            if (i % 4 == 3) {
+                free(node);
+                continue;
+            }
+            blocks->push_back(node);
+            char *text = (char *) calloc(1, 1 + (i % 61));
+            text[0] = (char) owner;
+            blocks->push_back(text);
+        }
+    }
+}
+
+static double runMalloc() {
+    std::vector<void *> blocks[THREAD_COUNT];
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (long i = 0; i < THREAD_COUNT; i++) {
+        blocks[i].reserve(ROUND_COUNT * ALLOC_PER_ROUND * 2);
+        threads.emplace_back(mallocWorker, i, &blocks[i]);
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    for (long i = 0; i < THREAD_COUNT; i++) {
+        for (void *block: blocks[i]) {
+            free(block);
+        }
+    }
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main() {
+    double allocCount = (double) THREAD_COUNT * ROUND_COUNT * ALLOC_PER_ROUND * 7 / 4;
+    double spaceMs = runSpaces();
+    double mallocMs = runMalloc();
+    printf("%d threads, %.0f allocations\n", THREAD_COUNT, allocCount);
+    printf("mspace: %8.2f ms %6.2f ns/alloc\n", spaceMs, spaceMs * 1e6 / allocCount);
+    printf("calloc: %8.2f ms %6.2f ns/alloc\n", mallocMs, mallocMs * 1e6 / allocCount);
+    return 0;
+}
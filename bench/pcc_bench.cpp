@@ -0,0 +1,497 @@
+//
+// Created by Park Yu on 2024/12/19.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <chrono>
+#include "mspace.h"
+#include "preprocessor.h"
+#include "lexer.h"
+#include "syntaxer.h"
+#include "registry.h"
+#include "intern.h"
+
+#define MACRO_COUNT 64
+#define MAX_TERM_COUNT 48
+#define MAX_LOOP_DEPTH 4
+#define STRING_LENGTH 120
+#define MAX_BASELINE_ENTRY_COUNT 256
+#define BASELINE_KEY_LENGTH 64
+//percent a rate may fall or a per line size may grow before the comparison calls it a regression
+#define DEFAULT_REGRESSION_THRESHOLD 10.0
+
+#ifndef PCC_BENCH_BASELINE
+#define PCC_BENCH_BASELINE "bench/pcc_bench_baseline.json"
+#endif
+
+struct BenchSize {
+    const char *name;
+    uint32_t lineCount;
+    //best of, the first round also pays for faulting in fresh memory
+    int roundCount;
+};
+
+//one round of 1m lines takes seconds and holds 16M tokens, the smaller sizes are cheap enough for best of 3
+static const BenchSize benchSizes[] = {
+        {"1k",   1000,    3},
+        {"10k",  10000,   3},
+        {"100k", 100000,  3},
+        {"1m",   1000000, 1},
+};
+
+/**
+ * the generator's own lcg, the same seed writes the same program on every machine.
+ */
+struct Generator {
+    FILE *file;
+    uint64_t state;
+    uint32_t lineCount;
+    uint32_t methodCount;
+};
+
+static uint32_t nextRandom(Generator *generator, uint32_t bound) {
+    generator->state = generator->state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t) (generator->state >> 33) % bound;
+}
+
+static void writeLine(Generator *generator, int depth, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+static void writeLine(Generator *generator, int depth, const char *format, ...) {
+    fprintf(generator->file, "%*s", depth * 4, "");
+    va_list args;
+    va_start(args, format);
+    vfprintf(generator->file, format, args);
+    va_end(args);
+    fputc('\n', generator->file);
+    generator->lineCount++;
+}
+
+static void writeBlankLine(Generator *generator) {
+    fputc('\n', generator->file);
+    generator->lineCount++;
+}
+
+static FILE *createFile(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "can not create %s\n", path);
+        exit(-1);
+    }
+    return file;
+}
+
+//every function sees its params, the loop counters and value
+static const char *operandNames[] = {"left", "count", "value", "i", "j", "k"};
+
+/**
+ * a chain of + - * / % over vars, literals and macros, the parser has no parentheses yet so it stays flat.
+ */
+static void writeExpression(Generator *generator, uint32_t termCount) {
+    static const char operators[] = {'+', '-', '*', '/', '%'};
+    for (uint32_t i = 0; i < termCount; i++) {
+        if (i > 0) {
+            fprintf(generator->file, " %c ", operators[nextRandom(generator, sizeof(operators))]);
+        }
+        switch (nextRandom(generator, 4)) {
+            case 0:
+                fprintf(generator->file, "%u", nextRandom(generator, 100000) + 1);
+                break;
+            case 1:
+                fprintf(generator->file, "BENCH_CONSTANT_%u", nextRandom(generator, MACRO_COUNT));
+                break;
+            default:
+                fputs(operandNames[nextRandom(generator, sizeof(operandNames) / sizeof(operandNames[0]))],
+                      generator->file);
+        }
+    }
+}
+
+static void writeStatement(Generator *generator, int depth) {
+    fprintf(generator->file, "%*svalue = ", depth * 4, "");
+    writeExpression(generator, nextRandom(generator, MAX_TERM_COUNT) + 1);
+    if (generator->methodCount > 0 && nextRandom(generator, 4) == 0) {
+        //only earlier methods are known to the parser, and a call has to end the expression
+        fprintf(generator->file, " + method%u(value, ", nextRandom(generator, generator->methodCount));
+        writeExpression(generator, nextRandom(generator, 4) + 1);
+        fputc(')', generator->file);
+    }
+    fputs(";\n", generator->file);
+    generator->lineCount++;
+}
+
+/**
+ * for, while and if/else nested up to MAX_LOOP_DEPTH, a few statements on every level.
+ */
+static void writeLoop(Generator *generator, int depth, int level) {
+    static const char *counters[] = {"i", "j", "k"};
+    const char *counter = counters[level % 3];
+    uint32_t kind = nextRandom(generator, 3);
+    if (kind == 0) {
+        writeLine(generator, depth, "for (%s = 0; %s < count; %s = %s + 1) {", counter, counter, counter, counter);
+    } else if (kind == 1) {
+        writeLine(generator, depth, "while (%s < left) {", counter);
+    } else {
+        writeLine(generator, depth, "if (value >= %u) {", nextRandom(generator, 1000));
+    }
+    uint32_t statementCount = nextRandom(generator, 3) + 1;
+    for (uint32_t i = 0; i < statementCount; i++) {
+        writeStatement(generator, depth + 1);
+    }
+    if (level + 1 < MAX_LOOP_DEPTH && nextRandom(generator, 3) != 0) {
+        writeLoop(generator, depth + 1, level + 1);
+    }
+    if (kind == 1) {
+        writeLine(generator, depth + 1, "%s = %s + 1;", counter, counter);
+    }
+    if (kind == 2) {
+        writeLine(generator, depth, "} else {");
+        writeStatement(generator, depth + 1);
+    }
+    writeLine(generator, depth, "}");
+}
+
+/**
+ * a table of long string literals with escapes, the kind of data generated code carries.
+ */
+static void writeStrings(Generator *generator, int depth) {
+    uint32_t count = nextRandom(generator, 16) + 4;
+    for (uint32_t i = 0; i < count; i++) {
+        fprintf(generator->file, "%*stext = \"", depth * 4, "");
+        uint32_t length = nextRandom(generator, STRING_LENGTH) + 8;
+        for (uint32_t j = 0; j < length; j++) {
+            uint32_t c = nextRandom(generator, 40);
+            if (c < 26) {
+                fputc('a' + c, generator->file);
+            } else if (c < 34) {
+                fputc(' ', generator->file);
+            } else if (c < 36) {
+                fputs("\\n", generator->file);
+            } else if (c < 38) {
+                fputs("\\\"", generator->file);
+            } else {
+                fputc('0' + c % 10, generator->file);
+            }
+        }
+        fputs("\";\n", generator->file);
+        generator->lineCount++;
+    }
+}
+
+static void writeMethod(Generator *generator) {
+    writeLine(generator, 0, "int method%u(int left, int count) {", generator->methodCount);
+    writeLine(generator, 1, "int value = left;");
+    writeLine(generator, 1, "int i = 0;");
+    writeLine(generator, 1, "int j = 0;");
+    writeLine(generator, 1, "int k = 0;");
+    writeLine(generator, 1, "char *text = \"\";");
+    uint32_t partCount = nextRandom(generator, 8) + 4;
+    for (uint32_t i = 0; i < partCount; i++) {
+        switch (nextRandom(generator, 4)) {
+            case 0:
+                writeStrings(generator, 1);
+                break;
+            case 1:
+                writeLoop(generator, 1, 0);
+                break;
+            default:
+                writeStatement(generator, 1);
+        }
+    }
+    writeLine(generator, 1, "return value;");
+    writeLine(generator, 0, "}");
+    writeBlankLine(generator);
+    generator->methodCount++;
+}
+
+/**
+ * a header of macro constants behind an include guard, a region of it compiled out,
+ * then functions until the source has lineCount lines. returns the lines of both files.
+ */
+static uint32_t generateProgram(const char *headerPath, const char *path, uint32_t lineCount) {
+    Generator generator = {};
+    generator.state = 0x2024121900000001ull;
+    generator.file = createFile(headerPath);
+    writeLine(&generator, 0, "#ifndef PCC_BENCH_H");
+    writeLine(&generator, 0, "#define PCC_BENCH_H");
+    for (uint32_t i = 0; i < MACRO_COUNT; i++) {
+        writeLine(&generator, 0, "#define BENCH_CONSTANT_%u %u", i, nextRandom(&generator, 100000) + 1);
+    }
+    writeLine(&generator, 0, "#ifdef PCC_BENCH_DEBUG");
+    for (uint32_t i = 0; i < MACRO_COUNT; i++) {
+        writeLine(&generator, 0, "#define BENCH_TRACE_%u(x) x", i);
+    }
+    writeLine(&generator, 0, "#endif");
+    writeLine(&generator, 0, "#endif");
+    fclose(generator.file);
+
+    generator.file = createFile(path);
+    writeLine(&generator, 0, "#include <%s>", headerPath);
+    writeBlankLine(&generator);
+    while (generator.lineCount < lineCount) {
+        writeMethod(&generator);
+    }
+    fclose(generator.file);
+    return generator.lineCount;
+}
+
+struct AllocationCount {
+    uint64_t blocks;
+    uint64_t bytes;
+};
+
+static void countAllocations(const MemSpaceStat *stat, void *arg) {
+    AllocationCount *count = (AllocationCount *) arg;
+    count->blocks += stat->totalBlockCount;
+    count->bytes += stat->totalBytes;
+}
+
+static AllocationCount getAllocationCount() {
+    AllocationCount count = {};
+    pccVisitSpaces(countAllocations, &count);
+    return count;
+}
+
+/**
+ * the best round of a phase, allocations are counted over every space and are the same each round.
+ */
+struct PhaseResult {
+    double bestMs;
+    AllocationCount allocations;
+};
+
+static void recordPhase(PhaseResult *result, int round, std::chrono::steady_clock::time_point start,
+                        const AllocationCount &before) {
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (round == 0 || ms < result->bestMs) {
+        result->bestMs = ms;
+    }
+    AllocationCount after = getAllocationCount();
+    result->allocations.blocks = after.blocks - before.blocks;
+    result->allocations.bytes = after.bytes - before.bytes;
+}
+
+struct SizeResult {
+    uint32_t lineCount;
+    uint64_t byteCount;
+    uint64_t tokenCount;
+    PhaseResult preprocess;
+    PhaseResult lex;
+    PhaseResult parse;
+    AstMemoryStat ast;
+};
+
+static void benchSize(const char *path, int roundCount, uint32_t jobCount, SizeResult *result) {
+    for (int round = 0; round < roundCount; round++) {
+        AllocationCount before = getAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        ProcessedSource *source = preprocess(path);
+        recordPhase(&result->preprocess, round, start, before);
+
+        before = getAllocationCount();
+        start = std::chrono::steady_clock::now();
+        TokenList *tokens = buildTokens(source);
+        recordPhase(&result->lex, round, start, before);
+
+        before = getAllocationCount();
+        start = std::chrono::steady_clock::now();
+        if (jobCount > 1) {
+            buildAstParallel(openTokenListStream(tokens), jobCount);
+        } else {
+            buildAst(openTokenListStream(tokens));
+        }
+        recordPhase(&result->parse, round, start, before);
+        getAstMemoryStat(&result->ast);
+
+        result->byteCount = source->inputBytes;
+        result->tokenCount = tokens->count;
+        releaseAstMemory();
+        releaseFunctionRegistryMemory();
+        releaseLexerMemory();
+        releasePreProcessorMemory();
+        releaseInternMemory();
+    }
+}
+
+static void writePhase(FILE *file, const char *size, const char *phase, const PhaseResult *result,
+                       uint32_t lineCount, uint64_t tokenCount) {
+    double seconds = result->bestMs / 1000;
+    fprintf(file, "  \"%s.%s.ms\": %.3f,\n", size, phase, result->bestMs);
+    fprintf(file, "  \"%s.%s.lines_per_s\": %.0f,\n", size, phase, lineCount / seconds);
+    if (tokenCount > 0) {
+        fprintf(file, "  \"%s.%s.tokens_per_s\": %.0f,\n", size, phase, tokenCount / seconds);
+    }
+    fprintf(file, "  \"%s.%s.allocations\": %llu,\n", size, phase, (unsigned long long) result->allocations.blocks);
+    fprintf(file, "  \"%s.%s.allocated_bytes\": %llu,\n", size, phase, (unsigned long long) result->allocations.bytes);
+    fprintf(file, "  \"%s.%s.bytes_per_line\": %.1f,\n", size, phase, (double) result->allocations.bytes / lineCount);
+}
+
+/**
+ * one flat object, one metric per line in a fixed order, so two runs diff line by line.
+ */
+static void writeJson(FILE *file, const SizeResult *results, uint32_t sizeCount, uint32_t jobCount) {
+    fprintf(file, "{\n");
+    fprintf(file, "  \"format\": 1,\n");
+    fprintf(file, "  \"parse_jobs\": %u", jobCount);
+    for (uint32_t i = 0; i < sizeCount; i++) {
+        const char *size = benchSizes[i].name;
+        const SizeResult *result = &results[i];
+        fprintf(file, ",\n");
+        fprintf(file, "  \"%s.lines\": %u,\n", size, result->lineCount);
+        fprintf(file, "  \"%s.bytes\": %llu,\n", size, (unsigned long long) result->byteCount);
+        fprintf(file, "  \"%s.tokens\": %llu,\n", size, (unsigned long long) result->tokenCount);
+        //the preprocessor does not see tokens
+        writePhase(file, size, "preprocess", &result->preprocess, result->lineCount, 0);
+        writePhase(file, size, "lex", &result->lex, result->lineCount, result->tokenCount);
+        writePhase(file, size, "parse", &result->parse, result->lineCount, result->tokenCount);
+        fprintf(file, "  \"%s.parse.ast_nodes\": %llu,\n", size, (unsigned long long) result->ast.nodeCount);
+        fprintf(file, "  \"%s.parse.ast_bytes_per_line\": %.1f,\n", size,
+                (double) result->ast.nodeBytes / result->lineCount);
+        fprintf(file, "  \"%s.total.ms\": %.3f",
+                size, result->preprocess.bestMs + result->lex.bestMs + result->parse.bestMs);
+    }
+    fprintf(file, "\n}\n");
+}
+
+struct BaselineEntry {
+    char key[BASELINE_KEY_LENGTH];
+    double value;
+};
+
+/**
+ * read back what writeJson wrote, one "key": value per line. returns the entry count, 0 without a baseline.
+ */
+static uint32_t readBaseline(const char *path, BaselineEntry *entries) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    uint32_t count = 0;
+    char line[256];
+    while (count < MAX_BASELINE_ENTRY_COUNT && fgets(line, sizeof(line), file) != nullptr) {
+        BaselineEntry *entry = &entries[count];
+        if (sscanf(line, " \"%63[^\"]\": %lf", entry->key, &entry->value) == 2) {
+            count++;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+static bool endsWith(const char *string, const char *suffix) {
+    size_t length = strlen(string);
+    size_t suffixLength = strlen(suffix);
+    return length >= suffixLength && strcmp(string + length - suffixLength, suffix) == 0;
+}
+
+/**
+ * throughput and memory per line against the baseline, and any allocation count that moved:
+ * those are exact, the clock is not.
+ * a rate that fell or a size per line that grew by more than threshold percent is marked, so is an allocation
+ * count that grew. returns how many were marked.
+ */
+static uint32_t compareBaseline(const char *baselinePath, const char *path, double threshold) {
+    static BaselineEntry baseline[MAX_BASELINE_ENTRY_COUNT];
+    static BaselineEntry current[MAX_BASELINE_ENTRY_COUNT];
+    uint32_t baselineCount = readBaseline(baselinePath, baseline);
+    if (baselineCount == 0) {
+        printf("no baseline at %s\n", baselinePath);
+        return 0;
+    }
+    uint32_t regressionCount = 0;
+    uint32_t currentCount = readBaseline(path, current);
+    printf("against %s:\n", baselinePath);
+    for (uint32_t i = 0; i < currentCount; i++) {
+        const BaselineEntry *entry = &current[i];
+        bool rate = endsWith(entry->key, "_per_s") || endsWith(entry->key, "_per_line");
+        if (!rate && !endsWith(entry->key, "allocations")) {
+            continue;
+        }
+        for (uint32_t j = 0; j < baselineCount; j++) {
+            if (strcmp(baseline[j].key, entry->key) != 0) {
+                continue;
+            }
+            double old = baseline[j].value;
+            if (rate && old > 0) {
+                double change = (entry->value / old - 1) * 100;
+                //lines_per_s and tokens_per_s fall, bytes_per_line grows
+                bool regressed = endsWith(entry->key, "_per_s") ? change < -threshold : change > threshold;
+                printf("  %-32s %14.0f -> %14.0f  %+6.1f%%%s\n", entry->key, old, entry->value, change,
+                       regressed ? "  REGRESSION" : "");
+                regressionCount += regressed;
+            } else if (!rate && old != entry->value) {
+                bool regressed = entry->value > old;
+                printf("  %-32s %14.0f -> %14.0f%s\n", entry->key, old, entry->value, regressed ? "  REGRESSION" : "");
+                regressionCount += regressed;
+            }
+            break;
+        }
+    }
+    if (regressionCount > 0) {
+        printf("%u regressions beyond %.1f%%\n", regressionCount, threshold);
+    }
+    return regressionCount;
+}
+
+static void printUsage() {
+    printf("usage: pcc_bench [-o result.json] [-b baseline.json] [-n max lines] [-j parse jobs] "
+           "[-t regression threshold percent]\n");
+}
+
+int main(int argc, char **argv) {
+    const char *outputPath = "pcc_bench.json";
+    const char *baselinePath = PCC_BENCH_BASELINE;
+    uint32_t maxLineCount = 1000000;
+    uint32_t jobCount = 1;
+    double threshold = DEFAULT_REGRESSION_THRESHOLD;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+            outputPath = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+            baselinePath = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+            maxLineCount = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+            jobCount = (uint32_t) strtoul(argv[++i], nullptr, 10);
+            if (jobCount == 0) {
+                printUsage();
+                return -1;
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            threshold = strtod(argv[++i], nullptr);
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+
+    SizeResult results[sizeof(benchSizes) / sizeof(benchSizes[0])] = {};
+    uint32_t sizeCount = 0;
+    for (const BenchSize &size: benchSizes) {
+        if (size.lineCount > maxLineCount) {
+            break;
+        }
+        char headerPath[64];
+        char path[64];
+        snprintf(headerPath, sizeof(headerPath), "pcc_bench_%s.h", size.name);
+        snprintf(path, sizeof(path), "pcc_bench_%s.c", size.name);
+        SizeResult *result = &results[sizeCount++];
+        result->lineCount = generateProgram(headerPath, path, size.lineCount);
+        benchSize(path, size.roundCount, jobCount, result);
+        remove(path);
+        remove(headerPath);
+        printf("%s: %llu tokens, preprocess %.2f ms, lex %.2f ms, parse %.2f ms\n", size.name,
+               (unsigned long long) result->tokenCount, result->preprocess.bestMs, result->lex.bestMs,
+               result->parse.bestMs);
+    }
+
+    FILE *file = createFile(outputPath);
+    writeJson(file, results, sizeCount, jobCount);
+    fclose(file);
+    printf("wrote %s\n", outputPath);
+    //non-zero when anything regressed, a script can stop on it
+    return compareBaseline(baselinePath, outputPath, threshold) > 0 ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+//
+// Created by Park Yu on 2024/12/9.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "preprocessor.h"
+
+#define LINE_COUNT 1000000
+#define MACRO_COUNT 5000
+#define MACRO_LINE_COUNT 200000
+#define CONDITIONAL_BLOCK_COUNT 100000
+
+static void generateSource(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "can not create %s\n", path);
+        exit(-1);
+    }
+    for (int i = 0; i < LINE_COUNT; i++) {
+        switch (i % 5) {
+            case 0:
+                fprintf(file, "int method%d(int a, int b) {\n", i);
+                break;
+            case 1:
+                fprintf(file, "    int value%d = a + b - %d;\n", i, i);
+                break;
+            case 2:
+                fprintf(file, "    // comment line %d\n", i);
+                break;
+            case 3:
+                fprintf(file, "    return value%d;\n", i - 2);
+                break;
+            default:
+                fprintf(file, "}\n");
+        }
+    }
+    fclose(file);
+}
+
+/**
+ * a header with MACRO_COUNT constants and function-like macros, half of them built on other macros,
+ * and a source where every statement expands a few of them, every tenth one with its arguments over two lines.
+ * returns the line count of the source.
+ */
+static int generateMacroSource(const char *headerPath, const char *path) {
+    FILE *header = fopen(headerPath, "w");
+    FILE *file = fopen(path, "w");
+    if (header == nullptr || file == nullptr) {
+        fprintf(stderr, "can not create %s\n", header == nullptr ? headerPath : path);
+        exit(-1);
+    }
+    fprintf(header, "#ifndef PREPROCESS_BENCH_H\n#define PREPROCESS_BENCH_H\n");
+    for (int i = 0; i < MACRO_COUNT; i++) {
+        if (i % 2 == 0) {
+            fprintf(header, "#define BENCH_CONSTANT_%d %d\n", i, i);
+        } else {
+            fprintf(header, "#define BENCH_SCALE_%d(x, y) ((x) * BENCH_CONSTANT_%d + (y))\n", i, i - 1);
+        }
+    }
+    fprintf(header, "#endif\n");
+    fclose(header);
+    fprintf(file, "#include <%s>\n", headerPath);
+    int lineCount = 1;
+    for (int i = 0; i < MACRO_LINE_COUNT; i++) {
+        int macro = (i * 7919) % MACRO_COUNT | 1;
+        if (i % 10 == 0) {
+            fprintf(file, "    value%d = BENCH_SCALE_%d(value%d, // scaled\n        BENCH_CONSTANT_%d) + counter%d;\n",
+                    i, macro, i, macro - 1, i);
+            lineCount += 2;
+        } else {
+            fprintf(file, "    value%d = BENCH_SCALE_%d(value%d, BENCH_CONSTANT_%d) + counter%d;\n",
+                    i, macro, i, macro - 1, i);
+            lineCount++;
+        }
+    }
+    fclose(file);
+    return lineCount;
+}
+
+/**
+ * a platform header where most blocks are compiled out, 9 of every 10 blocks are for other targets.
+ */
+static int generateConditionalSource(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "can not create %s\n", path);
+        exit(-1);
+    }
+    int lineCount = 1;
+    fprintf(file, "#define TARGET_LINUX 1\n");
+    for (int i = 0; i < CONDITIONAL_BLOCK_COUNT; i++) {
+        fprintf(file, i % 10 == 0 ? "#if defined(TARGET_LINUX) && TARGET_LINUX\n" : "#ifdef TARGET_OTHER_%d\n", i);
+        for (int j = 0; j < 8; j++) {
+            fprintf(file, "extern int platform_call_%d_%d(int fd, char *buffer, int count);\n", i, j);
+        }
+        fprintf(file, "#endif\n");
+        lineCount += 10;
+    }
+    fclose(file);
+    return lineCount;
+}
+
+static void bench(const char *name, const char *path, int inputLines) {
+    auto start = std::chrono::steady_clock::now();
+    ProcessedSource *source = preprocess(path);
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    double mb = (double) source->size / (1024 * 1024);
+    double inputMb = (double) source->inputBytes / (1024 * 1024);
+    double skippedMb = (double) source->skippedBytes / (1024 * 1024);
+    printf("%s: %d input lines, %u kept lines, %.1f MB in, %.1f MB skipped, %.1f MB out: "
+           "%.2f ms, %.1f MB/s in, %.1f M lines/s\n",
+           name, inputLines, source->lineCount, inputMb, skippedMb, mb, ms, inputMb * 1000 / ms,
+           inputLines / ms / 1000);
+    releasePreProcessorMemory();
+}
+
+/**
+ * a header whose guard #ifndef has a branch of its own is not guarded, its second include takes the branch.
+ * exits when the branch went missing.
+ */
+static void checkGuardBranch(const char *headerPath, const char *path, const char *branch) {
+    FILE *header = fopen(headerPath, "w");
+    FILE *file = fopen(path, "w");
+    if (header == nullptr || file == nullptr) {
+        fprintf(stderr, "can not create %s\n", header == nullptr ? headerPath : path);
+        exit(-1);
+    }
+    fprintf(header, "#ifndef BRANCH_GUARD_H\n#define BRANCH_GUARD_H\nint ga = 1;\n%s\nint gb = 2;\n#endif\n", branch);
+    fclose(header);
+    fprintf(file, "#include <%s>\n#include <%s>\n", headerPath, headerPath);
+    fclose(file);
+    ProcessedSource *source = preprocess(path);
+    if (strstr(source->text, "int ga = 1;") == nullptr || strstr(source->text, "int gb = 2;") == nullptr) {
+        fprintf(stderr, "the %s branch of a guard #ifndef was dropped on the second include\n", branch);
+        exit(-1);
+    }
+    releasePreProcessorMemory();
+    remove(headerPath);
+    remove(path);
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "preprocess_bench.c";
+    checkGuardBranch("preprocess_guard.h", path, "#else");
+    checkGuardBranch("preprocess_guard.h", path, "#elif 1");
+
+    generateSource(path);
+    bench("plain", path, LINE_COUNT);
+    remove(path);
+
+    const char *headerPath = "preprocess_bench.h";
+    int macroLineCount = generateMacroSource(headerPath, path);
+    bench("macros", path, macroLineCount);
+    remove(headerPath);
+    remove(path);
+
+    int lineCount = generateConditionalSource(path);
+    bench("conditionals", path, lineCount);
+    remove(path);
+    return 0;
+}
@@ -5,11 +5,68 @@
 #ifndef PCC_CC_AST_H
 #define PCC_CC_AST_H
 
-#include "stdint.h"
+#include <stdint.h>
+#include <cstddef>
+#include <atomic>
+
+//nodes of one type are allocated AST_CHUNK_SIZE at a time
+#define AST_CHUNK_BITS 10
+#define AST_CHUNK_SIZE (1u << AST_CHUNK_BITS)
+//enough chunks for every 32 bit index
+#define AST_MAX_CHUNK_COUNT (1u << (32 - AST_CHUNK_BITS))
+
+/**
+ * every node type has an arena of its own, nodes refer to each other by a 32 bit index into it.
+ * chunks never move, so a node pointer stays valid until releaseAstMemory.
+ * the chunk array doubles while other parser threads read it, the array it replaces stays alive with the
+ * same entries, a reader holding it still finds every chunk it can know about.
+ * index 0 is never handed out, it is the null reference.
+ */
+template<typename T>
+struct AstArena {
+    std::atomic<T **> chunks;
+    uint32_t chunkCapacity;
+    uint32_t chunkCount;
+    //nodes in the chunks their threads are done with
+    uint64_t nodeCount;
+};
+
+template<typename T>
+inline AstArena<T> astArena = {};
+
+/**
+ * a node of type T by index, used like a T *: ->, == nullptr and passing it on as a pointer all work.
+ * zero filled memory holds null references.
+ */
+template<typename T>
+struct AstRef {
+    uint32_t index;
+
+    AstRef() = default;
+
+    AstRef(std::nullptr_t) : index(0) {
+    }
+
+    explicit AstRef(uint32_t index) : index(index) {
+    }
+
+    T *operator->() const {
+        T **chunks = astArena<T>.chunks.load(std::memory_order_acquire);
+        return &chunks[index >> AST_CHUNK_BITS][index & (AST_CHUNK_SIZE - 1)];
+    }
+
+    T &operator*() const {
+        return *operator->();
+    }
+
+    operator T *() const {
+        return index == 0 ? nullptr : operator->();
+    }
+};
 
 struct AstExpression;
 
-enum PrimitiveType {
+enum PrimitiveType : uint8_t {
     TYPE_UNKNOWN,
 
     TYPE_VOID,
@@ -23,7 +80,7 @@ enum PrimitiveType {
     TYPE_DOUBLE,
 };
 
-enum StatementType {
+enum StatementType : uint8_t {
     STATEMENT_IF,
     STATEMENT_WHILE,
     STATEMENT_FOR,
@@ -34,13 +91,13 @@ enum StatementType {
     STATEMENT_METHOD_CALL,
 };
 
-enum BoolOperatorType {
+enum BoolOperatorType : uint8_t {
     BOOL_NULL,
     BOOL_OR,
     BOOL_AND
 };
 
-enum ArithmeticOperatorType {
+enum ArithmeticOperatorType : uint8_t {
     ARITHMETIC_NULL,
     ARITHMETIC_ADD,
     ARITHMETIC_SUB,
@@ -49,7 +106,7 @@ enum ArithmeticOperatorType {
     ARITHMETIC_MOD,
 };
 
-enum RelationOperator {
+enum RelationOperator : uint8_t {
     RELATION_LESS,
     RELATION_LESS_EQ,
     RELATION_GREATER,
@@ -58,12 +115,12 @@ enum RelationOperator {
     RELATION_NOT_EQ,
 };
 
-enum BoolFactorType {
+enum BoolFactorType : uint8_t {
     BOOL_FACTOR_INVERT,
     BOOL_FACTOR_RELATION,
 };
 
-enum ArithmeticFactorType {
+enum ArithmeticFactorType : uint8_t {
     ARITHMETIC_IDENTITY,
     ARITHMETIC_ADR_P,
     ARITHMETIC_DREF_P,
@@ -73,7 +130,7 @@ enum ArithmeticFactorType {
     ARITHMETIC_ARRAY,//string is char array.
 };
 
-enum ExpressionType {
+enum ExpressionType : uint8_t {
     EXPRESSION_ASSIGNMENT,
     EXPRESSION_ARITHMETIC
 };
@@ -83,27 +140,29 @@ struct AstType {
     PrimitiveType primitiveType;
 };
 
-enum IdentityType {
+enum IdentityType : uint8_t {
     ID_METHOD,
     ID_VAR,
     ID_ARRAY,
 };
 
+//nodes refer to each other by 32 bit index and enums take a byte, the only padding is after an enum up to the
+//next 4 byte field or the end of the record, 2 or 3 bytes in each record with enums. sizes are pinned at the end
 struct AstIdentity {
-    IdentityType type;
     const char *name;
-    AstExpression *arrayIndex;//only set when IdentityType=ID_ARRAY
+    AstRef<AstExpression> arrayIndex;//only set when IdentityType=ID_ARRAY
+    IdentityType type;
 };
 
 struct AstParamDefine {
-    AstType *type;
-    AstIdentity *identity;
+    AstRef<AstType> type;
+    AstRef<AstIdentity> identity;
 };
 
 struct AstParamList {
     //maybe ","
-    AstParamDefine *paramDefine;
-    AstParamList *next;
+    AstRef<AstParamDefine> paramDefine;
+    AstRef<AstParamList> next;
     //null
 };
 
@@ -111,38 +170,42 @@ struct AstBoolFactor;
 
 struct AstBoolFactorInvert {
     // !
-    AstBoolFactor *boolFactor;
+    AstRef<AstBoolFactor> boolFactor;
 };
 
 struct AstExpressionArithmetic;
 
 struct AstBoolFactorCompareArithmetic {
-    AstExpressionArithmetic *firstArithmeticExpression;
+    AstRef<AstExpressionArithmetic> firstArithmeticExpression;
+    AstRef<AstExpressionArithmetic> secondArithmeticExpression;
     RelationOperator relationOperation;
-    AstExpressionArithmetic *secondArithmeticExpression;
 };
 
 struct AstBoolFactor {
     BoolFactorType boolFactorType;
     union {
-        AstBoolFactorInvert *invertBoolFactor;
-        AstBoolFactorCompareArithmetic *arithmeticBoolFactor;
+        AstRef<AstBoolFactorInvert> invertBoolFactor;
+        AstRef<AstBoolFactorCompareArithmetic> arithmeticBoolFactor;
     };
 };
 
+//the operands of a flat node are a span of consecutive nodes in the arena, see newAstNodes
 struct AstBoolItem {
-    AstBoolFactor *boolFactor;
-    AstBoolItem *next;//nullable, must be &&
+    //joined by &&
+    AstRef<AstBoolFactor> boolFactors;
+    uint32_t boolFactorCount;
 };
 
 struct AstExpressionBool {
-    AstBoolItem *boolItem;
-    AstExpressionBool *next;//nullable, must be ||
+    //joined by ||
+    AstRef<AstBoolItem> boolItems;
+    uint32_t boolItemCount;
 };
 
 struct AstPrimitiveData {
     AstType type;//pointer only data long
-    union {
+    //4 byte aligned, so a string char in AstArrayData takes 16 bytes instead of 24
+    union __attribute__((packed, aligned(4))) {
         char dataChar;
         short dataShort;
         int dataInt;
@@ -155,85 +218,66 @@ struct AstPrimitiveData {
 
 struct AstArrayData {
     AstPrimitiveData data;
-    AstArrayData *next;//nullable
+    AstRef<AstArrayData> next;//nullable
 };
 
 struct AstStatementMethodCall;
 
 struct AstArithmeticFactor {
     ArithmeticFactorType factorType;
+    ArithmeticOperatorType arithmeticOperatorType;//* / % before it, null for the first factor of an item
     union {
-        AstIdentity *identity;
-        AstStatementMethodCall *methodCall;
-        AstArrayData *array;
-        AstPrimitiveData *primitiveData;
-        char dataChar;
-        short dataShort;
-        int dataInt;
-        long dataLong;
-
-        float dataFloat;
-        double dataDouble;
+        AstRef<AstIdentity> identity;
+        AstRef<AstStatementMethodCall> methodCall;
+        AstRef<AstArrayData> array;
+        AstRef<AstPrimitiveData> primitiveData;
     };
 };
 
-struct AstArithmeticItemMore {
-    ArithmeticOperatorType arithmeticOperatorType;//* / %
-    AstArithmeticFactor *arithmeticFactor;
-    AstArithmeticItemMore *arithmeticItemMore;
-    //null
-};
-
 struct AstArithmeticItem {
-    AstArithmeticFactor *arithmeticFactor;
-    AstArithmeticItemMore *arithmeticItemMore;
-};
-
-struct AstExpressionArithmeticMore {
-    ArithmeticOperatorType arithmeticOperatorType;//+ -
-    AstArithmeticItem *arithmeticItem;
-    AstExpressionArithmeticMore *arithmeticExpressMore;
-    //null
+    AstRef<AstArithmeticFactor> arithmeticFactors;
+    uint32_t arithmeticFactorCount;
+    ArithmeticOperatorType arithmeticOperatorType;//+ - before it, null for the first item of an expression
 };
 
 struct AstExpressionArithmetic {
-    AstArithmeticItem *arithmeticItem;
-    AstExpressionArithmeticMore *arithmeticExpressMore;
+    AstRef<AstArithmeticItem> arithmeticItems;
+    uint32_t arithmeticItemCount;
 };
 
 struct AstExpressionAssignment {
-    AstIdentity *identity;
+    AstRef<AstIdentity> identity;
     //=
-    AstExpression *expression;
+    AstRef<AstExpression> expression;
 };
 
 struct AstExpression {
     ExpressionType expressionType;
     union {
-        AstExpressionAssignment *assignmentExpression;
-        AstExpressionArithmetic *arithmeticExpression;
+        AstRef<AstExpressionAssignment> assignmentExpression;
+        AstRef<AstExpressionArithmetic> arithmeticExpression;
     };
 };
 
 struct AstObjectList {
     //maybe ","
-    AstExpression *expression;
-    AstObjectList *objectMore;
+    AstRef<AstExpression> expression;
+    AstRef<AstObjectList> objectMore;
     //null
 };
 
 struct AstStatementDefine {
-    AstType *type;
-    AstIdentity *identity;
+    AstRef<AstType> type;
+    AstRef<AstIdentity> identity;
     //=
-    AstExpression *expression;
+    AstRef<AstExpression> expression;
 };
 
 struct AstStatementMethodCall {
-    AstType *retType;
-    AstIdentity *identity;
+    AstRef<AstType> retType;
+    AstRef<AstIdentity> identity;
     //(
-    AstObjectList *objectList;
+    AstRef<AstObjectList> objectList;
     //)
     //;
 };
@@ -243,40 +287,40 @@ struct AstStatement;
 struct AstStatementFor {
     //for
     //(
-    AstExpression *initExpression;
+    AstRef<AstExpression> initExpression;
     //;
-    AstExpressionBool *controlExpression;
+    AstRef<AstExpressionBool> controlExpression;
     //;
-    AstExpression *afterExpression;
+    AstRef<AstExpression> afterExpression;
     //)
-    AstStatement *statement;
+    AstRef<AstStatement> statement;
 };
 
 struct AstStatementWhile {
     //while
     //(
-    AstExpressionBool *expression;
+    AstRef<AstExpressionBool> expression;
     //)
-    AstStatement *statement;
+    AstRef<AstStatement> statement;
 };
 
 struct AstStatementIf {
     //if
     //(
-    AstExpressionBool *expression;
+    AstRef<AstExpressionBool> expression;
     //)
-    AstStatement *trueStatement;
+    AstRef<AstStatement> trueStatement;
     //else
-    AstStatement *falseStatement;//nullable
+    AstRef<AstStatement> falseStatement;//nullable
 };
 
 struct AstStatementReturn {
     //return
-    AstExpression *expression;//nullable
+    AstRef<AstExpression> expression;//nullable
 };
 
 struct AstStatementExpressions {
-    AstExpression *expression;
+    AstRef<AstExpression> expression;
 };
 
 struct AstStatementSeq;
@@ -285,59 +329,59 @@ struct AstStatementBlock;
 struct AstStatement {
     StatementType statementType;
     union {
-        AstStatementDefine *defineStatement;
-        AstStatementExpressions *expressionsStatement;
-        AstStatementMethodCall *methodCallStatement;
-        AstStatementIf *ifStatement;
-        AstStatementFor *forStatement;
-        AstStatementReturn *returnStatement;
-        AstStatementWhile *whileStatement;
-        AstStatementBlock *blockStatement;
+        AstRef<AstStatementDefine> defineStatement;
+        AstRef<AstStatementExpressions> expressionsStatement;
+        AstRef<AstStatementMethodCall> methodCallStatement;
+        AstRef<AstStatementIf> ifStatement;
+        AstRef<AstStatementFor> forStatement;
+        AstRef<AstStatementReturn> returnStatement;
+        AstRef<AstStatementWhile> whileStatement;
+        AstRef<AstStatementBlock> blockStatement;
     };
 };
 
 struct AstStatementSeq {
-    AstStatement *statement;
-    AstStatementSeq *next;
+    AstRef<AstStatement> statement;
+    AstRef<AstStatementSeq> next;
     //null
 };
 
 struct AstStatementBlock {
     //{
-    AstStatementSeq *statementSeq;
+    AstRef<AstStatementSeq> statementSeq;
     //}
 };
 
-enum MethodDefineType {
+enum MethodDefineType : uint8_t {
     METHOD_IMPL,
     METHOD_EXTERN,
 };
 
 struct AstMethodDefine {
     MethodDefineType defineType;
-    AstType *type;
-    AstIdentity *identity;
+    AstRef<AstType> type;
+    AstRef<AstIdentity> identity;
     // (
-    AstParamList *paramList;
+    AstRef<AstParamList> paramList;
     //)
-    AstStatementBlock *statementBlock;//nullable
+    AstRef<AstStatementBlock> statementBlock;//nullable
 };
 
 struct AstMethodSeq {
-    AstMethodDefine *methodDefine;
-    AstMethodSeq *nextAstMethodSeq;
+    AstRef<AstMethodDefine> methodDefine;
+    AstRef<AstMethodSeq> nextAstMethodSeq;
     //null
 };
 
 struct AstGlobalFieldSeq {
-    AstStatementDefine *statementDefine;
-    AstGlobalFieldSeq *next;
+    AstRef<AstStatementDefine> statementDefine;
+    AstRef<AstGlobalFieldSeq> next;
     //null
 };
 
 struct AstProgram {
-    AstGlobalFieldSeq *globalFieldSeq;
-    AstMethodSeq *methodSeq;
+    AstRef<AstGlobalFieldSeq> globalFieldSeq;
+    AstRef<AstMethodSeq> methodSeq;
 };
 
 enum AstNodeType {
@@ -358,21 +402,33 @@ enum AstNodeType {
     NODE_EXPRESSION,
     NODE_EXPRESSION_ASSIGNMENT,
     NODE_EXPRESSION_ARITHMETIC,
-    NODE_EXPRESSION_ARITHMETIC_MORE,
-    NODE_ARITHMETIC_ITEM,
-    NODE_ARITHMETIC_ITEM_MORE,
     NODE_ARITHMETIC_FACTOR,
     NODE_ARRAY_DATA,
     NODE_PRIMITIVE_DATA,
     NODE_EXPRESSION_BOOL,
-    NODE_BOOL_ITEM,
     NODE_BOOL_FACTOR,
     NODE_BOOL_FACTOR_COMPARE_ARITHMETIC,
-    NODE_BOOL_FACTOR_INVERT,
     NODE_PARAM_LIST,
     NODE_PARAM_DEFINE,
     NODE_IDENTITY,
     NODE_TYPE
 };
 
+//every type with an arena, X(type)
+#define PCC_AST_NODE_TYPES(X) \
+    X(AstType) X(AstIdentity) X(AstParamDefine) X(AstParamList) \
+    X(AstBoolFactorInvert) X(AstBoolFactorCompareArithmetic) X(AstBoolFactor) X(AstBoolItem) X(AstExpressionBool) \
+    X(AstPrimitiveData) X(AstArrayData) X(AstArithmeticFactor) X(AstArithmeticItem) X(AstExpressionArithmetic) \
+    X(AstExpressionAssignment) X(AstExpression) \
+    X(AstObjectList) X(AstStatementDefine) X(AstStatementMethodCall) X(AstStatementFor) X(AstStatementWhile) \
+    X(AstStatementIf) X(AstStatementReturn) X(AstStatementExpressions) X(AstStatement) X(AstStatementSeq) \
+    X(AstStatementBlock) X(AstMethodDefine) X(AstMethodSeq) X(AstGlobalFieldSeq) X(AstProgram)
+
+static_assert(sizeof(AstIdentity) == 16, "AstIdentity grew");
+static_assert(sizeof(AstPrimitiveData) == 12, "AstPrimitiveData grew");
+static_assert(sizeof(AstArrayData) == 16, "AstArrayData grew");
+static_assert(sizeof(AstStatement) == 8, "AstStatement grew");
+static_assert(sizeof(AstArithmeticFactor) == 8, "AstArithmeticFactor grew");
+static_assert(sizeof(AstArithmeticItem) == 12, "AstArithmeticItem grew");
+
 #endif //PCC_CC_AST_H
@@ -0,0 +1,350 @@
+//
+// Created by Park Yu on 2024/12/16.
+//
+
+#include "charscan.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PCC_SCAN_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define PCC_SCAN_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * the vector paths test a byte with a few compares instead of a table load, so the word set is a superset of the
+ * lexer's non word classes that compares cheaply: everything up to '/', ";<=>", '[', ']' and "{|}".
+ * the scalar path uses the same sets, every level stops at the same positions.
+ */
+static bool isBlank(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r') || c == '\0';
+}
+
+static bool isWordStop(unsigned char c) {
+    return c <= '/' || (c >= ';' && c <= '>') || c == '[' || c == ']' || (c >= '{' && c <= '}');
+}
+
+struct ScanTable {
+    bool blanks[256];
+    bool wordStops[256];
+
+    ScanTable() : blanks(), wordStops() {
+        for (int c = 0; c < 256; c++) {
+            blanks[c] = isBlank((unsigned char) c);
+            wordStops[c] = isWordStop((unsigned char) c);
+        }
+    }
+};
+
+static const ScanTable scanTable;
+
+static uint32_t skipBlanksScalar(const char *text, uint32_t position, uint32_t size) {
+    while (position < size && scanTable.blanks[(unsigned char) text[position]]) {
+        position++;
+    }
+    return position;
+}
+
+static uint32_t skipWordScalar(const char *text, uint32_t position, uint32_t size) {
+    while (position < size && !scanTable.wordStops[(unsigned char) text[position]]) {
+        position++;
+    }
+    return position;
+}
+
+static uint32_t skipQuotedScalar(const char *text, uint32_t position, uint32_t size, char quote) {
+    while (position < size) {
+        char c = text[position];
+        if (c == quote || c == '\n' || c == '\\') {
+            break;
+        }
+        position++;
+    }
+    return position;
+}
+
+static const CharScanner scalarScanner = {skipBlanksScalar, skipWordScalar, skipQuotedScalar};
+
+#ifdef PCC_SCAN_X86
+
+//x <= limit for unsigned bytes, sse has no unsigned compare
+static inline __m128i lessEqual16(__m128i x, __m128i limit) {
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, limit), x);
+}
+
+static inline __m128i blankMask16(__m128i chunk) {
+    __m128i control = _mm_sub_epi8(chunk, _mm_set1_epi8('\t'));
+    __m128i blank = lessEqual16(control, _mm_set1_epi8('\r' - '\t'));
+    blank = _mm_or_si128(blank, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')));
+    return _mm_or_si128(blank, _mm_cmpeq_epi8(chunk, _mm_setzero_si128()));
+}
+
+static inline __m128i wordStopMask16(__m128i chunk) {
+    __m128i stop = lessEqual16(chunk, _mm_set1_epi8('/'));
+    stop = _mm_or_si128(stop, lessEqual16(_mm_sub_epi8(chunk, _mm_set1_epi8(';')), _mm_set1_epi8('>' - ';')));
+    stop = _mm_or_si128(stop, lessEqual16(_mm_sub_epi8(chunk, _mm_set1_epi8('{')), _mm_set1_epi8('}' - '{')));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('[')));
+    return _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(']')));
+}
+
+static inline __m128i quotedStopMask16(__m128i chunk, __m128i quote) {
+    __m128i stop = _mm_cmpeq_epi8(chunk, quote);
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+    return _mm_or_si128(stop, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')));
+}
+
+static uint32_t skipBlanksSse2(const char *text, uint32_t position, uint32_t size) {
+    while (position + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (text + position));
+        uint32_t other = ~(uint32_t) _mm_movemask_epi8(blankMask16(chunk)) & 0xffff;
+        if (other != 0) {
+            return position + __builtin_ctz(other);
+        }
+        position += 16;
+    }
+    return skipBlanksScalar(text, position, size);
+}
+
+static uint32_t skipWordSse2(const char *text, uint32_t position, uint32_t size) {
+    while (position + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (text + position));
+        uint32_t stop = (uint32_t) _mm_movemask_epi8(wordStopMask16(chunk));
+        if (stop != 0) {
+            return position + __builtin_ctz(stop);
+        }
+        position += 16;
+    }
+    return skipWordScalar(text, position, size);
+}
+
+static uint32_t skipQuotedSse2(const char *text, uint32_t position, uint32_t size, char quote) {
+    __m128i quotes = _mm_set1_epi8(quote);
+    while (position + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (text + position));
+        uint32_t stop = (uint32_t) _mm_movemask_epi8(quotedStopMask16(chunk, quotes));
+        if (stop != 0) {
+            return position + __builtin_ctz(stop);
+        }
+        position += 16;
+    }
+    return skipQuotedScalar(text, position, size, quote);
+}
+
+static const CharScanner sse2Scanner = {skipBlanksSse2, skipWordSse2, skipQuotedSse2};
+
+//compiled for avx2 whatever the build flags are, only called when the cpu reports it.
+//the tails go on in sse2 code, the upper halves are cleared first: gcc leaves them dirty across the tail call
+//and every later legacy sse instruction of the process pays for it
+
+#define PCC_AVX2 __attribute__((target("avx2")))
+
+PCC_AVX2 static inline __m256i lessEqual32(__m256i x, __m256i limit) {
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(x, limit), x);
+}
+
+PCC_AVX2 static uint32_t skipBlanksAvx2(const char *text, uint32_t position, uint32_t size) {
+    while (position + 32 <= size) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (text + position));
+        __m256i control = _mm256_sub_epi8(chunk, _mm256_set1_epi8('\t'));
+        __m256i blank = lessEqual32(control, _mm256_set1_epi8('\r' - '\t'));
+        blank = _mm256_or_si256(blank, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')));
+        blank = _mm256_or_si256(blank, _mm256_cmpeq_epi8(chunk, _mm256_setzero_si256()));
+        uint32_t other = ~(uint32_t) _mm256_movemask_epi8(blank);
+        if (other != 0) {
+            return position + __builtin_ctz(other);
+        }
+        position += 32;
+    }
+    _mm256_zeroupper();
+    return skipBlanksSse2(text, position, size);
+}
+
+PCC_AVX2 static uint32_t skipWordAvx2(const char *text, uint32_t position, uint32_t size) {
+    while (position + 32 <= size) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (text + position));
+        __m256i stop = lessEqual32(chunk, _mm256_set1_epi8('/'));
+        stop = _mm256_or_si256(stop, lessEqual32(_mm256_sub_epi8(chunk, _mm256_set1_epi8(';')),
+                                                 _mm256_set1_epi8('>' - ';')));
+        stop = _mm256_or_si256(stop, lessEqual32(_mm256_sub_epi8(chunk, _mm256_set1_epi8('{')),
+                                                 _mm256_set1_epi8('}' - '{')));
+        stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('[')));
+        stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(']')));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(stop);
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+        position += 32;
+    }
+    _mm256_zeroupper();
+    return skipWordSse2(text, position, size);
+}
+
+PCC_AVX2 static uint32_t skipQuotedAvx2(const char *text, uint32_t position, uint32_t size, char quote) {
+    __m256i quotes = _mm256_set1_epi8(quote);
+    while (position + 32 <= size) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (text + position));
+        __m256i stop = _mm256_cmpeq_epi8(chunk, quotes);
+        stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+        stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\')));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(stop);
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+        position += 32;
+    }
+    _mm256_zeroupper();
+    return skipQuotedSse2(text, position, size, quote);
+}
+
+static const CharScanner avx2Scanner = {skipBlanksAvx2, skipWordAvx2, skipQuotedAvx2};
+
+#endif
+
+#ifdef PCC_SCAN_NEON
+
+static inline uint8x16_t blankMaskNeon(uint8x16_t chunk) {
+    uint8x16_t blank = vcleq_u8(vsubq_u8(chunk, vdupq_n_u8('\t')), vdupq_n_u8('\r' - '\t'));
+    blank = vorrq_u8(blank, vceqq_u8(chunk, vdupq_n_u8(' ')));
+    return vorrq_u8(blank, vceqq_u8(chunk, vdupq_n_u8(0)));
+}
+
+static inline uint8x16_t wordStopMaskNeon(uint8x16_t chunk) {
+    uint8x16_t stop = vcleq_u8(chunk, vdupq_n_u8('/'));
+    stop = vorrq_u8(stop, vcleq_u8(vsubq_u8(chunk, vdupq_n_u8(';')), vdupq_n_u8('>' - ';')));
+    stop = vorrq_u8(stop, vcleq_u8(vsubq_u8(chunk, vdupq_n_u8('{')), vdupq_n_u8('}' - '{')));
+    stop = vorrq_u8(stop, vceqq_u8(chunk, vdupq_n_u8('[')));
+    return vorrq_u8(stop, vceqq_u8(chunk, vdupq_n_u8(']')));
+}
+
+/**
+ * neon has no movemask, narrowing keeps 4 bits per byte, the first set nibble is the first match.
+ */
+static inline uint64_t nibbleMask(uint8x16_t match) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+}
+
+static uint32_t skipBlanksNeon(const char *text, uint32_t position, uint32_t size) {
+    while (position + 16 <= size) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t *) (text + position));
+        uint64_t other = ~nibbleMask(blankMaskNeon(chunk));
+        if (other != 0) {
+            return position + (__builtin_ctzll(other) >> 2);
+        }
+        position += 16;
+    }
+    return skipBlanksScalar(text, position, size);
+}
+
+static uint32_t skipWordNeon(const char *text, uint32_t position, uint32_t size) {
+    while (position + 16 <= size) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t *) (text + position));
+        uint64_t stop = nibbleMask(wordStopMaskNeon(chunk));
+        if (stop != 0) {
+            return position + (__builtin_ctzll(stop) >> 2);
+        }
+        position += 16;
+    }
+    return skipWordScalar(text, position, size);
+}
+
+static uint32_t skipQuotedNeon(const char *text, uint32_t position, uint32_t size, char quote) {
+    uint8x16_t quotes = vdupq_n_u8((uint8_t) quote);
+    while (position + 16 <= size) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t *) (text + position));
+        uint8x16_t stop = vceqq_u8(chunk, quotes);
+        stop = vorrq_u8(stop, vceqq_u8(chunk, vdupq_n_u8('\n')));
+        stop = vorrq_u8(stop, vceqq_u8(chunk, vdupq_n_u8('\\')));
+        uint64_t mask = nibbleMask(stop);
+        if (mask != 0) {
+            return position + (__builtin_ctzll(mask) >> 2);
+        }
+        position += 16;
+    }
+    return skipQuotedScalar(text, position, size, quote);
+}
+
+static const CharScanner neonScanner = {skipBlanksNeon, skipWordNeon, skipQuotedNeon};
+
+#endif
+
+static bool isCharScanLevelSupported(CharScanLevel level) {
+    switch (level) {
+        case CHAR_SCAN_SCALAR:
+            return true;
+#ifdef PCC_SCAN_X86
+        case CHAR_SCAN_SSE2:
+            //part of x86-64 itself
+            return true;
+        case CHAR_SCAN_AVX2:
+            //the level is picked during static initialization, maybe before libgcc filled in the cpu model
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef PCC_SCAN_NEON
+        case CHAR_SCAN_NEON:
+            //part of arm64 itself
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static const CharScanner *scannerOf(CharScanLevel level) {
+    switch (level) {
+#ifdef PCC_SCAN_X86
+        case CHAR_SCAN_SSE2:
+            return &sse2Scanner;
+        case CHAR_SCAN_AVX2:
+            return &avx2Scanner;
+#endif
+#ifdef PCC_SCAN_NEON
+        case CHAR_SCAN_NEON:
+            return &neonScanner;
+#endif
+        default:
+            return &scalarScanner;
+    }
+}
+
+static CharScanLevel bestCharScanLevel() {
+    const CharScanLevel levels[] = {CHAR_SCAN_AVX2, CHAR_SCAN_NEON, CHAR_SCAN_SSE2};
+    for (CharScanLevel level: levels) {
+        if (isCharScanLevelSupported(level)) {
+            return level;
+        }
+    }
+    return CHAR_SCAN_SCALAR;
+}
+
+static CharScanLevel charScanLevel = bestCharScanLevel();
+
+CharScanner charScanner = *scannerOf(charScanLevel);
+
+CharScanLevel getCharScanLevel() {
+    return charScanLevel;
+}
+
+bool setCharScanLevel(CharScanLevel level) {
+    if (!isCharScanLevelSupported(level)) {
+        return false;
+    }
+    charScanLevel = level;
+    charScanner = *scannerOf(level);
+    return true;
+}
+
+const char *getCharScanLevelName(CharScanLevel level) {
+    switch (level) {
+        case CHAR_SCAN_SCALAR:
+            return "scalar";
+        case CHAR_SCAN_SSE2:
+            return "sse2";
+        case CHAR_SCAN_AVX2:
+            return "avx2";
+        case CHAR_SCAN_NEON:
+            return "neon";
+    }
+    return "unknown";
+}
@@ -0,0 +1,50 @@
+//
+// Created by Park Yu on 2024/12/16.
+//
+
+#ifndef PCC_CHARSCAN_H
+#define PCC_CHARSCAN_H
+
+#include <stdint.h>
+
+/**
+ * how wide the lexer skips runs of one character class, the widest the cpu supports is picked at startup.
+ */
+enum CharScanLevel {
+    CHAR_SCAN_SCALAR,
+    CHAR_SCAN_SSE2,
+    CHAR_SCAN_AVX2,
+    CHAR_SCAN_NEON,
+};
+
+typedef uint32_t (*CharScanFunction)(const char *text, uint32_t position, uint32_t size);
+
+typedef uint32_t (*QuotedScanFunction)(const char *text, uint32_t position, uint32_t size, char quote);
+
+struct CharScanner {
+    //first position from position on that is not ' ', '\t', '\n', '\v', '\f', '\r' or '\0'
+    CharScanFunction skipBlanks;
+    //first position from position on that may end a word: a blank, "[]{}(),;=+-*/%<>!&|'\"",
+    //or one of the rare bytes the vector test lumps in with them ('.', '#', '$', control characters).
+    //the lexer decides for that one byte and goes on
+    CharScanFunction skipWord;
+    //first position from position on that holds the quote, '\n' or '\\'
+    QuotedScanFunction skipQuoted;
+};
+
+/**
+ * the scanner of the current level, every function returns size when the run reaches it.
+ * reads stay inside [position, size).
+ */
+extern CharScanner charScanner;
+
+extern CharScanLevel getCharScanLevel();
+
+/**
+ * force a level, the benchmark compares them. false when this cpu or build can not run it.
+ */
+extern bool setCharScanLevel(CharScanLevel level);
+
+extern const char *getCharScanLevelName(CharScanLevel level);
+
+#endif //PCC_CHARSCAN_H
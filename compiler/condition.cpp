@@ -0,0 +1,422 @@
+//
+// Created by Park Yu on 2024/12/11.
+//
+
+#include <string.h>
+#include "condition.h"
+
+enum ConditionOperator {
+    COND_NONE,
+    COND_OR,
+    COND_AND,
+    COND_BIT_OR,
+    COND_BIT_XOR,
+    COND_BIT_AND,
+    COND_EQUAL,
+    COND_NOT_EQUAL,
+    COND_LESS,
+    COND_GREATER,
+    COND_LESS_EQUAL,
+    COND_GREATER_EQUAL,
+    COND_SHIFT_LEFT,
+    COND_SHIFT_RIGHT,
+    COND_ADD,
+    COND_SUB,
+    COND_MUL,
+    COND_DIV,
+    COND_MOD,
+};
+
+struct ConditionParser {
+    const char *text;
+    int length;
+    int position;
+    const char *errorMessage;
+};
+
+static bool isIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static void skipBlank(ConditionParser *parser) {
+    while (parser->position < parser->length) {
+        char c = parser->text[parser->position];
+        if (c == '/' && parser->position + 1 < parser->length && parser->text[parser->position + 1] == '/') {
+            parser->position = parser->length;
+            return;
+        }
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+            return;
+        }
+        parser->position++;
+    }
+}
+
+static bool fail(ConditionParser *parser, const char *errorMessage) {
+    if (parser->errorMessage == nullptr) {
+        parser->errorMessage = errorMessage;
+    }
+    return false;
+}
+
+/**
+ * binary operator at the current position, its precedence and its spelling length. 0 when there is none.
+ */
+static int peekOperator(ConditionParser *parser, ConditionOperator *op, int *spellingLength) {
+    skipBlank(parser);
+    if (parser->position >= parser->length) {
+        return 0;
+    }
+    char c = parser->text[parser->position];
+    char next = parser->position + 1 < parser->length ? parser->text[parser->position + 1] : '\0';
+    *spellingLength = 2;
+    switch (c) {
+        case '|':
+            if (next == '|') {
+                *op = COND_OR;
+                return 1;
+            }
+            *op = COND_BIT_OR;
+            *spellingLength = 1;
+            return 3;
+        case '&':
+            if (next == '&') {
+                *op = COND_AND;
+                return 2;
+            }
+            *op = COND_BIT_AND;
+            *spellingLength = 1;
+            return 5;
+        case '^':
+            *op = COND_BIT_XOR;
+            *spellingLength = 1;
+            return 4;
+        case '=':
+            if (next == '=') {
+                *op = COND_EQUAL;
+                return 6;
+            }
+            return 0;
+        case '!':
+            if (next == '=') {
+                *op = COND_NOT_EQUAL;
+                return 6;
+            }
+            return 0;
+        case '<':
+            if (next == '<') {
+                *op = COND_SHIFT_LEFT;
+                return 8;
+            }
+            if (next == '=') {
+                *op = COND_LESS_EQUAL;
+                return 7;
+            }
+            *op = COND_LESS;
+            *spellingLength = 1;
+            return 7;
+        case '>':
+            if (next == '>') {
+                *op = COND_SHIFT_RIGHT;
+                return 8;
+            }
+            if (next == '=') {
+                *op = COND_GREATER_EQUAL;
+                return 7;
+            }
+            *op = COND_GREATER;
+            *spellingLength = 1;
+            return 7;
+        case '+':
+            *op = COND_ADD;
+            *spellingLength = 1;
+            return 9;
+        case '-':
+            *op = COND_SUB;
+            *spellingLength = 1;
+            return 9;
+        case '*':
+            *op = COND_MUL;
+            *spellingLength = 1;
+            return 10;
+        case '/':
+            *op = COND_DIV;
+            *spellingLength = 1;
+            return 10;
+        case '%':
+            *op = COND_MOD;
+            *spellingLength = 1;
+            return 10;
+        default:
+            return 0;
+    }
+}
+
+static bool parseNumber(ConditionParser *parser, long long *value) {
+    const char *text = parser->text;
+    int i = parser->position;
+    unsigned long long result = 0;
+    int base = 10;
+    if (text[i] == '0' && i + 1 < parser->length && (text[i + 1] == 'x' || text[i + 1] == 'X')) {
+        base = 16;
+        i += 2;
+    } else if (text[i] == '0') {
+        base = 8;
+    }
+    for (; i < parser->length; i++) {
+        char c = text[i];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (base == 16 && c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (base == 16 && c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            break;
+        }
+        if (digit >= base) {
+            return fail(parser, "invalid digit in integer constant");
+        }
+        result = result * base + digit;
+    }
+    //u, l, ul, ll suffixes
+    while (i < parser->length && (text[i] == 'u' || text[i] == 'U' || text[i] == 'l' || text[i] == 'L')) {
+        i++;
+    }
+    if (i < parser->length && (isIdentifierChar(text[i]) || text[i] == '.')) {
+        return fail(parser, "only integer constants are allowed");
+    }
+    parser->position = i;
+    *value = (long long) result;
+    return true;
+}
+
+static bool parseCharacter(ConditionParser *parser, long long *value) {
+    const char *text = parser->text;
+    int i = parser->position + 1;
+    if (i >= parser->length) {
+        return fail(parser, "unterminated character constant");
+    }
+    char c = text[i++];
+    if (c == '\\' && i < parser->length) {
+        char escaped = text[i++];
+        switch (escaped) {
+            case 'n':
+                c = '\n';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case '0':
+                c = '\0';
+                break;
+            default:
+                c = escaped;
+        }
+    }
+    if (i >= parser->length || text[i] != '\'') {
+        return fail(parser, "unterminated character constant");
+    }
+    parser->position = i + 1;
+    *value = c;
+    return true;
+}
+
+static bool parseConditional(ConditionParser *parser, bool evaluate, long long *value);
+
+/**
+ * evaluate is false on the dead side of &&, || and ?:, a division by zero there is no error.
+ */
+static bool parseUnary(ConditionParser *parser, bool evaluate, long long *value) {
+    skipBlank(parser);
+    if (parser->position >= parser->length) {
+        return fail(parser, "expression expected");
+    }
+    char c = parser->text[parser->position];
+    if (c == '!' || c == '~' || c == '-' || c == '+') {
+        parser->position++;
+        if (!parseUnary(parser, evaluate, value)) {
+            return false;
+        }
+        if (c == '!') {
+            *value = !*value;
+        } else if (c == '~') {
+            *value = ~*value;
+        } else if (c == '-') {
+            *value = (long long) (0ULL - (unsigned long long) *value);
+        }
+        return true;
+    }
+    if (c == '(') {
+        parser->position++;
+        if (!parseConditional(parser, evaluate, value)) {
+            return false;
+        }
+        skipBlank(parser);
+        if (parser->position >= parser->length || parser->text[parser->position] != ')') {
+            return fail(parser, "missing ')'");
+        }
+        parser->position++;
+        return true;
+    }
+    if (c >= '0' && c <= '9') {
+        return parseNumber(parser, value);
+    }
+    if (c == '\'') {
+        return parseCharacter(parser, value);
+    }
+    if (isIdentifierChar(c)) {
+        //not a macro, evaluates to 0
+        while (parser->position < parser->length && isIdentifierChar(parser->text[parser->position])) {
+            parser->position++;
+        }
+        *value = 0;
+        return true;
+    }
+    return fail(parser, "unexpected character in expression");
+}
+
+static bool applyOperator(ConditionParser *parser, ConditionOperator op, long long left, long long right,
+                          bool evaluate, long long *value) {
+    switch (op) {
+        case COND_OR:
+            *value = left || right;
+            break;
+        case COND_AND:
+            *value = left && right;
+            break;
+        case COND_BIT_OR:
+            *value = left | right;
+            break;
+        case COND_BIT_XOR:
+            *value = left ^ right;
+            break;
+        case COND_BIT_AND:
+            *value = left & right;
+            break;
+        case COND_EQUAL:
+            *value = left == right;
+            break;
+        case COND_NOT_EQUAL:
+            *value = left != right;
+            break;
+        case COND_LESS:
+            *value = left < right;
+            break;
+        case COND_GREATER:
+            *value = left > right;
+            break;
+        case COND_LESS_EQUAL:
+            *value = left <= right;
+            break;
+        case COND_GREATER_EQUAL:
+            *value = left >= right;
+            break;
+        case COND_SHIFT_LEFT:
+            *value = (long long) ((unsigned long long) left << (right & 63));
+            break;
+        case COND_SHIFT_RIGHT:
+            *value = left >> (right & 63);
+            break;
+        case COND_ADD:
+            *value = (long long) ((unsigned long long) left + (unsigned long long) right);
+            break;
+        case COND_SUB:
+            *value = (long long) ((unsigned long long) left - (unsigned long long) right);
+            break;
+        case COND_MUL:
+            *value = (long long) ((unsigned long long) left * (unsigned long long) right);
+            break;
+        case COND_DIV:
+        case COND_MOD:
+            if (right == 0) {
+                //0 && 1 / 0 is fine, the division is never evaluated
+                if (evaluate) {
+                    return fail(parser, "division by zero");
+                }
+                *value = 0;
+            } else if (right == -1) {
+                *value = op == COND_DIV ? (long long) (0ULL - (unsigned long long) left) : 0;
+            } else {
+                *value = op == COND_DIV ? left / right : left % right;
+            }
+            break;
+        case COND_NONE:
+            break;
+    }
+    return true;
+}
+
+/**
+ * precedence climbing, only operators binding at least as tight as minPrecedence are taken.
+ */
+static bool parseBinary(ConditionParser *parser, int minPrecedence, bool evaluate, long long *value) {
+    if (!parseUnary(parser, evaluate, value)) {
+        return false;
+    }
+    for (;;) {
+        ConditionOperator op = COND_NONE;
+        int spellingLength = 0;
+        int precedence = peekOperator(parser, &op, &spellingLength);
+        if (precedence == 0 || precedence < minPrecedence) {
+            return true;
+        }
+        parser->position += spellingLength;
+        bool evaluateRight = evaluate;
+        if ((op == COND_AND && !*value) || (op == COND_OR && *value)) {
+            evaluateRight = false;
+        }
+        long long right = 0;
+        if (!parseBinary(parser, precedence + 1, evaluateRight, &right)) {
+            return false;
+        }
+        if (!applyOperator(parser, op, *value, right, evaluateRight, value)) {
+            return false;
+        }
+    }
+}
+
+static bool parseConditional(ConditionParser *parser, bool evaluate, long long *value) {
+    if (!parseBinary(parser, 1, evaluate, value)) {
+        return false;
+    }
+    skipBlank(parser);
+    if (parser->position >= parser->length || parser->text[parser->position] != '?') {
+        return true;
+    }
+    parser->position++;
+    long long trueValue = 0;
+    if (!parseConditional(parser, evaluate && *value, &trueValue)) {
+        return false;
+    }
+    skipBlank(parser);
+    if (parser->position >= parser->length || parser->text[parser->position] != ':') {
+        return fail(parser, "missing ':' in conditional expression");
+    }
+    parser->position++;
+    long long falseValue = 0;
+    if (!parseConditional(parser, evaluate && !*value, &falseValue)) {
+        return false;
+    }
+    *value = *value ? trueValue : falseValue;
+    return true;
+}
+
+bool evaluateCondition(const char *expression, int length, long long *value, const char **errorMessage) {
+    ConditionParser parser = {expression, length, 0, nullptr};
+    *value = 0;
+    if (!parseConditional(&parser, true, value)) {
+        *errorMessage = parser.errorMessage;
+        return false;
+    }
+    skipBlank(&parser);
+    if (parser.position < parser.length) {
+        *errorMessage = "unexpected text after expression";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,15 @@
+//
+// Created by Park Yu on 2024/12/11.
+//
+
+#ifndef PCC_CONDITION_H
+#define PCC_CONDITION_H
+
+/**
+ * evaluate the integer constant expression of an #if or #elif.
+ * macros and defined are already replaced, identifiers left over count as 0.
+ * false on a syntax error or a division by zero, errorMessage says why.
+ */
+extern bool evaluateCondition(const char *expression, int length, long long *value, const char **errorMessage);
+
+#endif //PCC_CONDITION_H
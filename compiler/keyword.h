@@ -0,0 +1,152 @@
+//
+// Created by Park Yu on 2024/12/17.
+//
+
+#ifndef PCC_KEYWORD_H
+#define PCC_KEYWORD_H
+
+#include <stdint.h>
+#include <string.h>
+#include "token.h"
+#include "ast.h"
+
+struct ReservedWord {
+    const char *spelling;
+    uint8_t length;
+    TokenType tokenType;
+    TokenKind kind;
+    //TYPE_UNKNOWN for keywords
+    PrimitiveType primitiveType;
+};
+
+#define PCC_KEYWORD_ENTRY(kind, spelling) {spelling, sizeof(spelling) - 1, TOKEN_KEYWORD, kind, TYPE_UNKNOWN},
+#define PCC_TYPE_NAME_ENTRY(kind, spelling, primitiveType) \
+    {spelling, sizeof(spelling) - 1, TOKEN_TYPE, kind, primitiveType},
+
+/**
+ * every reserved word, the one at index i has the TokenKind i + 1.
+ */
+static constexpr ReservedWord reservedWords[] = {
+        PCC_KEYWORDS(PCC_KEYWORD_ENTRY)
+        PCC_TYPE_NAMES(PCC_TYPE_NAME_ENTRY)
+};
+
+#define RESERVED_WORD_COUNT (sizeof(reservedWords) / sizeof(reservedWords[0]))
+//slots of the perfect hash, a power of two a few times the word count keeps the seed search short
+#define RESERVED_WORD_TABLE_BITS 6
+#define RESERVED_WORD_TABLE_SIZE (1u << RESERVED_WORD_TABLE_BITS)
+//the seed search gives up after this many tries, then the table needs more bits
+#define RESERVED_WORD_SEED_TRIES 100000
+
+static_assert(RESERVED_WORD_COUNT * 2 <= RESERVED_WORD_TABLE_SIZE, "too many reserved words for the hash table");
+
+static constexpr uint32_t maxReservedWordLength() {
+    uint32_t length = 0;
+    for (const ReservedWord &word: reservedWords) {
+        length = word.length > length ? word.length : length;
+    }
+    return length;
+}
+
+static constexpr bool isReservedWordOrderKept() {
+    for (uint32_t i = 0; i < RESERVED_WORD_COUNT; i++) {
+        if (reservedWords[i].kind != i + 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isReservedWordOrderKept(), "the reserved words must open TokenKind, in the order of their lists");
+
+/**
+ * the first two bytes, the last one and the length, these tell every reserved word apart.
+ * a one byte word reads its first byte twice.
+ */
+static constexpr uint32_t reservedWordKey(const char *word, uint32_t length) {
+    return (uint32_t) (uint8_t) word[0]
+           | (uint32_t) (uint8_t) word[length > 1 ? 1 : 0] << 8
+           | (uint32_t) (uint8_t) word[length - 1] << 16
+           | length << 24;
+}
+
+static constexpr uint32_t reservedWordSlot(uint32_t key, uint32_t seed) {
+    return (key * seed) >> (32 - RESERVED_WORD_TABLE_BITS);
+}
+
+static constexpr bool isPerfectSeed(uint32_t seed) {
+    bool used[RESERVED_WORD_TABLE_SIZE] = {};
+    for (const ReservedWord &word: reservedWords) {
+        uint32_t slot = reservedWordSlot(reservedWordKey(word.spelling, word.length), seed);
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+/**
+ * the first odd multiplier that puts every reserved word in a slot of its own, 0 when there is none.
+ */
+static constexpr uint32_t findPerfectSeed() {
+    uint32_t seed = 0x9e3779b1u;
+    for (uint32_t i = 0; i < RESERVED_WORD_SEED_TRIES; i++, seed += 2) {
+        if (isPerfectSeed(seed)) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+static constexpr uint32_t RESERVED_WORD_SEED = findPerfectSeed();
+
+static_assert(RESERVED_WORD_SEED != 0, "no perfect hash for the reserved words, raise RESERVED_WORD_TABLE_BITS");
+
+/**
+ * index + 1 of the reserved word in each slot, 0 for an empty slot. a lookup is one probe and one compare.
+ */
+struct ReservedWordTable {
+    uint8_t slots[RESERVED_WORD_TABLE_SIZE];
+
+    constexpr ReservedWordTable() : slots() {
+        for (uint32_t i = 0; i < RESERVED_WORD_COUNT; i++) {
+            const ReservedWord &word = reservedWords[i];
+            slots[reservedWordSlot(reservedWordKey(word.spelling, word.length), RESERVED_WORD_SEED)] = i + 1;
+        }
+    }
+};
+
+static constexpr ReservedWordTable reservedWordTable;
+
+static constexpr uint32_t MAX_RESERVED_WORD_LENGTH = maxReservedWordLength();
+
+/**
+ * the reserved word spelled by word[0, length), nullptr for anything else.
+ */
+static inline const ReservedWord *findReservedWord(const char *word, uint32_t length) {
+    if (length == 0 || length > MAX_RESERVED_WORD_LENGTH) {
+        return nullptr;
+    }
+    uint8_t index = reservedWordTable.slots[reservedWordSlot(reservedWordKey(word, length), RESERVED_WORD_SEED)];
+    if (index == 0) {
+        return nullptr;
+    }
+    const ReservedWord *reserved = &reservedWords[index - 1];
+    if (reserved->length != length || memcmp(reserved->spelling, word, length) != 0) {
+        return nullptr;
+    }
+    return reserved;
+}
+
+/**
+ * the reserved word of a keyword or type token, nullptr for every other kind.
+ */
+static inline const ReservedWord *getReservedWord(TokenKind kind) {
+    if (kind == KIND_NONE || kind > RESERVED_WORD_COUNT) {
+        return nullptr;
+    }
+    return &reservedWords[kind - 1];
+}
+
+#endif //PCC_KEYWORD_H
@@ -1,31 +1,32 @@
 //
 // Created by Park Yu on 2024/9/11.
 //
-#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "lexer.h"
 #include "logger.h"
 #include "mspace.h"
+#include "intern.h"
+#include "charscan.h"
+#include "keyword.h"
 
 static const char *LEXER_TAG = "lexer";
 static const char *VAR_TAG = "var";
 
-static const char *keywords[] = {"if", "else", "for", "while", "return", "extern"};
-static const size_t keywordSize = 6;
-
-static const char *types[] = {"void", "char", "int", "short", "long", "float", "double"};
-static const size_t typeSize = 7;
+static MemSpace *lexerSpace = pccCreateSpace(LEXER_TAG);
+//string literals outlive the token list, mir keeps referencing them
+static MemSpace *varSpace = pccCreateSpace(VAR_TAG);
 
 static const char boundaries[] = "[]{}(),;";
 static const size_t boundarySize = 8;
 
-static const char operators[] = "=+-*/<>!";
-static const size_t operatorSize = 8;
+static const char operators[] = "=+-*/%<>!";
+static const size_t operatorSize = 9;
 
 const char *getTokenTypeName(TokenType tokenType) {
     switch (tokenType) {
-        case TOKEN_HEAD:
-            return "head";
+        case TOKEN_END:
+            return "end";
         case TOKEN_BOUNDARY:
             return "boundary";
         case TOKEN_OPERATOR:
@@ -56,296 +57,686 @@ const char *getTokenTypeName(TokenType tokenType) {
     return "unknown";
 }
 
-static void trimString(ProcessedSource *source) {
-    int startIndex = -1;
-    int endIndex = -1;
-    for (int i = 0; i < source->length; i++) {
-        if (startIndex == -1) {
-            if (source->line[i] == ' ') {
-                continue;
-            }
-            startIndex = i;
+enum CharClass {
+    //letters, digits and everything else that glues into a word: '.', a single '|'...
+    CHAR_WORD,
+    CHAR_SPACE,
+    CHAR_BOUNDARY,
+    CHAR_OPERATOR,
+    CHAR_STAR,
+    CHAR_AMPERSAND,
+    CHAR_PIPE,
+    CHAR_QUOTE,
+    CHAR_DOUBLE_QUOTE,
+};
+
+/**
+ * one class per byte, the scanner dispatches on it instead of searching the character sets.
+ * single character tokens point at a static spelling, only words and two character tokens are copied.
+ * kinds is the TokenKind of a single character punctuator, assignKinds the one of that character followed by '='.
+ */
+struct CharTable {
+    unsigned char classes[256];
+    char spellings[256][2];
+    unsigned char kinds[256];
+    unsigned char assignKinds[256];
+
+    CharTable() : classes(), spellings(), kinds(), assignKinds() {
+        for (int c = 0; c < 256; c++) {
+            spellings[c][0] = (char) c;
         }
-        if (source->line[i] == '\n' || source->line[i] == '\0') {
-            endIndex = i;
-            break;
+        classes[(unsigned char) ' '] = CHAR_SPACE;
+        classes[(unsigned char) '\t'] = CHAR_SPACE;
+        classes[(unsigned char) '\r'] = CHAR_SPACE;
+        classes[(unsigned char) '\n'] = CHAR_SPACE;
+        classes[(unsigned char) '\v'] = CHAR_SPACE;
+        classes[(unsigned char) '\f'] = CHAR_SPACE;
+        classes[0] = CHAR_SPACE;
+        for (size_t i = 0; i < boundarySize; i++) {
+            classes[(unsigned char) boundaries[i]] = CHAR_BOUNDARY;
+        }
+        for (size_t i = 0; i < operatorSize; i++) {
+            classes[(unsigned char) operators[i]] = CHAR_OPERATOR;
         }
+        classes[(unsigned char) '*'] = CHAR_STAR;
+        classes[(unsigned char) '&'] = CHAR_AMPERSAND;
+        classes[(unsigned char) '|'] = CHAR_PIPE;
+        classes[(unsigned char) '\''] = CHAR_QUOTE;
+        classes[(unsigned char) '\"'] = CHAR_DOUBLE_QUOTE;
+
+        kinds[(unsigned char) '['] = KIND_LEFT_BRACKET;
+        kinds[(unsigned char) ']'] = KIND_RIGHT_BRACKET;
+        kinds[(unsigned char) '{'] = KIND_LEFT_BRACE;
+        kinds[(unsigned char) '}'] = KIND_RIGHT_BRACE;
+        kinds[(unsigned char) '('] = KIND_LEFT_PAREN;
+        kinds[(unsigned char) ')'] = KIND_RIGHT_PAREN;
+        kinds[(unsigned char) ','] = KIND_COMMA;
+        kinds[(unsigned char) ';'] = KIND_SEMICOLON;
+        kinds[(unsigned char) '='] = KIND_ASSIGN;
+        kinds[(unsigned char) '+'] = KIND_PLUS;
+        kinds[(unsigned char) '-'] = KIND_MINUS;
+        kinds[(unsigned char) '*'] = KIND_STAR;
+        kinds[(unsigned char) '/'] = KIND_SLASH;
+        kinds[(unsigned char) '%'] = KIND_PERCENT;
+        kinds[(unsigned char) '<'] = KIND_LESS;
+        kinds[(unsigned char) '>'] = KIND_GREATER;
+        kinds[(unsigned char) '!'] = KIND_NOT;
+        kinds[(unsigned char) '&'] = KIND_AMPERSAND;
+
+        assignKinds[(unsigned char) '='] = KIND_EQUAL;
+        assignKinds[(unsigned char) '!'] = KIND_NOT_EQUAL;
+        assignKinds[(unsigned char) '<'] = KIND_LESS_EQUAL;
+        assignKinds[(unsigned char) '>'] = KIND_GREATER_EQUAL;
+        assignKinds[(unsigned char) '+'] = KIND_PLUS_ASSIGN;
+        assignKinds[(unsigned char) '-'] = KIND_MINUS_ASSIGN;
+        assignKinds[(unsigned char) '/'] = KIND_SLASH_ASSIGN;
+        assignKinds[(unsigned char) '%'] = KIND_PERCENT_ASSIGN;
     }
-    int size = endIndex - startIndex;
-    for (int i = 0; i < size; i++) {
-        source->line[i] = source->line[i + startIndex];
+};
+
+static const CharTable charTable;
+
+/**
+ * a token as the scanner sees it, a span of the preprocessed text.
+ * string and char literals span their content without the quotes.
+ */
+struct LexToken {
+    uint32_t offset;
+    uint32_t length;
+    TokenType type;
+    TokenKind kind;
+};
+
+struct Scanner {
+    const char *text;
+    uint32_t position;
+    uint32_t size;
+};
+
+#define SPELLING_BLOCK_SIZE 16384
+//tokens in the window of a stream, the same 64KB serve the whole translation unit
+#define TOKEN_WINDOW_SIZE 4096
+//a source without includes has one run
+#define FILE_RUN_CAPACITY 16
+//lexed text is handed back to the os in steps of at least this many bytes
+#define TEXT_DISCARD_SIZE (1024 * 1024)
+#define SHORT_WORD_LENGTH 16
+
+static char *spellingBlock = nullptr;
+static size_t spellingBlockLeft = 0;
+
+//interned once per compilation, a keyword token needs no table lookup
+static const char *reservedSpellings[RESERVED_WORD_COUNT];
+
+static inline unsigned char classOf(char c) {
+    return charTable.classes[(unsigned char) c];
+}
+
+static void initWordTables() {
+    for (uint32_t i = 0; i < RESERVED_WORD_COUNT; i++) {
+        reservedSpellings[i] = internString(reservedWords[i].spelling, reservedWords[i].length);
     }
-    source->line[size] = '\0';
 }
 
-inline static bool isBoolOperator(char a) {
-    if (a == '|' || a == '&') {
-        return true;
+static void classifyWord(const char *word, LexToken *token) {
+    token->kind = KIND_NONE;
+    if (word[0] >= '0' && word[0] <= '9') {
+        token->type = TOKEN_INTEGER;
+        return;
     }
-    return false;
+    const ReservedWord *reserved = findReservedWord(word, token->length);
+    if (reserved != nullptr) {
+        token->type = reserved->tokenType;
+        token->kind = reserved->kind;
+        return;
+    }
+    token->type = TOKEN_IDENTIFIER;
 }
 
-inline static bool isOperator(char a) {
-    for (int i = 0; i < operatorSize; i++) {
-        if (operators[i] == a)return true;
+static void reportLexError(ProcessedSource *source, uint32_t offset, const char *message) {
+    //binary search the line table, only on the error path
+    uint32_t low = 0;
+    uint32_t high = source->lineCount;
+    while (high - low > 1) {
+        uint32_t middle = low + (high - low) / 2;
+        if (source->lines[middle].offset <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
     }
-    return false;
+    if (source->lineCount == 0) {
+        loge(LEXER_TAG, "%s", message);
+    } else {
+        const SourceLine *line = &source->lines[low];
+        loge(LEXER_TAG, "%s:%u: %s", source->fileNames[line->fileIndex], line->lineNumber, message);
+    }
+    exit(-1);
 }
 
-inline static bool isBoundary(char a) {
-    for (int i = 0; i < boundarySize; i++) {
-        if (boundaries[i] == a) {
+/**
+ * scan a quoted literal starting after the opening quote, a backslash escapes the next character.
+ * false when the line or the buffer ends first.
+ */
+static bool scanQuoted(Scanner *scanner, char quote, LexToken *token) {
+    const char *text = scanner->text;
+    uint32_t position = scanner->position;
+    token->offset = position;
+    while (position < scanner->size) {
+        position = charScanner.skipQuoted(text, position, scanner->size, quote);
+        if (position >= scanner->size) {
+            break;
+        }
+        char c = text[position];
+        if (c == quote) {
+            token->length = position - token->offset;
+            scanner->position = position + 1;
             return true;
         }
+        if (c == '\n') {
+            break;
+        }
+        if (c == '\\' && position + 1 < scanner->size) {
+            position++;
+        }
+        position++;
     }
+    scanner->position = position;
     return false;
 }
 
-inline static bool isDoubleQuotation(char a) {
-    return a == '\"';
+/**
+ * the next token of the buffer, false at the end.
+ */
+static bool nextToken(Scanner *scanner, ProcessedSource *source, LexToken *token) {
+    const char *text = scanner->text;
+    uint32_t position = scanner->position;
+    //most gaps are a single space, the char scanner only pays off for indentation and blank lines
+    if (position < scanner->size && classOf(text[position]) == CHAR_SPACE) {
+        position++;
+        if (position < scanner->size && classOf(text[position]) == CHAR_SPACE) {
+            position = charScanner.skipBlanks(text, position, scanner->size);
+        }
+    }
+    if (position >= scanner->size) {
+        scanner->position = position;
+        return false;
+    }
+    token->offset = position;
+    char c = text[position];
+    char next = position + 1 < scanner->size ? text[position + 1] : '\0';
+    token->kind = (TokenKind) charTable.kinds[(unsigned char) c];
+    switch (classOf(c)) {
+        case CHAR_BOUNDARY:
+            token->type = TOKEN_BOUNDARY;
+            token->length = 1;
+            break;
+        case CHAR_STAR:
+            token->type = TOKEN_POINTER_OPERATOR;
+            token->length = 1;
+            break;
+        case CHAR_OPERATOR:
+            if (next == '=') {
+                token->type = TOKEN_OPERATOR_2;
+                token->kind = (TokenKind) charTable.assignKinds[(unsigned char) c];
+                token->length = 2;
+            } else {
+                token->type = TOKEN_OPERATOR;
+                token->length = 1;
+            }
+            break;
+        case CHAR_AMPERSAND:
+            if (next == '&') {
+                token->type = TOKEN_BOOL;
+                token->kind = KIND_AND;
+                token->length = 2;
+            } else {
+                token->type = TOKEN_POINTER_OPERATOR;
+                token->length = 1;
+            }
+            break;
+        case CHAR_QUOTE:
+        case CHAR_DOUBLE_QUOTE:
+            scanner->position = position + 1;
+            if (!scanQuoted(scanner, c, token)) {
+                reportLexError(source, position,
+                               c == '\'' ? "unterminated char literal" : "unterminated string literal");
+            }
+            token->type = c == '\'' ? TOKEN_CHAR : TOKEN_CHARS;
+            token->kind = KIND_NONE;
+            return true;
+        case CHAR_PIPE:
+            if (next == '|') {
+                token->type = TOKEN_BOOL;
+                token->kind = KIND_OR;
+                token->length = 2;
+                break;
+            }
+            //a single '|' is part of a word
+            [[fallthrough]];
+        default: {
+            uint32_t end = position + 1;
+            //the text is null terminated and '\0' is a space, no bound check needed.
+            //short words end before a vector compare pays off, past SHORT_WORD_LENGTH the char scanner skips
+            //to the next byte that may end the word and the class table decides that byte
+            for (;;) {
+                unsigned char charClass = classOf(text[end]);
+                if (charClass == CHAR_WORD || (charClass == CHAR_PIPE && text[end + 1] != '|')) {
+                    end++;
+                    if (end - position >= SHORT_WORD_LENGTH) {
+                        end = charScanner.skipWord(text, end, scanner->size);
+                    }
+                } else {
+                    break;
+                }
+            }
+            token->length = end - position;
+            classifyWord(text + position, token);
+        }
+    }
+    scanner->position = position + token->length;
+    return true;
 }
 
-inline static bool isQuotation(char a) {
-    return a == '\'';
+/**
+ * the token array doubles when full, buildTokens sizes it for a token every 4 bytes.
+ */
+static Token *appendToken(TokenList *list, uint32_t *capacity) {
+    if (list->count + 1 >= *capacity) {
+        uint32_t newCapacity = *capacity * 2;
+        Token *tokens = pccNewArray<Token>(lexerSpace, newCapacity);
+        memcpy(tokens, list->tokens, list->count * sizeof(Token));
+        pccSpaceFree(lexerSpace, list->tokens);
+        list->tokens = tokens;
+        *capacity = newCapacity;
+    }
+    return &list->tokens[list->count++];
 }
 
-inline static bool isEscape(char a) {
-    return a == '\\';
+//string literals are carved out of larger blocks, one space allocation per block instead of per literal
+//zero filled, the caller writes at most length bytes and keeps the terminator
+static char *newSpelling(uint32_t length) {
+    size_t size = length + 1;
+    if (size > SPELLING_BLOCK_SIZE / 4) {
+        return pccNewArray<char>(varSpace, size);
+    }
+    if (size > spellingBlockLeft) {
+        spellingBlock = pccNewArray<char>(varSpace, SPELLING_BLOCK_SIZE);
+        spellingBlockLeft = SPELLING_BLOCK_SIZE;
+    }
+    char *spelling = spellingBlock;
+    spellingBlock += size;
+    spellingBlockLeft -= size;
+    return spelling;
 }
 
-inline static bool isPointer(char a) {
-    return a == '*';
+/**
+ * the content of a string literal with its escapes resolved.
+ */
+static char *copyStringContent(const char *text, uint32_t length) {
+    char *copy = newSpelling(length);
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (c == '\\' && i + 1 < length) {
+            c = text[++i];
+            switch (c) {
+                case 'n':
+                    c = '\n';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                case 't':
+                    c = '\t';
+                    break;
+                case 'b':
+                    c = '\b';
+                    break;
+                case 'a':
+                    c = '\a';
+                    break;
+                case 'f':
+                    c = '\f';
+                    break;
+                case 'v':
+                    c = '\v';
+                    break;
+                default:
+                    //\" \' \\ and the rest stand for the character itself
+                    break;
+            }
+        }
+        copy[size++] = c;
+    }
+    return copy;
 }
 
-inline static bool isGetAddress(char a) {
-    return a == '&';
+static const char *tokenContent(const char *text, const LexToken *lexToken) {
+    const char *spelling = text + lexToken->offset;
+    switch (lexToken->type) {
+        case TOKEN_CHARS:
+            return copyStringContent(spelling, lexToken->length);
+        case TOKEN_BOUNDARY:
+        case TOKEN_OPERATOR:
+        case TOKEN_POINTER_OPERATOR:
+            return charTable.spellings[(unsigned char) spelling[0]];
+        case TOKEN_KEYWORD:
+        case TOKEN_TYPE:
+            return reservedSpellings[lexToken->kind - 1];
+        case TOKEN_INTEGER: {
+            //only ever parsed for its value, not worth a table slot
+            char *copy = newSpelling(lexToken->length);
+            memcpy(copy, spelling, lexToken->length);
+            return copy;
+        }
+        default:
+            //words, two character operators and char literals, each spelling is stored once
+            return internString(spelling, lexToken->length);
+    }
 }
 
-inline static char *makeCharsCopy(const char *origin) {
-    int length = strlen(origin) + 1;
-    char *copy = (char *) pccMalloc(VAR_TAG, sizeof(char) * length);
-    strcpy(copy, origin);
-    return copy;
+/**
+ * a source being lexed. a type is only emitted once the token after it is known, "char *" is one pointer type
+ * token, the token read ahead waits in pending.
+ */
+struct Lexer {
+    ProcessedSource *source;
+    Scanner scanner;
+    //the line of the current token, tokens come in text order so it only moves forward
+    uint32_t lineIndex;
+    //the file of the current token, the caller records it with setTokenFile
+    uint32_t fileIndex;
+    bool hasPending;
+    LexToken pending;
+};
+
+static void initLexer(Lexer *lexer, ProcessedSource *source) {
+    logd(LEXER_TAG, "lexical analysis...");
+    initWordTables();
+    lexer->source = source;
+    lexer->scanner = {source->text, 0, (uint32_t) source->size};
+    lexer->lineIndex = 0;
+    lexer->fileIndex = 0;
+    lexer->hasPending = false;
 }
 
-inline static bool strEmpty(const char *tmp) {
-    if (tmp == nullptr || strlen(tmp) == 0) {
-        return true;
+/**
+ * interned copies of the source's file names followed by room for extraCount more,
+ * file names outlive the preprocessor, the parser reports errors with them.
+ */
+static const char **copyFileNames(ProcessedSource *source, uint32_t extraCount) {
+    if (source->fileCount + extraCount > UINT16_MAX) {
+        loge(LEXER_TAG, "too many source files: %u", source->fileCount + extraCount);
+        exit(-1);
     }
-    return false;
+    const char **fileNames = pccNewArray<const char *>(lexerSpace, source->fileCount + extraCount);
+    for (uint32_t i = 0; i < source->fileCount; i++) {
+        fileNames[i] = internCString(source->fileNames[i]);
+    }
+    return fileNames;
 }
 
-inline static Token *processCompletedString(Token *tail, const char *tmp) {
-    if (strEmpty(tmp)) {
-        return tail;
-    }
-    if (tmp[0] >= '0' && tmp[0] <= '9') {
-        //integer
-        Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-        token->tokenType = TOKEN_INTEGER;
-        token->content = makeCharsCopy(tmp);
-        tail->next = token;
-        tail = token;
-        goto finish;
-    } else {
-        for (int i = 0; i < keywordSize; i++) {
-            if (strcmp(keywords[i], tmp) == 0) {
-                Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-                token->tokenType = TOKEN_KEYWORD;
-                token->content = makeCharsCopy(tmp);
-                tail->next = token;
-                tail = token;
-                goto finish;
-            }
-        }
-        for (int i = 0; i < typeSize; i++) {
-            if (strcmp(types[i], tmp) == 0) {
-                Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-                token->tokenType = TOKEN_TYPE;
-                token->content = makeCharsCopy(tmp);
-                tail->next = token;
-                tail = token;
-                goto finish;
+/**
+ * the next token of the source with its location, false at the end.
+ */
+static bool lexToken(Lexer *lexer, Token *token) {
+    ProcessedSource *source = lexer->source;
+    LexToken lexToken;
+    if (lexer->hasPending) {
+        lexToken = lexer->pending;
+        lexer->hasPending = false;
+    } else if (!nextToken(&lexer->scanner, source, &lexToken)) {
+        return false;
+    }
+    token->tokenType = lexToken.type;
+    if (lexToken.type == TOKEN_TYPE) {
+        //a '*' after a type is folded into it, anything else is the next token
+        if (nextToken(&lexer->scanner, source, &lexer->pending)) {
+            if (lexer->pending.kind == KIND_STAR) {
+                token->tokenType = TOKEN_POINTER_TYPE;
+            } else {
+                lexer->hasPending = true;
             }
         }
-        Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-        token->tokenType = TOKEN_IDENTIFIER;
-        token->content = makeCharsCopy(tmp);
-        tail->next = token;
-        tail = token;
-    }
-    finish:
-    memset(((void *) tmp), 0, 256);
-    return tail;
+    }
+    uint32_t lineIndex = lexer->lineIndex;
+    while (lineIndex + 1 < source->lineCount && source->lines[lineIndex + 1].offset <= lexToken.offset) {
+        lineIndex++;
+    }
+    lexer->lineIndex = lineIndex;
+    token->kind = lexToken.kind;
+    token->content = tokenContent(source->text, &lexToken);
+    if (source->lineCount > 0) {
+        const SourceLine *line = &source->lines[lineIndex];
+        //a literal starts at its quote
+        uint32_t start = lexToken.type == TOKEN_CHARS || lexToken.type == TOKEN_CHAR
+                         ? lexToken.offset - 1 : lexToken.offset;
+        uint32_t column = start - line->offset + 1;
+        lexer->fileIndex = line->fileIndex;
+        token->line = line->lineNumber;
+        token->column = column < UINT16_MAX ? column : UINT16_MAX;
+    }
+    return true;
 }
 
-static Token *lexer(Token *tail, const char *buffer) {
-    size_t length = strlen(buffer);
-    char tmp[256];
-    memset(((void *) tmp), 0, 256);
-    bool nextCharEscape = false;
-    bool inStringSession = false;
-    bool inCharSession = false;
-    int charCount = 0;
-    for (int i = 0; i < length; i++) {
-        if (inStringSession && isEscape(buffer[i])) {
-            nextCharEscape = true;
-            continue;
-        } else if (nextCharEscape) {
-            if (buffer[i] == 'n') {
-                snprintf(tmp, 256, "%s\n", tmp);
-            } else if (buffer[i] == 'r') {
-                snprintf(tmp, 256, "%s\r", tmp);
-            } else if (buffer[i] == 't') {
-                snprintf(tmp, 256, "%s\t", tmp);
-            } else if (buffer[i] == 'b') {
-                snprintf(tmp, 256, "%s\b", tmp);
-            } else if (buffer[i] == '\"') {
-                snprintf(tmp, 256, "%s\"", tmp);
-            } else if (buffer[i] == '\'') {
-                snprintf(tmp, 256, "%s\'", tmp);
-            }
-            nextCharEscape = false;
-            continue;
-        } else if (isQuotation(buffer[i])) {
-            if (!inCharSession) {
-                tail = processCompletedString(tail, tmp);
-            } else {
-                Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-                token->tokenType = TOKEN_CHAR;
-                token->content = makeCharsCopy(tmp);
-                tail->next = token;
-                tail = token;
-                memset(((void *) tmp), 0, 256);
-            }
-            inCharSession = !inCharSession;
-            continue;
-        } else if (isDoubleQuotation(buffer[i])) {
-            if (!inStringSession) {
-                tail = processCompletedString(tail, tmp);
-            } else {
-                Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-                token->tokenType = TOKEN_CHARS;
-                token->content = makeCharsCopy(tmp);
-                tail->next = token;
-                tail = token;
-                memset(((void *) tmp), 0, 256);
-            }
-            inStringSession = !inStringSession;
-            continue;
-        } else if (inStringSession) {
-            snprintf(tmp, 256, "%s%c", tmp, buffer[i]);
-            nextCharEscape = false;
-            continue;
-        } else if (buffer[i] == ' ') {
-            tail = processCompletedString(tail, tmp);
-            continue;
-        } else if (isPointer(buffer[i])) {
-            if (tail->tokenType == TOKEN_TYPE) {
-                tail->tokenType = TOKEN_POINTER_TYPE;
-                continue;
-            } else {
-                tail = processCompletedString(tail, tmp);
-                Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-                token->tokenType = TOKEN_POINTER_OPERATOR;
-                char *content = (char *) pccMalloc(VAR_TAG, sizeof(char) * 2);
-                content[0] = buffer[i];
-                content[1] = '\0';
-                token->content = content;
-                tail->next = token;
-                tail = token;
-                continue;
-            }
-        } else if (isBoundary(buffer[i])) {
-            tail = processCompletedString(tail, tmp);
-            Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-            token->tokenType = TOKEN_BOUNDARY;
-            char *content = (char *) pccMalloc(VAR_TAG, sizeof(char) * 2);
-            content[0] = buffer[i];
-            content[1] = '\0';
-            token->content = content;
-            tail->next = token;
-            tail = token;
-        } else if (isOperator(buffer[i])) {
-            tail = processCompletedString(tail, tmp);
-            if (i + 1 < length && buffer[i + 1] == '=') {
-                //double operator
-                Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-                token->tokenType = TOKEN_OPERATOR_2;
-                char *content = (char *) pccMalloc(VAR_TAG, sizeof(char) * 3);
-                content[0] = buffer[i];
-                content[1] = buffer[i + 1];
-                content[2] = '\0';
-                token->content = content;
-                tail->next = token;
-                tail = token;
-                i++;
-            } else {
-                //single operator
-                Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-                token->tokenType = TOKEN_OPERATOR;
-                char *content = (char *) pccMalloc(VAR_TAG, sizeof(char) * 2);
-                content[0] = buffer[i];
-                content[1] = '\0';
-                token->content = content;
-                tail->next = token;
-                tail = token;
+/**
+ * the end token sits right after the last line.
+ */
+static void setEndToken(Lexer *lexer, Token *end) {
+    ProcessedSource *source = lexer->source;
+    end->tokenType = TOKEN_END;
+    end->kind = KIND_NONE;
+    end->content = "";
+    if (source->lineCount > 0) {
+        const SourceLine *line = &source->lines[source->lineCount - 1];
+        lexer->fileIndex = line->fileIndex;
+        end->line = line->lineNumber;
+        end->column = line->length < UINT16_MAX ? line->length + 1 : UINT16_MAX;
+    }
+}
+
+static void logLexerStat(uint64_t tokenCount, size_t size) {
+    logd(LEXER_TAG, "%llu tokens from %zu bytes", (unsigned long long) tokenCount, size);
+    InternStat internStat;
+    getInternStat(&internStat);
+    logd(LEXER_TAG, "interned %u strings, %llu bytes: %llu lookups, %.2f probes per lookup",
+         internStat.stringCount, (unsigned long long) internStat.stringBytes,
+         (unsigned long long) internStat.lookups,
+         internStat.lookups == 0 ? 0.0 : (double) internStat.probes / internStat.lookups);
+}
+
+TokenList *buildTokens(ProcessedSource *source) {
+    Lexer lexer;
+    initLexer(&lexer, source);
+    TokenList *list = pccNew<TokenList>(lexerSpace);
+    list->files.names = copyFileNames(source, 0);
+    list->files.nameCount = source->fileCount;
+    //ordinary code has a token every 4 to 6 bytes, denser text doubles the array once or twice
+    uint32_t capacity = (uint32_t) (source->size / 4) + 64;
+    list->tokens = pccNewArray<Token>(lexerSpace, capacity);
+    Token token;
+    while (lexToken(&lexer, &token)) {
+        setTokenFile(&list->files, list->count, lexer.fileIndex, lexerSpace);
+        *appendToken(list, &capacity) = token;
+    }
+    //no capacity check, appendToken always leaves room for the end token
+    setEndToken(&lexer, &list->tokens[list->count]);
+    setTokenFile(&list->files, list->count, lexer.fileIndex, lexerSpace);
+    logLexerStat(list->count, source->size);
+    return list;
+}
+
+/**
+ * the lexer's side of a TokenStream: the precompiled tokens still to hand out, then the source.
+ */
+struct TokenStreamSource {
+    Lexer lexer;
+    TokenList *prefix;
+    uint32_t prefixIndex;
+    //the run of prefix the token at prefixIndex is in
+    uint32_t prefixRun;
+    uint64_t tokenCount;
+    //text and lines before these were lexed and handed back to the os
+    uint32_t discardedText;
+    uint32_t discardedLines;
+};
+
+/**
+ * token contents are copied out of the text when lexed, everything before the line of the last token is dead.
+ * it goes back a few pages at a time, a 1M line source never sits in memory next to its tokens.
+ */
+static void discardLexedText(TokenStreamSource *streamSource) {
+    Lexer *lexer = &streamSource->lexer;
+    ProcessedSource *source = lexer->source;
+    if (source->lineCount == 0) {
+        return;
+    }
+    uint32_t lexedText = source->lines[lexer->lineIndex].offset;
+    if (lexedText - streamSource->discardedText < TEXT_DISCARD_SIZE) {
+        return;
+    }
+    pccDiscardPages(source->text + streamSource->discardedText, lexedText - streamSource->discardedText);
+    streamSource->discardedText = lexedText;
+    pccDiscardPages(source->lines + streamSource->discardedLines,
+                    (lexer->lineIndex - streamSource->discardedLines) * sizeof(SourceLine));
+    streamSource->discardedLines = lexer->lineIndex;
+}
+
+/**
+ * lex until the window is full or the end token is in it.
+ */
+static void fillTokenStream(TokenStream *stream) {
+    TokenStreamSource *streamSource = stream->source;
+    Token *limit = stream->window + TOKEN_WINDOW_SIZE;
+    while (stream->end < limit) {
+        Token *token = stream->end;
+        uint32_t tokenIndex = stream->windowStart + (uint32_t) (token - stream->window);
+        TokenList *prefix = streamSource->prefix;
+        if (prefix != nullptr && streamSource->prefixIndex < prefix->count) {
+            const TokenFiles *prefixFiles = &prefix->files;
+            while (streamSource->prefixRun + 1 < prefixFiles->runCount
+                   && prefixFiles->runs[streamSource->prefixRun + 1].firstToken <= streamSource->prefixIndex) {
+                streamSource->prefixRun++;
             }
-        } else if (isBoolOperator(buffer[i])
-                   && i + 1 < length
-                   && buffer[i + 1] == buffer[i]) {
-            tail = processCompletedString(tail, tmp);
-            Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-            token->tokenType = TOKEN_BOOL;
-            char *content = (char *) pccMalloc(VAR_TAG, sizeof(char) * 3);
-            content[0] = buffer[i];
-            content[1] = buffer[i + 1];
-            content[2] = '\0';
-            token->content = content;
-            tail->next = token;
-            tail = token;
-            i++;
-        } else if (isGetAddress(buffer[i])) {
-            tail = processCompletedString(tail, tmp);
-            Token *token = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-            token->tokenType = TOKEN_POINTER_OPERATOR;
-            char *content = (char *) pccMalloc(VAR_TAG, sizeof(char) * 2);
-            content[0] = buffer[i];
-            content[1] = '\0';
-            token->content = content;
-            tail->next = token;
-            tail = token;
+            //the precompiled files are named after the source's
+            setTokenFile(&stream->files, tokenIndex,
+                         prefixFiles->runs[streamSource->prefixRun].fileIndex + streamSource->lexer.source->fileCount,
+                         lexerSpace);
+            *token = prefix->tokens[streamSource->prefixIndex++];
+        } else if (lexToken(&streamSource->lexer, token)) {
+            setTokenFile(&stream->files, tokenIndex, streamSource->lexer.fileIndex, lexerSpace);
         } else {
-            snprintf(tmp, 256, "%s%c", tmp, buffer[i]);
+            setEndToken(&streamSource->lexer, token);
+            setTokenFile(&stream->files, tokenIndex, streamSource->lexer.fileIndex, lexerSpace);
+            stream->end++;
+            stream->ended = true;
+            logLexerStat(streamSource->tokenCount, streamSource->lexer.source->size);
+            break;
         }
+        if (stream->printTokens) {
+            logd(LEXER_TAG, "%s :%s", getTokenTypeName(token->tokenType), token->content);
+        }
+        stream->end++;
+        streamSource->tokenCount++;
     }
-    tail = processCompletedString(tail, tmp);
-    return tail;
+    discardLexedText(streamSource);
 }
 
-Token *buildTokens(ProcessedSource *source) {
-    logd(LEXER_TAG, "lexical analysis...");
-    Token *tokenHead = (Token *) (pccMalloc(LEXER_TAG, sizeof(Token)));
-    tokenHead->tokenType = TOKEN_HEAD;
-    Token *tokenTail = tokenHead;
-    while (source != nullptr) {
-        trimString(source);
-        tokenTail = lexer(tokenTail, source->line);
-        source = source->next;
-    }
-    return tokenHead;
+TokenStream *openTokenStream(ProcessedSource *source, TokenList *prefix, bool printTokens) {
+    TokenStreamSource *streamSource = pccNew<TokenStreamSource>(lexerSpace);
+    initLexer(&streamSource->lexer, source);
+    streamSource->prefix = prefix;
+    TokenStream *stream = pccNew<TokenStream>(lexerSpace);
+    stream->source = streamSource;
+    stream->window = pccNewArray<Token>(lexerSpace, TOKEN_WINDOW_SIZE);
+    stream->end = stream->window;
+    uint32_t prefixFileCount = prefix != nullptr ? prefix->files.nameCount : 0;
+    stream->files.names = copyFileNames(source, prefixFileCount);
+    for (uint32_t i = 0; i < prefixFileCount; i++) {
+        stream->files.names[source->fileCount + i] = prefix->files.names[i];
+    }
+    stream->files.nameCount = source->fileCount + prefixFileCount;
+    stream->printTokens = printTokens;
+    fillTokenStream(stream);
+    return stream;
+}
+
+TokenStream *openTokenListStream(TokenList *tokens) {
+    TokenStream *stream = pccNew<TokenStream>(lexerSpace);
+    stream->window = tokens->tokens;
+    //the end token is in the window
+    stream->end = tokens->tokens + tokens->count + 1;
+    stream->ended = true;
+    stream->files = tokens->files;
+    return stream;
 }
 
-void printTokenStack(Token *tokens) {
-    Token *p = tokens;
-    while (p != nullptr) {
-        if (p->tokenType != TOKEN_HEAD) {
-            logd(LEXER_TAG, "%s :%s", getTokenTypeName(p->tokenType), p->content);
+TokenList *drainTokenStream(TokenStream *stream) {
+    TokenList *list = pccNew<TokenList>(lexerSpace);
+    uint32_t capacity = TOKEN_WINDOW_SIZE;
+    list->tokens = pccNewArray<Token>(lexerSpace, capacity);
+    Token *token = stream->window;
+    while (token->tokenType != TOKEN_END) {
+        *appendToken(list, &capacity) = *token;
+        token = advanceTokenStream(stream, token);
+    }
+    //appendToken always leaves room for the end token
+    list->tokens[list->count] = *token;
+    //the stream was not advanced before, its token indexes are the list's
+    list->files = stream->files;
+    return list;
+}
+
+Token *refillTokenStream(TokenStream *stream, Token *current) {
+    Token *keep = current - TOKEN_STREAM_HISTORY;
+    if (keep < stream->window) {
+        keep = stream->window;
+    }
+    size_t keptCount = stream->end - keep;
+    stream->windowStart += (uint32_t) (keep - stream->window);
+    memmove(stream->window, keep, keptCount * sizeof(Token));
+    current = stream->window + (current - keep);
+    stream->end = stream->window + keptCount;
+    fillTokenStream(stream);
+    return current;
+}
+
+void setTokenFile(TokenFiles *files, uint32_t tokenIndex, uint32_t fileIndex, MemSpace *space) {
+    if (files->runCount > 0 && files->runs[files->runCount - 1].fileIndex == fileIndex) {
+        return;
+    }
+    if (files->runCount == files->runCapacity) {
+        uint32_t newCapacity = files->runCapacity == 0 ? FILE_RUN_CAPACITY : files->runCapacity * 2;
+        TokenFileRun *runs = pccNewArray<TokenFileRun>(space, newCapacity);
+        if (files->runs != nullptr) {
+            memcpy(runs, files->runs, files->runCount * sizeof(TokenFileRun));
+            pccSpaceFree(space, files->runs);
         }
-        p = p->next;
+        files->runs = runs;
+        files->runCapacity = newCapacity;
     }
+    files->runs[files->runCount++] = {tokenIndex, fileIndex};
+}
+
+const char *getTokenFileName(const TokenFiles *files, uint32_t tokenIndex) {
+    if (files->runCount == 0) {
+        return "";
+    }
+    //the last run starting at or before tokenIndex
+    uint32_t low = 0;
+    uint32_t high = files->runCount - 1;
+    while (low < high) {
+        uint32_t middle = (low + high + 1) / 2;
+        if (files->runs[middle].firstToken <= tokenIndex) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return files->names[files->runs[low].fileIndex];
 }
 
 void releaseLexerMemory() {
-    pccFreeSpace(LEXER_TAG);
-}
\ No newline at end of file
+    pccResetSpace(lexerSpace);
+}
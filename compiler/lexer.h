@@ -7,10 +7,63 @@
 
 #include "token.h"
 #include "preprocessor.h"
+#include "mspace.h"
 
-extern Token *buildTokens(ProcessedSource *source);
+/**
+ * every token of source in one list, for -emit-pch and the benchmarks. the parser pulls from a TokenStream.
+ */
+extern TokenList *buildTokens(ProcessedSource *source);
 
-extern void printTokenStack(Token *tokens);
+//tokens after the current one that are always in a stream's window
+#define TOKEN_STREAM_LOOKAHEAD 1
+//tokens before the current one kept when the window slides, errors are reported at the previous token
+#define TOKEN_STREAM_HISTORY 1
+
+/**
+ * lex source on demand, the precompiled tokens of prefix (nullptr without a pch) come first.
+ * the source must stay alive until the parser is done, its lexed text is handed back to the os on the way.
+ * printTokens logs every token, the stream lives until releaseLexerMemory.
+ */
+extern TokenStream *openTokenStream(ProcessedSource *source, TokenList *prefix, bool printTokens);
+
+/**
+ * a stream over tokens lexed before, the whole list is its window, the benchmarks parse apart from lexing.
+ */
+extern TokenStream *openTokenListStream(TokenList *tokens);
+
+/**
+ * lex what is left of stream into one list, for the parallel parser: it looks at every method at once.
+ * the stream must not have been advanced, it is done afterwards.
+ */
+extern TokenList *drainTokenStream(TokenStream *stream);
+
+/**
+ * slide the window: drop the tokens before current but TOKEN_STREAM_HISTORY and lex as many as fit.
+ * returns where current is now, every other pointer into the window is stale.
+ */
+extern Token *refillTokenStream(TokenStream *stream, Token *current);
+
+/**
+ * the token after current, the token after that one is always readable too.
+ */
+static inline Token *advanceTokenStream(TokenStream *stream, Token *current) {
+    current++;
+    if (current + TOKEN_STREAM_LOOKAHEAD >= stream->end && !stream->ended) {
+        current = refillTokenStream(stream, current);
+    }
+    return current;
+}
+
+/**
+ * the tokens from tokenIndex on are in names[fileIndex], a new run starts only where the file changes.
+ * runs grow in space, the space of the list or stream.
+ */
+extern void setTokenFile(TokenFiles *files, uint32_t tokenIndex, uint32_t fileIndex, MemSpace *space);
+
+/**
+ * the file name of the token at tokenIndex, a binary search of the runs for the error path.
+ */
+extern const char *getTokenFileName(const TokenFiles *files, uint32_t tokenIndex);
 
 extern void releaseLexerMemory();
 
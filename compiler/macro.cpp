@@ -0,0 +1,757 @@
+//
+// Created by Park Yu on 2024/12/10.
+//
+
+#include <string.h>
+#include "macro.h"
+#include "logger.h"
+#include "mspace.h"
+#include "hash.h"
+
+static const char *MACRO_TAG = "macro";
+
+static MemSpace *macroSpace = pccCreateSpace(MACRO_TAG);
+
+#define INIT_MACRO_TABLE_CAPACITY 256
+#define INIT_TEXT_CAPACITY 256
+//nested invocations, a macro is disabled while its replacement is rescanned, so only arguments nest deeper
+#define MAX_EXPAND_DEPTH 256
+#define MAX_MACRO_PARAMS 128
+#define VA_ARGS "__VA_ARGS__"
+#define VA_ARGS_LEN 11
+
+enum MacroItemType {
+    //text of the replacement list, copied as is
+    ITEM_TEXT,
+    //parameter, replaced by the fully expanded argument
+    ITEM_PARAM,
+    //parameter next to ##, replaced by the argument as written
+    ITEM_PARAM_RAW,
+    //#parameter, replaced by the argument as a string literal
+    ITEM_STRINGIFY,
+};
+
+/**
+ * the replacement list is split once at #define time, expansion only walks the items.
+ * ITEM_TEXT covers body[offset, offset + length), the other kinds use param.
+ */
+struct MacroItem {
+    MacroItemType type;
+    uint32_t param;
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct Macro {
+    const char *name;
+    int nameLength;
+    bool defined;
+    bool functionLike;
+    bool variadic;
+    //set while the replacement list is rescanned, the recursion guard
+    bool expanding;
+    uint32_t paramCount;
+    //"NAME(params) body" as written after #define, a precompiled header replays it
+    const char *definition;
+    int definitionLength;
+    //the replacement list, a suffix of definition
+    const char *body;
+    MacroItem *items;
+    uint32_t itemCount;
+};
+
+/**
+ * open addressing, linear probing. #undef keeps the slot and clears defined,
+ * a later #define of the same name reuses it.
+ */
+struct MacroSlot {
+    uint64_t hash;
+    Macro *macro;
+};
+
+struct MacroTable {
+    MacroSlot *slots;
+    uint32_t capacity;
+    //used slots, defined or not
+    uint32_t count;
+    //a name can only be a macro when its first char and length were seen in a #define
+    bool firstChars[256];
+    int maxNameLength;
+};
+
+struct TextBuffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+};
+
+struct ArgRange {
+    //raw argument, a view into the text being scanned
+    const char *raw;
+    int rawLength;
+    //expanded argument, an offset into ExpandFrame::args
+    size_t offset;
+    size_t length;
+};
+
+/**
+ * scratch space of one expansion depth, reused by every invocation at that depth.
+ */
+struct ExpandFrame {
+    TextBuffer args;
+    TextBuffer body;
+    ArgRange *ranges;
+    uint32_t rangeCapacity;
+};
+
+static MacroTable macroTable;
+static MacroStat macroStat;
+static ExpandFrame *expandFrames = nullptr;
+static TextBuffer expandedLine;
+//the source line ended inside the argument list of this invocation
+static const Macro *openInvocation = nullptr;
+//#if expression with defined already replaced
+static TextBuffer conditionLine;
+
+static bool isIdentifierStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool isIdentifierChar(char c) {
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static int skipBlank(const char *text, int index, int length) {
+    while (index < length && isBlank(text[index])) {
+        index++;
+    }
+    return index;
+}
+
+/**
+ * index is on the opening quote, returns the index after the closing one.
+ */
+static int skipLiteral(const char *text, int index, int length) {
+    char quote = text[index++];
+    while (index < length && text[index] != quote) {
+        if (text[index] == '\\') {
+            index++;
+        }
+        index++;
+    }
+    return index < length ? index + 1 : length;
+}
+
+static void reserveText(TextBuffer *buffer, size_t required) {
+    if (required <= buffer->capacity) {
+        return;
+    }
+    size_t newCapacity = buffer->capacity == 0 ? INIT_TEXT_CAPACITY : buffer->capacity;
+    while (newCapacity < required) {
+        newCapacity *= 2;
+    }
+    char *newData = pccNewArray<char>(macroSpace, newCapacity);
+    if (buffer->data != nullptr) {
+        memcpy(newData, buffer->data, buffer->size);
+        pccSpaceFree(macroSpace, buffer->data);
+    }
+    buffer->data = newData;
+    buffer->capacity = newCapacity;
+}
+
+static void appendText(TextBuffer *buffer, const char *text, size_t length) {
+    reserveText(buffer, buffer->size + length);
+    memcpy(buffer->data + buffer->size, text, length);
+    buffer->size += length;
+}
+
+void initMacroTable() {
+    memset(&macroTable, 0, sizeof(MacroTable));
+    macroTable.capacity = INIT_MACRO_TABLE_CAPACITY;
+    macroTable.slots = pccNewArray<MacroSlot>(macroSpace, macroTable.capacity);
+    macroStat = {0, 0, 0, 0};
+    expandFrames = pccNewArray<ExpandFrame>(macroSpace, MAX_EXPAND_DEPTH);
+    expandedLine = {nullptr, 0, 0};
+    conditionLine = {nullptr, 0, 0};
+}
+
+static MacroSlot *findMacroSlot(const char *name, int length, uint64_t hash) {
+    uint32_t mask = macroTable.capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        macroStat.probes++;
+        MacroSlot *slot = &macroTable.slots[i];
+        if (slot->macro == nullptr) {
+            return slot;
+        }
+        if (slot->hash == hash && slot->macro->nameLength == length
+            && memcmp(slot->macro->name, name, length) == 0) {
+            return slot;
+        }
+    }
+}
+
+static void growMacroTable() {
+    MacroSlot *oldSlots = macroTable.slots;
+    uint32_t oldCapacity = macroTable.capacity;
+    macroTable.capacity = oldCapacity * 2;
+    macroTable.slots = pccNewArray<MacroSlot>(macroSpace, macroTable.capacity);
+    uint32_t mask = macroTable.capacity - 1;
+    for (uint32_t i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].macro == nullptr) {
+            continue;
+        }
+        uint32_t index = oldSlots[i].hash & mask;
+        while (macroTable.slots[index].macro != nullptr) {
+            index = (index + 1) & mask;
+        }
+        macroTable.slots[index] = oldSlots[i];
+    }
+    pccSpaceFree(macroSpace, oldSlots);
+}
+
+static Macro *lookupMacro(const char *name, int length) {
+    if (macroStat.macroCount == 0
+        || !macroTable.firstChars[(unsigned char) name[0]]
+        || length > macroTable.maxNameLength) {
+        return nullptr;
+    }
+    macroStat.lookups++;
+    MacroSlot *slot = findMacroSlot(name, length, hashBytes(name, length));
+    if (slot->macro == nullptr || !slot->macro->defined) {
+        return nullptr;
+    }
+    return slot->macro;
+}
+
+bool isMacroDefined(const char *name, int length) {
+    return lookupMacro(name, length) != nullptr;
+}
+
+/**
+ * the replacement list without the blanks around it and without a trailing // comment.
+ */
+static int trimBody(const char *line, int start, int length) {
+    int end = start;
+    while (end < length) {
+        if (line[end] == '"' || line[end] == '\'') {
+            end = skipLiteral(line, end, length);
+        } else if (line[end] == '/' && end + 1 < length && line[end + 1] == '/') {
+            break;
+        } else {
+            end++;
+        }
+    }
+    while (end > start && isBlank(line[end - 1])) {
+        end--;
+    }
+    return end;
+}
+
+static int findParam(const char **params, const int *paramLengths, uint32_t paramCount,
+                     const char *name, int length) {
+    for (uint32_t i = 0; i < paramCount; i++) {
+        if (paramLengths[i] == length && memcmp(params[i], name, length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void addItem(Macro *macro, uint32_t *itemCapacity, MacroItemType type, uint32_t param,
+                    uint32_t offset, uint32_t length) {
+    if (type == ITEM_TEXT && length == 0) {
+        return;
+    }
+    if (macro->itemCount == *itemCapacity) {
+        uint32_t newCapacity = *itemCapacity == 0 ? 8 : *itemCapacity * 2;
+        MacroItem *newItems = pccNewArray<MacroItem>(macroSpace, newCapacity);
+        if (macro->items != nullptr) {
+            memcpy(newItems, macro->items, macro->itemCount * sizeof(MacroItem));
+            pccSpaceFree(macroSpace, macro->items);
+        }
+        macro->items = newItems;
+        *itemCapacity = newCapacity;
+    }
+    macro->items[macro->itemCount++] = {type, param, offset, length};
+}
+
+/**
+ * split the replacement list into text runs and parameter references.
+ * ## drops the blanks around it and turns its neighbouring parameters raw.
+ */
+static void compileBody(Macro *macro, const char **params, const int *paramLengths) {
+    const char *body = macro->body;
+    int length = strlen(body);
+    uint32_t itemCapacity = 0;
+    int textStart = 0;
+    bool pasteNext = false;
+    int i = 0;
+    while (i < length) {
+        char c = body[i];
+        if (c == '"' || c == '\'') {
+            i = skipLiteral(body, i, length);
+            continue;
+        }
+        if (c == '#' && i + 1 < length && body[i + 1] == '#') {
+            int textEnd = i;
+            while (textEnd > textStart && isBlank(body[textEnd - 1])) {
+                textEnd--;
+            }
+            addItem(macro, &itemCapacity, ITEM_TEXT, 0, textStart, textEnd - textStart);
+            if (textEnd == textStart && macro->itemCount > 0
+                && macro->items[macro->itemCount - 1].type == ITEM_PARAM) {
+                macro->items[macro->itemCount - 1].type = ITEM_PARAM_RAW;
+            }
+            i = skipBlank(body, i + 2, length);
+            textStart = i;
+            pasteNext = true;
+            continue;
+        }
+        if (c == '#' && macro->functionLike) {
+            int start = skipBlank(body, i + 1, length);
+            int end = start;
+            while (end < length && isIdentifierChar(body[end])) {
+                end++;
+            }
+            int param = findParam(params, paramLengths, macro->paramCount, body + start, end - start);
+            if (param < 0) {
+                loge(MACRO_TAG, "'#' is not followed by a macro parameter: %s", macro->body);
+                exit(-1);
+            }
+            addItem(macro, &itemCapacity, ITEM_TEXT, 0, textStart, i - textStart);
+            addItem(macro, &itemCapacity, ITEM_STRINGIFY, param, 0, 0);
+            i = end;
+            textStart = i;
+            pasteNext = false;
+            continue;
+        }
+        if (isIdentifierStart(c)) {
+            int start = i;
+            while (i < length && isIdentifierChar(body[i])) {
+                i++;
+            }
+            int param = findParam(params, paramLengths, macro->paramCount, body + start, i - start);
+            if (param >= 0) {
+                addItem(macro, &itemCapacity, ITEM_TEXT, 0, textStart, start - textStart);
+                bool pasted = pasteNext && start == textStart;
+                addItem(macro, &itemCapacity, pasted ? ITEM_PARAM_RAW : ITEM_PARAM, param, 0, 0);
+                textStart = i;
+            }
+            pasteNext = false;
+            continue;
+        }
+        if (c >= '0' && c <= '9') {
+            while (i < length && (isIdentifierChar(body[i]) || body[i] == '.')) {
+                i++;
+            }
+            pasteNext = false;
+            continue;
+        }
+        if (!isBlank(c)) {
+            pasteNext = false;
+        }
+        i++;
+    }
+    addItem(macro, &itemCapacity, ITEM_TEXT, 0, textStart, length - textStart);
+}
+
+void defineMacro(const char *line, int index, int length) {
+    int nameStart = skipBlank(line, index, length);
+    int nameEnd = nameStart;
+    while (nameEnd < length && isIdentifierChar(line[nameEnd])) {
+        nameEnd++;
+    }
+    if (nameEnd == nameStart || !isIdentifierStart(line[nameStart])) {
+        loge(MACRO_TAG, "macro name missing: %.*s", length, line);
+        exit(-1);
+    }
+    const char *params[MAX_MACRO_PARAMS];
+    int paramLengths[MAX_MACRO_PARAMS];
+    uint32_t paramCount = 0;
+    bool functionLike = nameEnd < length && line[nameEnd] == '(';
+    bool variadic = false;
+    int bodyStart = nameEnd;
+    if (functionLike) {
+        int i = skipBlank(line, nameEnd + 1, length);
+        while (i < length && line[i] != ')') {
+            if (paramCount == MAX_MACRO_PARAMS || variadic) {
+                loge(MACRO_TAG, "invalid macro parameter list: %.*s", length, line);
+                exit(-1);
+            }
+            if (i + 3 <= length && memcmp(line + i, "...", 3) == 0) {
+                params[paramCount] = VA_ARGS;
+                paramLengths[paramCount++] = VA_ARGS_LEN;
+                variadic = true;
+                i += 3;
+            } else {
+                int start = i;
+                while (i < length && isIdentifierChar(line[i])) {
+                    i++;
+                }
+                if (i == start) {
+                    loge(MACRO_TAG, "invalid macro parameter list: %.*s", length, line);
+                    exit(-1);
+                }
+                params[paramCount] = line + start;
+                paramLengths[paramCount++] = i - start;
+            }
+            i = skipBlank(line, i, length);
+            if (i < length && line[i] == ',') {
+                i = skipBlank(line, i + 1, length);
+            }
+        }
+        if (i >= length) {
+            loge(MACRO_TAG, "missing ')' in macro parameter list: %.*s", length, line);
+            exit(-1);
+        }
+        bodyStart = i + 1;
+    }
+    bodyStart = skipBlank(line, bodyStart, length);
+    int bodyEnd = trimBody(line, bodyStart, length);
+
+    int nameLength = nameEnd - nameStart;
+    //lookups run for every identifier of the source, keep probe chains short with a load factor under 1/2
+    if ((macroTable.count + 1) * 2 > macroTable.capacity) {
+        growMacroTable();
+    }
+    uint64_t hash = hashBytes(line + nameStart, nameLength);
+    MacroSlot *slot = findMacroSlot(line + nameStart, nameLength, hash);
+    Macro *macro = slot->macro;
+    if (macro == nullptr) {
+        macro = pccNew<Macro>(macroSpace);
+        char *name = pccNewArray<char>(macroSpace, nameLength + 1);
+        memcpy(name, line + nameStart, nameLength);
+        macro->name = name;
+        macro->nameLength = nameLength;
+        slot->hash = hash;
+        slot->macro = macro;
+        macroTable.count++;
+    } else if (macro->definition != nullptr) {
+        //redefinition, the old replacement list goes back to the space
+        pccSpaceFree(macroSpace, (void *) macro->definition);
+        if (macro->items != nullptr) {
+            pccSpaceFree(macroSpace, macro->items);
+        }
+    }
+    if (!macro->defined) {
+        macroStat.macroCount++;
+    }
+    macro->defined = true;
+    macro->functionLike = functionLike;
+    macro->variadic = variadic;
+    macro->expanding = false;
+    macro->paramCount = paramCount;
+    macro->definitionLength = bodyEnd - nameStart;
+    char *definition = pccNewArray<char>(macroSpace, macro->definitionLength + 1);
+    memcpy(definition, line + nameStart, macro->definitionLength);
+    macro->definition = definition;
+    macro->body = definition + (bodyStart - nameStart);
+    macro->items = nullptr;
+    macro->itemCount = 0;
+    compileBody(macro, params, paramLengths);
+    macroTable.firstChars[(unsigned char) macro->name[0]] = true;
+    if (nameLength > macroTable.maxNameLength) {
+        macroTable.maxNameLength = nameLength;
+    }
+}
+
+void undefineMacro(const char *line, int index, int length) {
+    int nameStart = skipBlank(line, index, length);
+    int nameEnd = nameStart;
+    while (nameEnd < length && isIdentifierChar(line[nameEnd])) {
+        nameEnd++;
+    }
+    Macro *macro = lookupMacro(line + nameStart, nameEnd - nameStart);
+    if (macro != nullptr) {
+        macro->defined = false;
+        macroStat.macroCount--;
+    }
+}
+
+/**
+ * index is on '(', split the arguments at top level commas.
+ * returns the index after ')', or -1 when the invocation is not closed on this line.
+ */
+static int collectArgs(const char *text, int index, int length, const Macro *macro, ExpandFrame *frame,
+                       uint32_t *argCount) {
+    uint32_t count = 0;
+    int depth = 0;
+    int argStart = index + 1;
+    for (int i = index + 1; i < length; i++) {
+        char c = text[i];
+        if (c == '"' || c == '\'') {
+            i = skipLiteral(text, i, length) - 1;
+            continue;
+        }
+        if (c == '(') {
+            depth++;
+            continue;
+        }
+        bool closing = c == ')' && depth == 0;
+        //the variadic parameter takes every remaining argument, commas included
+        bool separator = c == ',' && depth == 0 && !(macro->variadic && count + 1 == macro->paramCount);
+        if (c == ')' && depth > 0) {
+            depth--;
+            continue;
+        }
+        if (!closing && !separator) {
+            continue;
+        }
+        if (count == frame->rangeCapacity) {
+            uint32_t newCapacity = frame->rangeCapacity == 0 ? 8 : frame->rangeCapacity * 2;
+            ArgRange *newRanges = pccNewArray<ArgRange>(macroSpace, newCapacity);
+            if (frame->ranges != nullptr) {
+                memcpy(newRanges, frame->ranges, count * sizeof(ArgRange));
+                pccSpaceFree(macroSpace, frame->ranges);
+            }
+            frame->ranges = newRanges;
+            frame->rangeCapacity = newCapacity;
+        }
+        int start = skipBlank(text, argStart, i);
+        int end = i;
+        while (end > start && isBlank(text[end - 1])) {
+            end--;
+        }
+        frame->ranges[count].raw = text + start;
+        frame->ranges[count].rawLength = end - start;
+        count++;
+        argStart = i + 1;
+        if (closing) {
+            //"f()" is one empty argument, fine for a single parameter and for none
+            if (count == 1 && end == start && macro->paramCount == 0) {
+                count = 0;
+            }
+            *argCount = count;
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+static void appendStringified(TextBuffer *buffer, const char *text, int length) {
+    appendText(buffer, "\"", 1);
+    for (int i = 0; i < length; i++) {
+        if (text[i] == '"' || text[i] == '\\') {
+            appendText(buffer, "\\", 1);
+        }
+        appendText(buffer, text + i, 1);
+    }
+    appendText(buffer, "\"", 1);
+}
+
+static bool expandText(TextBuffer *out, const char *text, int length, int depth, bool lazy);
+
+/**
+ * write the replacement list of one invocation into frame->body, arguments already collected.
+ */
+static void substitute(const Macro *macro, ExpandFrame *frame, uint32_t argCount, int depth) {
+    frame->args.size = 0;
+    for (uint32_t i = 0; i < argCount; i++) {
+        ArgRange *range = &frame->ranges[i];
+        range->offset = frame->args.size;
+        expandText(&frame->args, range->raw, range->rawLength, depth + 1, false);
+        range->length = frame->args.size - range->offset;
+    }
+    frame->body.size = 0;
+    for (uint32_t i = 0; i < macro->itemCount; i++) {
+        const MacroItem *item = &macro->items[i];
+        //a missing trailing argument is empty
+        const ArgRange *range = item->type != ITEM_TEXT && item->param < argCount ? &frame->ranges[item->param]
+                                                                                   : nullptr;
+        switch (item->type) {
+            case ITEM_TEXT:
+                appendText(&frame->body, macro->body + item->offset, item->length);
+                break;
+            case ITEM_PARAM:
+                if (range != nullptr) {
+                    appendText(&frame->body, frame->args.data + range->offset, range->length);
+                }
+                break;
+            case ITEM_PARAM_RAW:
+                if (range != nullptr) {
+                    appendText(&frame->body, range->raw, range->rawLength);
+                }
+                break;
+            case ITEM_STRINGIFY:
+                appendStringified(&frame->body, range != nullptr ? range->raw : "", range != nullptr ? range->rawLength : 0);
+                break;
+        }
+    }
+}
+
+/**
+ * scan text token by token and write it to out with every invocation replaced and rescanned.
+ * lazy: nothing is written when no macro was expanded, the caller keeps the original text.
+ */
+static bool expandText(TextBuffer *out, const char *text, int length, int depth, bool lazy) {
+    if (depth >= MAX_EXPAND_DEPTH) {
+        loge(MACRO_TAG, "macro expansion nested too deep: %.*s", length, text);
+        exit(-1);
+    }
+    bool expanded = false;
+    int copyStart = 0;
+    int i = 0;
+    while (i < length) {
+        char c = text[i];
+        if (c == '"' || c == '\'') {
+            i = skipLiteral(text, i, length);
+            continue;
+        }
+        if (c == '/' && i + 1 < length && text[i + 1] == '/') {
+            break;
+        }
+        if (c >= '0' && c <= '9') {
+            //pp-number, 0x1F and 1e5 are not identifiers
+            while (i < length && (isIdentifierChar(text[i]) || text[i] == '.')) {
+                i++;
+            }
+            continue;
+        }
+        if (!isIdentifierStart(c)) {
+            i++;
+            continue;
+        }
+        int start = i;
+        while (i < length && isIdentifierChar(text[i])) {
+            i++;
+        }
+        Macro *macro = lookupMacro(text + start, i - start);
+        if (macro == nullptr || macro->expanding) {
+            continue;
+        }
+        ExpandFrame *frame = &expandFrames[depth];
+        uint32_t argCount = 0;
+        int end = i;
+        if (macro->functionLike) {
+            int open = skipBlank(text, i, length);
+            if (open >= length || text[open] != '(') {
+                //a function-like macro name without arguments is left alone
+                continue;
+            }
+            end = collectArgs(text, open, length, macro, frame, &argCount);
+            if (end < 0) {
+                if (depth == 0) {
+                    //the arguments may go on in the next source line, the caller decides
+                    openInvocation = macro;
+                    return false;
+                }
+                loge(MACRO_TAG, "unterminated invocation of macro %s: %.*s", macro->name, length, text);
+                exit(-1);
+            }
+            if (argCount > macro->paramCount && !macro->variadic) {
+                loge(MACRO_TAG, "macro %s takes %u arguments, %u given", macro->name, macro->paramCount, argCount);
+                exit(-1);
+            }
+        }
+        macroStat.expansions++;
+        appendText(out, text + copyStart, start - copyStart);
+        substitute(macro, frame, argCount, depth);
+        macro->expanding = true;
+        expandText(out, frame->body.data, frame->body.size, depth + 1, false);
+        macro->expanding = false;
+        expanded = true;
+        i = end;
+        copyStart = end;
+    }
+    if (expanded || !lazy) {
+        appendText(out, text + copyStart, length - copyStart);
+    }
+    return expanded;
+}
+
+const char *expandMacros(const char *line, int length, int *expandedLength) {
+    *expandedLength = length;
+    if (macroStat.macroCount == 0) {
+        return line;
+    }
+    expandedLine.size = 0;
+    openInvocation = nullptr;
+    if (!expandText(&expandedLine, line, length, 0, true)) {
+        return openInvocation != nullptr ? nullptr : line;
+    }
+    *expandedLength = expandedLine.size;
+    return expandedLine.data;
+}
+
+const char *expandCondition(const char *line, int index, int length, int *expandedLength) {
+    conditionLine.size = 0;
+    int copyStart = index;
+    int i = index;
+    while (i < length) {
+        char c = line[i];
+        if (c == '"' || c == '\'') {
+            i = skipLiteral(line, i, length);
+            continue;
+        }
+        if (c >= '0' && c <= '9') {
+            while (i < length && (isIdentifierChar(line[i]) || line[i] == '.')) {
+                i++;
+            }
+            continue;
+        }
+        if (!isIdentifierStart(c)) {
+            i++;
+            continue;
+        }
+        int start = i;
+        while (i < length && isIdentifierChar(line[i])) {
+            i++;
+        }
+        if (i - start != 7 || memcmp(line + start, "defined", 7) != 0) {
+            continue;
+        }
+        int nameStart = skipBlank(line, i, length);
+        bool parenthesized = nameStart < length && line[nameStart] == '(';
+        if (parenthesized) {
+            nameStart = skipBlank(line, nameStart + 1, length);
+        }
+        int nameEnd = nameStart;
+        while (nameEnd < length && isIdentifierChar(line[nameEnd])) {
+            nameEnd++;
+        }
+        int end = parenthesized ? skipBlank(line, nameEnd, length) : nameEnd;
+        if (nameEnd == nameStart || (parenthesized && (end >= length || line[end] != ')'))) {
+            loge(MACRO_TAG, "invalid use of defined: %.*s", length, line);
+            exit(-1);
+        }
+        appendText(&conditionLine, line + copyStart, start - copyStart);
+        appendText(&conditionLine, isMacroDefined(line + nameStart, nameEnd - nameStart) ? "1" : "0", 1);
+        i = parenthesized ? end + 1 : end;
+        copyStart = i;
+    }
+    appendText(&conditionLine, line + copyStart, length - copyStart);
+    expandedLine.size = 0;
+    openInvocation = nullptr;
+    expandText(&expandedLine, conditionLine.data, conditionLine.size, 0, false);
+    if (openInvocation != nullptr) {
+        loge(MACRO_TAG, "unterminated invocation of macro %s: %.*s", openInvocation->name, length, line);
+        exit(-1);
+    }
+    *expandedLength = expandedLine.size;
+    return expandedLine.data;
+}
+
+void visitMacros(MacroVisitor visitor, void *arg) {
+    for (uint32_t i = 0; i < macroTable.capacity; i++) {
+        Macro *macro = macroTable.slots[i].macro;
+        if (macro != nullptr && macro->defined) {
+            visitor(macro->definition, macro->definitionLength, arg);
+        }
+    }
+}
+
+void getMacroStat(MacroStat *stat) {
+    *stat = macroStat;
+}
+
+void releaseMacroMemory() {
+    memset(&macroTable, 0, sizeof(MacroTable));
+    expandFrames = nullptr;
+    expandedLine = {nullptr, 0, 0};
+    conditionLine = {nullptr, 0, 0};
+    pccResetSpace(macroSpace);
+}
@@ -0,0 +1,62 @@
+//
+// Created by Park Yu on 2024/12/10.
+//
+
+#ifndef PCC_MACRO_H
+#define PCC_MACRO_H
+
+#include <stdint.h>
+
+struct MacroStat {
+    //live definitions
+    uint32_t macroCount;
+    uint64_t lookups;
+    //slots visited by all lookups, probes / lookups is the average chain length
+    uint64_t probes;
+    uint64_t expansions;
+};
+
+/**
+ * start a compilation with an empty macro table.
+ */
+extern void initMacroTable();
+
+/**
+ * parse the rest of a #define line, index points right after "define".
+ * object-like and function-like macros, # and ## in the replacement list.
+ */
+extern void defineMacro(const char *line, int index, int length);
+
+/**
+ * parse the rest of a #undef line, index points right after "undef".
+ */
+extern void undefineMacro(const char *line, int index, int length);
+
+extern bool isMacroDefined(const char *name, int length);
+
+/**
+ * expand every macro invocation of one source line.
+ * returns line itself when nothing was expanded, otherwise a buffer valid until the next call.
+ * returns nullptr when the line ends inside the arguments of an invocation, call again with the next line joined.
+ */
+extern const char *expandMacros(const char *line, int length, int *expandedLength);
+
+/**
+ * prepare the expression of an #if or #elif, index points right after the directive name.
+ * defined X and defined(X) become 1 or 0 first, then every macro is expanded.
+ * returns a buffer valid until the next call.
+ */
+extern const char *expandCondition(const char *line, int index, int length, int *expandedLength);
+
+typedef void (*MacroVisitor)(const char *definition, int length, void *arg);
+
+/**
+ * visit every defined macro as the text after #define, defineMacro(definition, 0, length) restores it.
+ */
+extern void visitMacros(MacroVisitor visitor, void *arg);
+
+extern void getMacroStat(MacroStat *stat);
+
+extern void releaseMacroMemory();
+
+#endif //PCC_MACRO_H
@@ -6,9 +6,13 @@
 #include <mspace.h>
 
 #include "logger.h"
+#include "intern.h"
+#include "registry.h"
 
 #define MIR_TAG "mir"
 
+static MemSpace *mirSpace = pccCreateSpace(MIR_TAG);
+
 static MirData *firstMirData;
 static MirData *lastMirData;
 
@@ -32,7 +36,7 @@ static VarNode *currentStackVarNodeHead = nullptr;
 VarNode *getVarInfo(const char *identity) {
     VarNode *pVarNode = currentStackVarNodeHead;
     while (pVarNode != nullptr) {
-        if (pVarNode->identity == identity || strcmp(pVarNode->identity, identity) == 0) {
+        if (pVarNode->identity == identity) {
             return pVarNode;
         }
         pVarNode = pVarNode->next;
@@ -45,7 +49,7 @@ void addVarInfo(const char *identity, MirOperandType operandType) {
         loge(MIR_TAG, "internal error: operand type error %d", operandType.primitiveType);
         return;
     }
-    VarNode *varNode = (VarNode *) pccMalloc(MIR_TAG, sizeof(VarNode));
+    VarNode *varNode = pccNew<VarNode>(mirSpace);
     varNode->identity = identity;
     varNode->isPointer = operandType.isPointer;
     varNode->operandType = operandType;
@@ -66,54 +70,12 @@ void resetVarInfo() {
     while (pVarNode != nullptr) {
         VarNode *need2ReleaseNode = pVarNode;
         pVarNode = pVarNode->next;
-        free(need2ReleaseNode);
+        pccSpaceFree(mirSpace, need2ReleaseNode);
     }
     currentStackVarNodeHead = nullptr;
 }
 
 
-struct MethodNode {
-    const char *identity;
-    MirOperandType operandType;
-    bool isPointer;
-
-    MethodNode *next;
-};
-
-static MethodNode *methodNodeHead = nullptr;
-
-MethodNode *getMethodInfo(const char *identity) {
-    MethodNode *pMethodNode = methodNodeHead;
-    while (pMethodNode != nullptr) {
-        if (pMethodNode->identity == identity || strcmp(pMethodNode->identity, identity) == 0) {
-            return pMethodNode;
-        }
-        pMethodNode = pMethodNode->next;
-    }
-    return nullptr;
-}
-
-void addMethodInfo(const char *identity, MirOperandType operandType) {
-    if (operandType.primitiveType < 3) {
-        loge(MIR_TAG, "internal error: operand type error");
-        return;
-    }
-    MethodNode *pMethodNode = (MethodNode *) pccMalloc(MIR_TAG, sizeof(MethodNode));
-    pMethodNode->identity = identity;
-    pMethodNode->isPointer = operandType.isPointer;
-    pMethodNode->operandType = operandType;
-    if (methodNodeHead == nullptr) {
-        methodNodeHead = pMethodNode;
-    } else {
-        MethodNode *methodNode = methodNodeHead;
-        while (methodNode->next != nullptr) {
-            methodNode = methodNode->next;
-        }
-        methodNode->next = pMethodNode;
-    }
-    pMethodNode->next = nullptr;
-}
-
 static void startMirCodeSession() {
     if (firstMirCode != nullptr || mirCodeSessionStarted) {
         loge(MIR_TAG, "[-] already in mir code session");
@@ -247,13 +209,24 @@ MirOperandPrimitiveType convertAstType2MirType(AstType *astType) {
     }
 }
 
+/**
+ * the return type of the function the last call went to, the parser registered every callee.
+ */
+static MirOperandType getLastCalledReturnType() {
+    FunctionInfo *function = findFunction(lastCalledMethodIdentity);
+    lastCalledMethodIdentity = nullptr;
+    MirOperandType operandType;
+    operandType.primitiveType = convertAstType2MirType(&function->returnType);
+    return operandType;
+}
+
 static const char *convertOperand(MirOperand *mirOperand) {
     char *result = nullptr;
     if (mirOperand->type.isReturn) {
         return "[last ret]";
     }
     if (mirOperand->type.isPointer) {
-        result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 21);
+        result = pccNewArray<char>(mirSpace, 21);
         snprintf(result, 21, "[addr:%s]", mirOperand->identity);
         return result;
     }
@@ -261,27 +234,27 @@ static const char *convertOperand(MirOperand *mirOperand) {
         case OPERAND_IDENTITY:
             return mirOperand->identity;
         case OPERAND_INT8:
-            result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 21);
+            result = pccNewArray<char>(mirSpace, 21);
             snprintf(result, 21, "%d", mirOperand->dataInt8);
             return result;
         case OPERAND_INT16:
-            result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 21);
+            result = pccNewArray<char>(mirSpace, 21);
             snprintf(result, 21, "%d", mirOperand->dataInt16);
             return result;
         case OPERAND_INT32:
-            result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 21);
+            result = pccNewArray<char>(mirSpace, 21);
             snprintf(result, 21, "%d", mirOperand->dataInt32);
             return result;
         case OPERAND_INT64:
-            result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 21);
+            result = pccNewArray<char>(mirSpace, 21);
             snprintf(result, 21, "%lld", mirOperand->dataInt64);
             return result;
         case OPERAND_FLOAT32:
-            result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 21);
+            result = pccNewArray<char>(mirSpace, 21);
             snprintf(result, 21, "%f", mirOperand->dataFloat32);
             return result;
         case OPERAND_FLOAT64:
-            result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 21);
+            result = pccNewArray<char>(mirSpace, 21);
             snprintf(result, 21, "%f", mirOperand->dataFloat64);
             return result;
         case OPERAND_UNKNOWN:
@@ -435,38 +408,38 @@ void printMir(Mir *mir) {
 }
 
 static MirData *createMirData() {
-    MirData *mirData = (MirData *) pccMalloc(MIR_TAG, sizeof(MirData));
+    MirData *mirData = pccNew<MirData>(mirSpace);
     return mirData;
 }
 
 static MirCode *createMirCode(MirType mirType) {
-    MirCode *mirCode = (MirCode *) pccMalloc(MIR_TAG, sizeof(MirCode));
+    MirCode *mirCode = pccNew<MirCode>(mirSpace);
     mirCode->mirType = mirType;
     switch (mirType) {
         case MIR_3: {
-            mirCode->mir3 = (Mir3 *) pccMalloc(MIR_TAG, sizeof(Mir3));
+            mirCode->mir3 = pccNew<Mir3>(mirSpace);
             break;
         }
         case MIR_2: {
-            mirCode->mir2 = (Mir2 *) pccMalloc(MIR_TAG, sizeof(Mir2));
+            mirCode->mir2 = pccNew<Mir2>(mirSpace);
             break;
         }
         case MIR_CMP: {
-            mirCode->mirCmp = (MirCmp *) pccMalloc(MIR_TAG, sizeof(MirCmp));
+            mirCode->mirCmp = pccNew<MirCmp>(mirSpace);
             break;
         }
         case MIR_CALL: {
-            mirCode->mirCall = (MirCall *) pccMalloc(MIR_TAG, sizeof(MirCall));
+            mirCode->mirCall = pccNew<MirCall>(mirSpace);
             break;
         }
         case MIR_RET: {
-            mirCode->mirRet = (MirRet *) pccMalloc(MIR_TAG, sizeof(MirRet));
+            mirCode->mirRet = pccNew<MirRet>(mirSpace);
             break;
         }
             //reuse this
         case MIR_JMP:
         case MIR_LABEL: {
-            mirCode->mirLabel = (MirLabel *) pccMalloc(MIR_TAG, sizeof(MirLabel));
+            mirCode->mirLabel = pccNew<MirLabel>(mirSpace);
             break;
         }
         case MIR_OPT_FLAG:
@@ -479,22 +452,22 @@ int tempValueIndex = 0;
 int tempLabelIndex = 0;
 int dataLabelIndex = 0;
 
-char *allocTempValue() {
-    char *result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 14);
-    snprintf(result, 14, "_tv_%d", tempValueIndex++);
-    return result;
+const char *allocTempValue() {
+    char result[14];
+    int length = snprintf(result, 14, "_tv_%d", tempValueIndex++);
+    return internString(result, length);
 }
 
-char *allocTempLabel() {
-    char *result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 14);
-    snprintf(result, 14, "_lb_%d", tempLabelIndex++);
-    return result;
+const char *allocTempLabel() {
+    char result[14];
+    int length = snprintf(result, 14, "_lb_%d", tempLabelIndex++);
+    return internString(result, length);
 }
 
-char *allocDataLabel() {
-    char *result = (char *) pccMalloc(MIR_TAG, sizeof(char) * 14);
-    snprintf(result, 14, "_data_%d", dataLabelIndex++);
-    return result;
+const char *allocDataLabel() {
+    char result[14];
+    int length = snprintf(result, 14, "_data_%d", dataLabelIndex++);
+    return internString(result, length);
 }
 
 void resetTempValIndex() {
@@ -696,7 +669,7 @@ void generateArithmeticFactor(AstArithmeticFactor *arithmeticFactor, MirOperand
                 mirData->dataSize++;
             }
             int dataSizeByte = getPrimitiveTypeSize(&arrayData->data.type) * mirData->dataSize;
-            mirData->data = pccMalloc(MIR_TAG, dataSizeByte);
+            mirData->data = pccSpaceAlloc(mirSpace, dataSizeByte);
             mirData->type.isReturn = false;
             mirData->type.isPointer = arrayData->data.type.isPointer;
             mirData->type.primitiveType = convertAstType2MirType(&arrayData->data.type);
@@ -794,9 +767,7 @@ void fixMir2Type(Mir2 *mir2) {
         VarNode *varNode = getVarInfo(mir2->fromValue.identity);
         mir2->distType = varNode->operandType;
     } else if (mir2->distType.isReturn) {
-        MethodNode *methodNode = getMethodInfo(lastCalledMethodIdentity);
-        lastCalledMethodIdentity = nullptr;
-        mir2->distType = methodNode->operandType;
+        mir2->distType = getLastCalledReturnType();
     }
 }
 
@@ -808,9 +779,7 @@ void fixMir3Type(Mir3 *mir3) {
         VarNode *operandType2VarNode = getVarInfo(mir3->value2.identity);
         operandType2 = operandType2VarNode->operandType;
     } else if (operandType2.isReturn) {
-        MethodNode *methodNode = getMethodInfo(lastCalledMethodIdentity);
-        lastCalledMethodIdentity = nullptr;
-        operandType2 = methodNode->operandType;
+        operandType2 = getLastCalledReturnType();
     }
     //todo: real cmp the data's size
     mir3->distType =
@@ -823,27 +792,26 @@ void fixMir3Type(Mir3 *mir3) {
  * @return
  */
 void generateArithmeticItem(AstArithmeticItem *arithmeticItem, MirOperand *value) {
-    char *tempVal = allocTempValue();
+    const char *tempVal = allocTempValue();
 
     MirCode *mirCode = createMirCode(MIR_2);
     mirCode->mir2->distIdentity = tempVal;
     mirCode->mir2->op = OP_ASSIGNMENT;
-    generateArithmeticFactor(arithmeticItem->arithmeticFactor, &mirCode->mir2->fromValue);
+    AstArithmeticFactor *factors = arithmeticItem->arithmeticFactors;
+    generateArithmeticFactor(&factors[0], &mirCode->mir2->fromValue);
     fixMir2Type(mirCode->mir2);
     addVarInfo(tempVal, mirCode->mir2->distType);
     emitMirCode(mirCode);
 
-    AstArithmeticItemMore *itemMore = arithmeticItem->arithmeticItemMore;
-    while (itemMore != nullptr) {
+    for (uint32_t i = 1; i < arithmeticItem->arithmeticFactorCount; i++) {
         mirCode = createMirCode(MIR_3);
         mirCode->mir3->distIdentity = tempVal;
         mirCode->mir3->value1.type.primitiveType = OPERAND_IDENTITY;
         mirCode->mir3->value1.identity = tempVal;
-        mirCode->mir3->op = getArithmeticOp(itemMore->arithmeticOperatorType);
-        generateArithmeticFactor(itemMore->arithmeticFactor, &mirCode->mir3->value2);
+        mirCode->mir3->op = getArithmeticOp(factors[i].arithmeticOperatorType);
+        generateArithmeticFactor(&factors[i], &mirCode->mir3->value2);
         fixMir3Type(mirCode->mir3);
         emitMirCode(mirCode);
-        itemMore = itemMore->arithmeticItemMore;
     }
     value->type.primitiveType = OPERAND_IDENTITY;
     value->identity = tempVal;
@@ -882,24 +850,23 @@ void generateExpressionAssignment(
 void generateExpressionArithmetic(AstExpressionArithmetic *expression, MirOperand *value) {
     MirCode *mirCode = createMirCode(MIR_2);
     Mir2 *mir2 = mirCode->mir2;
-    char *tempVal = allocTempValue();
+    const char *tempVal = allocTempValue();
     mir2->distIdentity = tempVal;
     mir2->op = OP_ASSIGNMENT;
-    generateArithmeticItem(expression->arithmeticItem, &mir2->fromValue);
+    AstArithmeticItem *items = expression->arithmeticItems;
+    generateArithmeticItem(&items[0], &mir2->fromValue);
     fixMir2Type(mir2);
     addVarInfo(tempVal, mirCode->mir2->distType);
     emitMirCode(mirCode);
-    AstExpressionArithmeticMore *expressionArithmeticMore = expression->arithmeticExpressMore;
-    while (expressionArithmeticMore != nullptr) {
+    for (uint32_t i = 1; i < expression->arithmeticItemCount; i++) {
         mirCode = createMirCode(MIR_3);
         mirCode->mir3->distIdentity = tempVal;
         mirCode->mir3->value1.type.primitiveType = OPERAND_IDENTITY;
         mirCode->mir3->value1.identity = tempVal;
-        mirCode->mir3->op = getArithmeticOp(expressionArithmeticMore->arithmeticOperatorType);
-        generateArithmeticItem(expressionArithmeticMore->arithmeticItem, &mirCode->mir3->value2);
+        mirCode->mir3->op = getArithmeticOp(items[i].arithmeticOperatorType);
+        generateArithmeticItem(&items[i], &mirCode->mir3->value2);
         fixMir3Type(mirCode->mir3);
         emitMirCode(mirCode);
-        expressionArithmeticMore = expressionArithmeticMore->arithmeticExpressMore;
     }
     if (value != nullptr) {
         //stupid code but it is legal.
@@ -919,7 +886,7 @@ void generateStatementReturn(
     if (returnStatement->expression == nullptr) {
         mirCode->mirRet->value = nullptr;
     } else {
-        MirOperand *mirOperand = (MirOperand *) pccMalloc(MIR_TAG, sizeof(MirOperand));
+        MirOperand *mirOperand = pccNew<MirOperand>(mirSpace);
         generateExpression(returnStatement->expression, mirOperand);
         mirCode->mirRet->value = mirOperand;
     }
@@ -936,7 +903,7 @@ MirObjectList *generateObjectList(AstObjectList *objectList) {
     MirObjectList *lastMirObjectList = nullptr;
     MirObjectList *mirObjectList = nullptr;
     while (objectList != nullptr) {
-        mirObjectList = (MirObjectList *) pccMalloc(MIR_TAG, sizeof(MirObjectList));
+        mirObjectList = pccNew<MirObjectList>(mirSpace);
         mirObjectList->next = nullptr;
         if (firstMirObjectList == nullptr) {
             firstMirObjectList = mirObjectList;
@@ -976,27 +943,23 @@ void generateStatementMethodCall(
  * @param falseLabel
  */
 void generateFactorBool(AstBoolFactor *boolFactor, MirLabel *trueLabel, MirLabel *falseLabel) {
-    switch (boolFactor->boolFactorType) {
-        case BOOL_FACTOR_RELATION: {
-            MirCode *mirCode = createMirCode(MIR_CMP);
-            MirCmp *mirCmp = mirCode->mirCmp;
-            generateExpressionArithmetic(boolFactor->arithmeticBoolFactor->firstArithmeticExpression,
-                                         &mirCmp->value1);
-            mirCmp->op = getBoolOp(boolFactor->arithmeticBoolFactor->relationOperation);
-            generateExpressionArithmetic(boolFactor->arithmeticBoolFactor->secondArithmeticExpression,
-                                         &mirCmp->value2);
-            mirCmp->trueLabel = trueLabel;
-            mirCmp->falseLabel = falseLabel;
-            emitMirCode(mirCode);
-            break;
-        }
-        case BOOL_FACTOR_INVERT: {
-            //very funny, right? hhh
-            generateFactorBool(boolFactor->invertBoolFactor->boolFactor, falseLabel, trueLabel);
-            break;
-        }
+    //very funny, right? hhh
+    while (boolFactor->boolFactorType == BOOL_FACTOR_INVERT) {
+        MirLabel *label = trueLabel;
+        trueLabel = falseLabel;
+        falseLabel = label;
+        boolFactor = boolFactor->invertBoolFactor->boolFactor;
     }
-
+    MirCode *mirCode = createMirCode(MIR_CMP);
+    MirCmp *mirCmp = mirCode->mirCmp;
+    generateExpressionArithmetic(boolFactor->arithmeticBoolFactor->firstArithmeticExpression,
+                                 &mirCmp->value1);
+    mirCmp->op = getBoolOp(boolFactor->arithmeticBoolFactor->relationOperation);
+    generateExpressionArithmetic(boolFactor->arithmeticBoolFactor->secondArithmeticExpression,
+                                 &mirCmp->value2);
+    mirCmp->trueLabel = trueLabel;
+    mirCmp->falseLabel = falseLabel;
+    emitMirCode(mirCode);
 }
 
 /**
@@ -1006,20 +969,18 @@ void generateFactorBool(AstBoolFactor *boolFactor, MirLabel *trueLabel, MirLabel
  * @param falseLabel
  */
 void generateItemBool(AstBoolItem *boolItem, MirLabel *trueLabel, MirLabel *falseLabel) {
-    while (boolItem != nullptr) {
-        if (boolItem->next != nullptr) {
-            MirCode *mirCode = createMirCode(MIR_LABEL);
-            MirLabel *itemTrueLabel = mirCode->mirLabel;
-            itemTrueLabel->label = allocTempLabel();
-            //any "&&" false, then all false
-            generateFactorBool(boolItem->boolFactor, itemTrueLabel, falseLabel);
-            emitMirCode(mirCode);
-        } else {
-            //last "&&", if this true, then all true
-            generateFactorBool(boolItem->boolFactor, trueLabel, falseLabel);
-        }
-        boolItem = boolItem->next;
+    AstBoolFactor *boolFactors = boolItem->boolFactors;
+    uint32_t last = boolItem->boolFactorCount - 1;
+    for (uint32_t i = 0; i < last; i++) {
+        MirCode *mirCode = createMirCode(MIR_LABEL);
+        MirLabel *itemTrueLabel = mirCode->mirLabel;
+        itemTrueLabel->label = allocTempLabel();
+        //any "&&" false, then all false
+        generateFactorBool(&boolFactors[i], itemTrueLabel, falseLabel);
+        emitMirCode(mirCode);
     }
+    //last "&&", if this true, then all true
+    generateFactorBool(&boolFactors[last], trueLabel, falseLabel);
 }
 
 /**
@@ -1029,20 +990,18 @@ void generateItemBool(AstBoolItem *boolItem, MirLabel *trueLabel, MirLabel *fals
  * @param falseLabel
  */
 void generateExpressionBool(AstExpressionBool *boolExpression, MirLabel *trueLabel, MirLabel *falseLabel) {
-    while (boolExpression != nullptr) {
-        if (boolExpression->next != nullptr) {
-            MirCode *mirCode = createMirCode(MIR_LABEL);
-            MirLabel *expressionFalseLabel = mirCode->mirLabel;
-            expressionFalseLabel->label = allocTempLabel();
-            //any "||" true, then all true
-            generateItemBool(boolExpression->boolItem, trueLabel, expressionFalseLabel);
-            emitMirCode(mirCode);
-        } else {
-            //last "or", if this false, then all false
-            generateItemBool(boolExpression->boolItem, trueLabel, falseLabel);
-        }
-        boolExpression = boolExpression->next;
+    AstBoolItem *boolItems = boolExpression->boolItems;
+    uint32_t last = boolExpression->boolItemCount - 1;
+    for (uint32_t i = 0; i < last; i++) {
+        MirCode *mirCode = createMirCode(MIR_LABEL);
+        MirLabel *expressionFalseLabel = mirCode->mirLabel;
+        expressionFalseLabel->label = allocTempLabel();
+        //any "||" true, then all true
+        generateItemBool(&boolItems[i], trueLabel, expressionFalseLabel);
+        emitMirCode(mirCode);
     }
+    //last "or", if this false, then all false
+    generateItemBool(&boolItems[last], trueLabel, falseLabel);
 }
 
 /**
@@ -1052,9 +1011,9 @@ void generateExpressionBool(AstExpressionBool *boolExpression, MirLabel *trueLab
 void generateStatementIf(
         AstStatementIf *ifStatement
 ) {
-    char *trueLabel = allocTempLabel();
-    char *falseLabel = allocTempLabel();
-    char *finishLabel = allocTempLabel();
+    const char *trueLabel = allocTempLabel();
+    const char *falseLabel = allocTempLabel();
+    const char *finishLabel = allocTempLabel();
 
     //must have true
     MirCode *trueBranchMirCode = createMirCode(MIR_LABEL);
@@ -1109,13 +1068,13 @@ void generateStatementWhile(
     emitMirCode(optFlag);
 
     //loop entry
-    char *loopEntryLabel = allocTempLabel();
+    const char *loopEntryLabel = allocTempLabel();
     MirCode *loopBranchMirCode = createMirCode(MIR_LABEL);
     loopBranchMirCode->mirLabel->label = loopEntryLabel;
     emitMirCode(loopBranchMirCode);
 
-    char *trueLabel = allocTempLabel();
-    char *falseLabel = allocTempLabel();
+    const char *trueLabel = allocTempLabel();
+    const char *falseLabel = allocTempLabel();
 
     //must have true
     MirCode *trueBranchMirCode = createMirCode(MIR_LABEL);
@@ -1154,15 +1113,15 @@ void generateStatementFor(
     optFlag->optFlag = OPT_ENTER_LOOP_BLOCK;
     emitMirCode(optFlag);
 
-    char *trueLabel = allocTempLabel();
-    char *falseLabel = allocTempLabel();
+    const char *trueLabel = allocTempLabel();
+    const char *falseLabel = allocTempLabel();
     //must have true
     MirCode *trueBranchMirCode = createMirCode(MIR_LABEL);
     trueBranchMirCode->mirLabel->label = trueLabel;
     //must have false, if the statement not declared one, then jump over the "true" blocks.
     MirCode *falseBranchMirCode = createMirCode(MIR_LABEL);
     falseBranchMirCode->mirLabel->label = falseLabel;
-    char *loopEntryLabel = allocTempLabel();
+    const char *loopEntryLabel = allocTempLabel();
     //loop entry
     MirCode *loopBranchMirCode = createMirCode(MIR_LABEL);
     loopBranchMirCode->mirLabel->label = loopEntryLabel;
@@ -1289,7 +1248,7 @@ void generateParam(AstParamList *astParamList, MirMethod *mirMethod) {
     MirMethodParam *firstMirMethodParam = nullptr;
     MirMethodParam *lastMirMethodParam = nullptr;
     while (curAstParamList != nullptr) {
-        mirMethodParam = (MirMethodParam *) pccMalloc(MIR_TAG, sizeof(MirMethodParam));
+        mirMethodParam = pccNew<MirMethodParam>(mirSpace);
         mirMethodParam->next = nullptr;
         if (firstMirMethodParam == nullptr) {
             firstMirMethodParam = mirMethodParam;
@@ -1360,17 +1319,12 @@ void generateParam(AstParamList *astParamList, MirMethod *mirMethod) {
 void generateMethod(AstMethodDefine *astMethodDefine, MirMethod *mirMethod) {
     mirMethod->label = astMethodDefine->identity->name;
 //    logd(MIR_TAG, "--- mir method:%s", mirMethod->label);
-    MirOperandType type;
-    type.primitiveType = convertAstType2MirType(astMethodDefine->type);
     if (astMethodDefine->paramList != nullptr) {
         //var in method params need stack
         generateParam(astMethodDefine->paramList, mirMethod);
     } else {
         mirMethod->param = nullptr;
     }
-    addMethodInfo(
-            astMethodDefine->identity->name,
-            type);
     if (astMethodDefine->defineType == METHOD_EXTERN) {
         logd(MIR_TAG, "skip extern method mir generation: %s", astMethodDefine->identity->name);
         mirMethod->isExtern = true;
@@ -1397,7 +1351,7 @@ void generateMethod(AstMethodDefine *astMethodDefine, MirMethod *mirMethod) {
  */
 Mir *generateMir(AstProgram *program) {
     logd(MIR_TAG, "generate mir...");
-    Mir *mir = (Mir *) pccMalloc(MIR_TAG, sizeof(Mir));
+    Mir *mir = pccNew<Mir>(mirSpace);
     AstMethodSeq *astMethodSeq = program->methodSeq;
     MirMethod *mirMethod = nullptr;
     MirMethod *lastMirMethod = nullptr;
@@ -1405,10 +1359,10 @@ Mir *generateMir(AstProgram *program) {
     int methodSize = 0;
     while (astMethodSeq != nullptr) {
         //maintain mir linked-list
-        mirMethod = (MirMethod *) pccMalloc(MIR_TAG, sizeof(MirMethod));
+        mirMethod = pccNew<MirMethod>(mirSpace);
         generateMethod(astMethodSeq->methodDefine, mirMethod);
         if (mirMethod->isExtern) {
-            pccFree(MIR_TAG, mirMethod);
+            pccSpaceFree(mirSpace, mirMethod);
         } else {
             mirMethod->next = nullptr;
             if (firstMirMethod == nullptr) {
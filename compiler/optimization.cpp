@@ -4,7 +4,6 @@
 
 #include "optimization.h"
 #include "logger.h"
-#include <string.h>
 
 #define OPT_TAG "optimization"
 
@@ -25,12 +24,12 @@ bool replaceFutureUsedMir2(MirCode *currentMirCode, const char *identity, MirOpe
         if (currentInLoop) {
             if (mirCode->mirType == MIR_2) {
                 Mir2 *mir2 = mirCode->mir2;
-                if (strcmp(mir2->distIdentity, identity) == 0 && currentInLoop) {
+                if (mir2->distIdentity == identity && currentInLoop) {
                     return false;
                 }
             } else if (mirCode->mirType == MIR_3) {
                 Mir3 *mir3 = mirCode->mir3;
-                if (strcmp(mir3->distIdentity, identity) == 0 && currentInLoop) {
+                if (mir3->distIdentity == identity && currentInLoop) {
                     return false;
                 }
             }
@@ -59,31 +58,31 @@ bool replaceFutureUsedMir2(MirCode *currentMirCode, const char *identity, MirOpe
         if (mirCode->mirType == MIR_2) {
             Mir2 *mir2 = mirCode->mir2;
             if (mir2->fromValue.type.primitiveType == OPERAND_IDENTITY &&
-                strcmp(mir2->fromValue.identity, identity) == 0) {
+                mir2->fromValue.identity == identity) {
                 mir2->fromValue = *replaceWith;
                 result = true;
             }
-            if (strcmp(mir2->distIdentity, identity) == 0) {
+            if (mir2->distIdentity == identity) {
                 break;
             }
         } else if (mirCode->mirType == MIR_3) {
             Mir3 *mir3 = mirCode->mir3;
-            if (mir3->value1.type.primitiveType == OPERAND_IDENTITY && strcmp(mir3->value1.identity, identity) == 0) {
+            if (mir3->value1.type.primitiveType == OPERAND_IDENTITY && mir3->value1.identity == identity) {
                 mir3->value1 = *replaceWith;
                 result = true;
             }
-            if (mir3->value2.type.primitiveType == OPERAND_IDENTITY && strcmp(mir3->value2.identity, identity) == 0) {
+            if (mir3->value2.type.primitiveType == OPERAND_IDENTITY && mir3->value2.identity == identity) {
                 mir3->value2 = *replaceWith;
                 result = true;
             }
-            if (strcmp(mir3->distIdentity, identity) == 0) {
+            if (mir3->distIdentity == identity) {
                 break;
             }
         } else if (mirCode->mirType == MIR_RET) {
             MirRet *mirRet = mirCode->mirRet;
             if (mirRet->value != nullptr) {
                 if (mirRet->value->type.primitiveType == OPERAND_IDENTITY &&
-                    strcmp(mirRet->value->identity, identity) == 0) {
+                    mirRet->value->identity == identity) {
                     mirRet->value = replaceWith;
                     result = true;
                 }
@@ -91,12 +90,12 @@ bool replaceFutureUsedMir2(MirCode *currentMirCode, const char *identity, MirOpe
         } else if (mirCode->mirType == MIR_CMP) {
             MirCmp *mirCmp = mirCode->mirCmp;
             if (mirCmp->value1.type.primitiveType == OPERAND_IDENTITY &&
-                strcmp(mirCmp->value1.identity, identity) == 0) {
+                mirCmp->value1.identity == identity) {
                 mirCmp->value1 = *replaceWith;
                 result = true;
             }
             if (mirCmp->value2.type.primitiveType == OPERAND_IDENTITY &&
-                strcmp(mirCmp->value2.identity, identity) == 0) {
+                mirCmp->value2.identity == identity) {
                 mirCmp->value2 = *replaceWith;
                 result = true;
             }
@@ -105,7 +104,7 @@ bool replaceFutureUsedMir2(MirCode *currentMirCode, const char *identity, MirOpe
             MirObjectList *mirObjectList = mirCall->mirObjectList;
             while (mirObjectList != nullptr) {
                 if (mirObjectList->value.type.primitiveType == OPERAND_IDENTITY &&
-                    strcmp(mirObjectList->value.identity, identity) == 0) {
+                    mirObjectList->value.identity == identity) {
                     mirObjectList->value = *replaceWith;
                     result = true;
                 }
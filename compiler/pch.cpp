@@ -0,0 +1,467 @@
+//
+// Created by Park Yu on 2024/12/12.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "pch.h"
+#include "preprocessor.h"
+#include "lexer.h"
+#include "macro.h"
+#include "logger.h"
+#include "mspace.h"
+#include "file.h"
+#include "hash.h"
+#include "intern.h"
+#include "config.h"
+
+static const char *PCH_TAG = "pch";
+
+static MemSpace *pchSpace = pccCreateSpace(PCH_TAG);
+
+#define PCH_MAGIC "PCCPCH"
+//bump whenever a record layout changes
+#define PCH_FORMAT_VERSION 2
+#define PCH_VERSION_SIZE 32
+#define PCH_ALIGNMENT 8
+#define INIT_RECORD_CAPACITY 64
+#define INIT_STRING_TABLE_CAPACITY 1024
+
+/**
+ * file layout: header, files, macros, tokens, strings. sections are 8 byte aligned,
+ * offsets count from the start of the file, string references are offsets into the string pool.
+ */
+struct PchHeader {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t headerSize;
+    char compilerVersion[PCH_VERSION_SIZE];
+    uint32_t fileCount;
+    uint32_t macroCount;
+    uint32_t tokenCount;
+    uint32_t reserved;
+    uint64_t filesOffset;
+    uint64_t macrosOffset;
+    uint64_t tokensOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    //everything after the header
+    uint64_t payloadSize;
+    uint64_t payloadHash;
+};
+
+struct PchFile {
+    uint64_t contentHash;
+    uint64_t size;
+    uint32_t path;
+    uint32_t reserved;
+};
+
+struct PchMacro {
+    uint32_t definition;
+    uint32_t length;
+};
+
+struct PchToken {
+    uint8_t tokenType;
+    uint8_t kind;
+    uint16_t reserved;
+    uint32_t line;
+    uint32_t column;
+    //the name of the file the token came from, shared by all its tokens through the string pool
+    uint32_t fileName;
+    uint32_t content;
+};
+
+/**
+ * every spelling is stored once, the writer interns them through an open addressing table.
+ */
+struct PchStringSlot {
+    uint64_t hash;
+    const char *string;
+    uint32_t offset;
+};
+
+struct PchWriter {
+    PchFile *files;
+    const char **filePaths;
+    uint32_t fileCount;
+    uint32_t fileCapacity;
+    uint32_t filePathCapacity;
+
+    PchMacro *macros;
+    uint32_t macroCount;
+    uint32_t macroCapacity;
+
+    PchToken *tokens;
+    uint32_t tokenCount;
+
+    char *strings;
+    size_t stringsSize;
+    size_t stringsCapacity;
+
+    PchStringSlot *slots;
+    uint32_t slotCapacity;
+    uint32_t slotCount;
+};
+
+//the loaded file stays mapped until exit, token spellings point into it and mir keeps them
+static MappedFile pchMapping;
+static const PchHeader *pchHeader = nullptr;
+
+static void *growRecords(void *records, uint32_t count, uint32_t *capacity, size_t elementSize) {
+    if (count < *capacity) {
+        return records;
+    }
+    uint32_t newCapacity = *capacity == 0 ? INIT_RECORD_CAPACITY : *capacity * 2;
+    void *newRecords = pccSpaceAllocArray(pchSpace, newCapacity, elementSize);
+    if (records != nullptr) {
+        memcpy(newRecords, records, count * elementSize);
+        pccSpaceFree(pchSpace, records);
+    }
+    *capacity = newCapacity;
+    return newRecords;
+}
+
+static void growStringTable(PchWriter *writer) {
+    PchStringSlot *oldSlots = writer->slots;
+    uint32_t oldCapacity = writer->slotCapacity;
+    writer->slotCapacity = oldCapacity == 0 ? INIT_STRING_TABLE_CAPACITY : oldCapacity * 2;
+    writer->slots = pccNewArray<PchStringSlot>(pchSpace, writer->slotCapacity);
+    uint32_t mask = writer->slotCapacity - 1;
+    for (uint32_t i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].string == nullptr) {
+            continue;
+        }
+        uint32_t index = oldSlots[i].hash & mask;
+        while (writer->slots[index].string != nullptr) {
+            index = (index + 1) & mask;
+        }
+        writer->slots[index] = oldSlots[i];
+    }
+    if (oldSlots != nullptr) {
+        pccSpaceFree(pchSpace, oldSlots);
+    }
+}
+
+static uint32_t poolString(PchWriter *writer, const char *string, size_t length) {
+    if ((writer->slotCount + 1) * 2 > writer->slotCapacity) {
+        growStringTable(writer);
+    }
+    uint64_t hash = hashBytes(string, length);
+    uint32_t mask = writer->slotCapacity - 1;
+    uint32_t index = hash & mask;
+    while (writer->slots[index].string != nullptr) {
+        PchStringSlot *slot = &writer->slots[index];
+        if (slot->hash == hash && strncmp(slot->string, string, length) == 0 && slot->string[length] == '\0') {
+            return slot->offset;
+        }
+        index = (index + 1) & mask;
+    }
+    if (writer->stringsSize + length + 1 > UINT32_MAX) {
+        loge(PCH_TAG, "string pool larger than 4GB");
+        exit(-1);
+    }
+    size_t required = writer->stringsSize + length + 1;
+    if (required > writer->stringsCapacity) {
+        size_t newCapacity = writer->stringsCapacity == 0 ? INIT_STRING_TABLE_CAPACITY : writer->stringsCapacity;
+        while (newCapacity < required) {
+            newCapacity *= 2;
+        }
+        char *newStrings = pccNewArray<char>(pchSpace, newCapacity);
+        if (writer->strings != nullptr) {
+            memcpy(newStrings, writer->strings, writer->stringsSize);
+            pccSpaceFree(pchSpace, writer->strings);
+        }
+        writer->strings = newStrings;
+        writer->stringsCapacity = newCapacity;
+    }
+    uint32_t offset = writer->stringsSize;
+    memcpy(writer->strings + offset, string, length);
+    writer->strings[offset + length] = '\0';
+    writer->stringsSize += length + 1;
+    PchStringSlot *slot = &writer->slots[index];
+    slot->hash = hash;
+    slot->string = writer->strings + offset;
+    slot->offset = offset;
+    writer->slotCount++;
+    return offset;
+}
+
+//the identity is not stored, mtime has 1 second steps: validateFiles compares sizes and content hashes instead
+static void recordFile(const char *path, const FileIdentity *, void *arg) {
+    PchWriter *writer = (PchWriter *) arg;
+    writer->files = (PchFile *) growRecords(writer->files, writer->fileCount, &writer->fileCapacity,
+                                            sizeof(PchFile));
+    writer->filePaths = (const char **) growRecords(writer->filePaths, writer->fileCount, &writer->filePathCapacity,
+                                                    sizeof(const char *));
+    //the pch may be used from another directory
+    char *absolutePath = realpath(path, nullptr);
+    const char *storedPath = absolutePath != nullptr ? absolutePath : path;
+    PchFile *file = &writer->files[writer->fileCount];
+    file->path = poolString(writer, storedPath, strlen(storedPath));
+    writer->filePaths[writer->fileCount] = path;
+    writer->fileCount++;
+    free(absolutePath);
+}
+
+static void recordMacro(const char *definition, int length, void *arg) {
+    PchWriter *writer = (PchWriter *) arg;
+    writer->macros = (PchMacro *) growRecords(writer->macros, writer->macroCount, &writer->macroCapacity,
+                                              sizeof(PchMacro));
+    PchMacro *macro = &writer->macros[writer->macroCount++];
+    macro->definition = poolString(writer, definition, length);
+    macro->length = length;
+}
+
+/**
+ * hash the content of every recorded file, the strings are final once this runs.
+ */
+static void hashFiles(PchWriter *writer) {
+    for (uint32_t i = 0; i < writer->fileCount; i++) {
+        MappedFile mappedFile;
+        if (!mapInputFile(writer->filePaths[i], &mappedFile)) {
+            loge(PCH_TAG, "can not read %s", writer->filePaths[i]);
+            exit(-1);
+        }
+        writer->files[i].contentHash = hashBytes(mappedFile.data, mappedFile.size);
+        writer->files[i].size = mappedFile.size;
+        unmapInputFile(&mappedFile);
+    }
+}
+
+void writePrecompiledHeader(const char *pchPath, TokenList *tokens) {
+    logd(PCH_TAG, "write precompiled header: %s", pchPath);
+    PchWriter writer;
+    memset(&writer, 0, sizeof(PchWriter));
+    visitIncludedFiles(recordFile, &writer);
+    visitMacros(recordMacro, &writer);
+    const TokenFiles *files = &tokens->files;
+    uint32_t *fileNames = pccNewArray<uint32_t>(pchSpace, files->nameCount + 1);
+    for (uint32_t i = 0; i < files->nameCount; i++) {
+        fileNames[i] = poolString(&writer, files->names[i], strlen(files->names[i]));
+    }
+    uint32_t run = 0;
+    writer.tokens = pccNewArray<PchToken>(pchSpace, tokens->count + 1);
+    writer.tokenCount = tokens->count;
+    for (uint32_t i = 0; i < tokens->count; i++) {
+        const Token *token = &tokens->tokens[i];
+        PchToken *record = &writer.tokens[i];
+        record->tokenType = token->tokenType;
+        record->kind = token->kind;
+        record->line = token->line;
+        record->column = token->column;
+        while (run + 1 < files->runCount && files->runs[run + 1].firstToken <= i) {
+            run++;
+        }
+        record->fileName = fileNames[files->runs[run].fileIndex];
+        record->content = poolString(&writer, token->content, strlen(token->content));
+    }
+    hashFiles(&writer);
+
+    PchHeader header;
+    memset(&header, 0, sizeof(PchHeader));
+    memcpy(header.magic, PCH_MAGIC, sizeof(PCH_MAGIC));
+    header.formatVersion = PCH_FORMAT_VERSION;
+    header.headerSize = sizeof(PchHeader);
+    strncpy(header.compilerVersion, PROJECT_VERSION, PCH_VERSION_SIZE - 1);
+    header.fileCount = writer.fileCount;
+    header.macroCount = writer.macroCount;
+    header.tokenCount = writer.tokenCount;
+    header.filesOffset = sizeof(PchHeader);
+    header.macrosOffset = alignTo(header.filesOffset + writer.fileCount * sizeof(PchFile), PCH_ALIGNMENT);
+    header.tokensOffset = alignTo(header.macrosOffset + writer.macroCount * sizeof(PchMacro), PCH_ALIGNMENT);
+    header.stringsOffset = alignTo(header.tokensOffset + writer.tokenCount * sizeof(PchToken), PCH_ALIGNMENT);
+    header.stringsSize = writer.stringsSize;
+    header.payloadSize = header.stringsOffset + header.stringsSize - sizeof(PchHeader);
+
+    openFile(pchPath);
+    presizeFile(sizeof(PchHeader) + header.payloadSize);
+    reserveFile(sizeof(PchHeader));
+    writeFileB(writer.files, writer.fileCount * sizeof(PchFile));
+    writeEmptyAlignment(PCH_ALIGNMENT);
+    writeFileB(writer.macros, writer.macroCount * sizeof(PchMacro));
+    writeEmptyAlignment(PCH_ALIGNMENT);
+    writeFileB(writer.tokens, writer.tokenCount * sizeof(PchToken));
+    writeEmptyAlignment(PCH_ALIGNMENT);
+    writeFileB(writer.strings, writer.stringsSize);
+    //the padding between sections is zero, hash it like the loader sees it
+    uint64_t hash = HASH_SEED;
+    const char zero[PCH_ALIGNMENT] = {0};
+    uint64_t sectionEnds[] = {
+            header.filesOffset + writer.fileCount * sizeof(PchFile),
+            header.macrosOffset + writer.macroCount * sizeof(PchMacro),
+            header.tokensOffset + writer.tokenCount * sizeof(PchToken),
+    };
+    uint64_t sectionStarts[] = {header.macrosOffset, header.tokensOffset, header.stringsOffset};
+    hash = hashContinue(hash, (const char *) writer.files, writer.fileCount * sizeof(PchFile));
+    hash = hashContinue(hash, zero, sectionStarts[0] - sectionEnds[0]);
+    hash = hashContinue(hash, (const char *) writer.macros, writer.macroCount * sizeof(PchMacro));
+    hash = hashContinue(hash, zero, sectionStarts[1] - sectionEnds[1]);
+    hash = hashContinue(hash, (const char *) writer.tokens, writer.tokenCount * sizeof(PchToken));
+    hash = hashContinue(hash, zero, sectionStarts[2] - sectionEnds[2]);
+    hash = hashContinue(hash, writer.strings, writer.stringsSize);
+    header.payloadHash = hash;
+    writeFileAt(0, &header, sizeof(PchHeader));
+    closeFile();
+    logd(PCH_TAG, "%u files, %u macros, %u tokens, %zu bytes of %u distinct strings",
+         writer.fileCount, writer.macroCount, writer.tokenCount, writer.stringsSize, writer.slotCount);
+    pccResetSpace(pchSpace);
+}
+
+static bool sectionInside(uint64_t offset, uint64_t size, uint64_t fileSize) {
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+static bool validateHeader(const PchHeader *header, size_t fileSize, const char *pchPath) {
+    if (fileSize < sizeof(PchHeader) || memcmp(header->magic, PCH_MAGIC, sizeof(PCH_MAGIC)) != 0) {
+        loge(PCH_TAG, "%s is not a precompiled header", pchPath);
+        return false;
+    }
+    if (header->formatVersion != PCH_FORMAT_VERSION || header->headerSize != sizeof(PchHeader)
+        || strncmp(header->compilerVersion, PROJECT_VERSION, PCH_VERSION_SIZE) != 0) {
+        loge(PCH_TAG, "%s was built by another compiler version (%.*s, format %u)", pchPath,
+             PCH_VERSION_SIZE, header->compilerVersion, header->formatVersion);
+        return false;
+    }
+    if (header->payloadSize != fileSize - sizeof(PchHeader)
+        || !sectionInside(header->filesOffset, (uint64_t) header->fileCount * sizeof(PchFile), fileSize)
+        || !sectionInside(header->macrosOffset, (uint64_t) header->macroCount * sizeof(PchMacro), fileSize)
+        || !sectionInside(header->tokensOffset, (uint64_t) header->tokenCount * sizeof(PchToken), fileSize)
+        || !sectionInside(header->stringsOffset, header->stringsSize, fileSize)
+        || header->stringsSize == 0) {
+        loge(PCH_TAG, "%s is truncated", pchPath);
+        return false;
+    }
+    const char *data = (const char *) header;
+    if (hashBytes(data + sizeof(PchHeader), header->payloadSize) != header->payloadHash
+        || data[header->stringsOffset + header->stringsSize - 1] != '\0') {
+        loge(PCH_TAG, "%s is corrupt, payload hash mismatch", pchPath);
+        return false;
+    }
+    return true;
+}
+
+static const char *pchString(uint32_t offset) {
+    if (offset >= pchHeader->stringsSize) {
+        return nullptr;
+    }
+    return (const char *) pchHeader + pchHeader->stringsOffset + offset;
+}
+
+/**
+ * a header is still valid when its content hashes the same, its mtime may have changed.
+ */
+static bool validateFiles(const PchFile *files, FileIdentity *identities, const char *pchPath) {
+    for (uint32_t i = 0; i < pchHeader->fileCount; i++) {
+        const char *path = pchString(files[i].path);
+        MappedFile mappedFile;
+        if (path == nullptr || !statInputFile(path, &identities[i]) || !mapInputFile(path, &mappedFile)) {
+            loge(PCH_TAG, "%s is stale, %s is gone", pchPath, path == nullptr ? "a header" : path);
+            return false;
+        }
+        bool same = mappedFile.size == files[i].size
+                    && hashBytes(mappedFile.data, mappedFile.size) == files[i].contentHash;
+        unmapInputFile(&mappedFile);
+        if (!same) {
+            loge(PCH_TAG, "%s is stale, %s changed", pchPath, path);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadPrecompiledHeader(const char *pchPath) {
+    logd(PCH_TAG, "load precompiled header: %s", pchPath);
+    MappedFile mappedFile;
+    if (!mapInputFile(pchPath, &mappedFile)) {
+        loge(PCH_TAG, "can not open precompiled header: %s", pchPath);
+        return false;
+    }
+    const PchHeader *header = (const PchHeader *) mappedFile.data;
+    if (!validateHeader(header, mappedFile.size, pchPath) || header->fileCount == 0) {
+        unmapInputFile(&mappedFile);
+        return false;
+    }
+    pchHeader = header;
+    const char *data = mappedFile.data;
+    const PchFile *files = (const PchFile *) (data + header->filesOffset);
+    FileIdentity *identities = pccNewArray<FileIdentity>(pchSpace, header->fileCount);
+    if (!validateFiles(files, identities, pchPath)) {
+        pchHeader = nullptr;
+        unmapInputFile(&mappedFile);
+        pccResetSpace(pchSpace);
+        return false;
+    }
+    //files first, the first one sets up the preprocessor tables the macros go into
+    for (uint32_t i = 0; i < header->fileCount; i++) {
+        addPrecompiledFile(pchString(files[i].path), &identities[i]);
+    }
+    const PchMacro *macros = (const PchMacro *) (data + header->macrosOffset);
+    for (uint32_t i = 0; i < header->macroCount; i++) {
+        const char *definition = pchString(macros[i].definition);
+        if (definition != nullptr && macros[i].length < header->stringsSize - macros[i].definition) {
+            defineMacro(definition, 0, macros[i].length);
+        }
+    }
+    pchMapping = mappedFile;
+    logd(PCH_TAG, "%u files, %u macros, %u tokens restored", header->fileCount, header->macroCount,
+         header->tokenCount);
+    return true;
+}
+
+TokenList *getPrecompiledTokens() {
+    if (pchHeader == nullptr || pchHeader->tokenCount == 0) {
+        return nullptr;
+    }
+    const PchToken *records = (const PchToken *) (pchMapping.data + pchHeader->tokensOffset);
+    TokenList *list = pccNew<TokenList>(pchSpace);
+    list->count = pchHeader->tokenCount;
+    //zero filled, the token after the last one is a TOKEN_END
+    list->tokens = pccNewArray<Token>(pchSpace, list->count + 1);
+    list->tokens[list->count].content = "";
+    uint32_t *fileNames = nullptr;
+    uint32_t fileNameCount = 0;
+    uint32_t fileNameCapacity = 0;
+    uint32_t fileIndex = 0;
+    for (uint32_t i = 0; i < list->count; i++) {
+        Token *token = &list->tokens[i];
+        token->tokenType = (TokenType) records[i].tokenType;
+        token->kind = (TokenKind) records[i].kind;
+        token->line = records[i].line;
+        token->column = records[i].column;
+        //tokens of one file come in runs, only a change of file searches the names seen so far
+        if (fileNameCount == 0 || fileNames[fileIndex] != records[i].fileName) {
+            fileIndex = 0;
+            while (fileIndex < fileNameCount && fileNames[fileIndex] != records[i].fileName) {
+                fileIndex++;
+            }
+            if (fileIndex == fileNameCount) {
+                if (fileNameCount >= UINT16_MAX) {
+                    loge(PCH_TAG, "too many source files");
+                    exit(-1);
+                }
+                fileNames = (uint32_t *) growRecords(fileNames, fileNameCount, &fileNameCapacity, sizeof(uint32_t));
+                fileNames[fileNameCount++] = records[i].fileName;
+            }
+        }
+        setTokenFile(&list->files, i, fileIndex, pchSpace);
+        const char *content = pchString(records[i].content);
+        if (content == nullptr) {
+            content = "";
+        }
+        //names must be the interned copy, later phases compare them by pointer
+        token->content = token->tokenType == TOKEN_CHARS ? content : internCString(content);
+    }
+    list->files.nameCount = fileNameCount;
+    list->files.names = pccNewArray<const char *>(pchSpace, fileNameCount);
+    for (uint32_t i = 0; i < fileNameCount; i++) {
+        const char *fileName = pchString(fileNames[i]);
+        list->files.names[i] = internCString(fileName != nullptr ? fileName : "");
+    }
+    return list;
+}
+
+void releasePrecompiledHeaderMemory() {
+    pccResetSpace(pchSpace);
+}
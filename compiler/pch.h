@@ -0,0 +1,31 @@
+//
+// Created by Park Yu on 2024/12/12.
+//
+
+#ifndef PCC_PCH_H
+#define PCC_PCH_H
+
+#include "token.h"
+
+/**
+ * -emit-pch, called after the lexer: snapshot the files that were read, the macros left defined,
+ * and the token list with its interned spellings into one versioned file.
+ */
+extern void writePrecompiledHeader(const char *pchPath, TokenList *tokens);
+
+/**
+ * -include-pch, called before preprocess: map the file, check its version and payload hash and the
+ * content hash of every header it was built from. the macros and files are handed to the preprocessor.
+ * false when the file is missing, corrupt or stale, the compile then goes on without it.
+ */
+extern bool loadPrecompiledHeader(const char *pchPath);
+
+/**
+ * the precompiled tokens with the names of their own files, they go in front of the tokens lexed from the source.
+ * nullptr without a pch, the list lives until releasePrecompiledHeaderMemory.
+ */
+extern TokenList *getPrecompiledTokens();
+
+extern void releasePrecompiledHeaderMemory();
+
+#endif //PCC_PCH_H
@@ -7,22 +7,126 @@
 #include "preprocessor.h"
 #include "logger.h"
 #include "mspace.h"
+#include "file.h"
+#include "hash.h"
+#include "macro.h"
+#include "condition.h"
 
 const char *PREPROCESSOR_TAG = "preprocessor";
-//16KB
-#define BUFFER_SIZE 16384
+
+static MemSpace *preprocessorSpace = pccCreateSpace(PREPROCESSOR_TAG);
 
 const char *INCLUDE_TAG = "include";
 const int INCLUDE_TAG_LEN = 7;
 const char *DEFINE_TAG = "define";
 const int DEFINE_TAG_LEN = 6;
+const char *UNDEF_TAG = "undef";
+const int UNDEF_TAG_LEN = 5;
+const char *PRAGMA_TAG = "pragma";
+const int PRAGMA_TAG_LEN = 6;
+const char *ERROR_TAG = "error";
+const int ERROR_TAG_LEN = 5;
+
+//8KB
+#define INIT_TEXT_CAPACITY 8192
+#define INIT_LINE_CAPACITY 256
+#define INIT_FILE_CAPACITY 8
+#define INIT_INCLUDE_TABLE_CAPACITY 16
+#define INIT_INCLUDE_PATH_CAPACITY 8
+#define MAX_CONDITIONAL_DEPTH 256
+
+static ProcessedSource *processedSource = nullptr;
+
+/**
+ * one entry per distinct header of the compilation, two spellings of the same file share it.
+ */
+struct IncludeFile {
+    const char *path;
+    FileIdentity identity;
+    //#pragma once seen while processing it
+    bool pragmaOnce;
+    //the whole file is wrapped in #ifndef guardMacro / #define guardMacro / #endif
+    const char *guardMacro;
+    //its content comes from a precompiled header, every #include of it is skipped
+    bool precompiled;
+    uint32_t includeCount;
+};
+
+/**
+ * open addressing, linear probing. the name table is keyed by the #include spelling,
+ * the file table by FileIdentity, an empty slot has file == nullptr.
+ */
+struct IncludeSlot {
+    uint64_t hash;
+    const char *name;
+    IncludeFile *file;
+};
+
+struct IncludeTable {
+    IncludeSlot *slots;
+    uint32_t capacity;
+    uint32_t count;
+};
+
+struct IncludeCacheStat {
+    uint32_t lookups;
+    //resolved from the name table, no stat at all
+    uint32_t nameHits;
+    //skipped by #pragma once or the include guard, no file access at all
+    uint32_t skipped;
+};
+
+static IncludeTable includeNameTable;
+static IncludeTable includeFileTable;
+static IncludeCacheStat includeCacheStat;
+//nullptr while processing the main source file
+static IncludeFile *currentIncludeFile = nullptr;
+//tables are set up by the first of preprocess and addPrecompiledFile, torn down by releasePreProcessorMemory
+static bool preprocessorReady = false;
+
+//-I, searched in order before the working directory and the bundled include/
+//set up before preprocess, so they live on the heap and survive releasePreProcessorMemory
+static const char **includePaths = nullptr;
+static uint32_t includePathCount = 0;
+static uint32_t includePathCapacity = 0;
+
+struct IncludeGuard {
+    const char *macro;
+    int macroLength;
+};
+
+enum ConditionalDirective {
+    DIRECTIVE_NONE,
+    DIRECTIVE_IF,
+    DIRECTIVE_IFDEF,
+    DIRECTIVE_IFNDEF,
+    DIRECTIVE_ELIF,
+    DIRECTIVE_ELSE,
+    DIRECTIVE_ENDIF,
+};
+
+struct Conditional {
+    //one branch of the group was compiled, every later #elif and #else is disabled
+    bool taken;
+    bool seenElse;
+    uint32_t lineNumber;
+};
+
+/**
+ * open #if groups of one file, a group never spans files.
+ */
+struct ConditionalStack {
+    Conditional conditionals[MAX_CONDITIONAL_DEPTH];
+    int depth;
+};
 
-ProcessedSource *sourceHead = nullptr;
+//a line ending in '\' goes on in the next one, the spliced line is built here
+static char *spliceBuffer = nullptr;
+static size_t spliceCapacity = 0;
 
-bool processLine(char *line);
+bool processLine(const char *line, int length);
 
-bool ignoreComment(const char *line) {
-    int length = strlen(line);
+bool ignoreComment(const char *line, int length) {
     int i = 0;
     for (i = 0; i < length; i++) {
         if (line[i] == ' ') {
@@ -30,56 +134,668 @@ bool ignoreComment(const char *line) {
         }
         break;
     }
-    if (line[i] == '/' && i + 1 < length && line[i + 1] == '/') {
+    if (i + 1 < length && line[i] == '/' && line[i + 1] == '/') {
         return true;
     }
     return false;
 }
 
-void extraInclude(const char *includeFileName) {
-    const char *compilerIncludePath = "include/";
-    const int finalPathLen = strlen(compilerIncludePath) + strlen(includeFileName);
-    char *finalIncludePath = (char *) pccMalloc(PREPROCESSOR_TAG, finalPathLen);
-    strcat(finalIncludePath, compilerIncludePath);
-    strcat(finalIncludePath, includeFileName);
-    FILE *inputFile = fopen(includeFileName, "r");
-    if (inputFile == nullptr) {
-        inputFile = fopen(finalIncludePath, "r");
-    }
-    if (inputFile == nullptr) {
-        loge(PREPROCESSOR_TAG, "can not found header file: %s", includeFileName);
+/**
+ * grow an array inside the space by doubling, the old block goes back to the space.
+ */
+static void *growArray(void *array, size_t count, size_t *capacity, size_t required, size_t elementSize) {
+    if (required <= *capacity) {
+        return array;
+    }
+    size_t newCapacity = *capacity;
+    while (newCapacity < required) {
+        newCapacity *= 2;
+    }
+    void *newArray = pccSpaceAllocArray(preprocessorSpace, newCapacity, elementSize);
+    if (array != nullptr) {
+        memcpy(newArray, array, count * elementSize);
+        pccSpaceFree(preprocessorSpace, array);
+    }
+    *capacity = newCapacity;
+    return newArray;
+}
+
+static bool isIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static int skipBlank(const char *line, int index, int length) {
+    while (index < length && (line[index] == ' ' || line[index] == '\t' || line[index] == '\r')) {
+        index++;
+    }
+    return index;
+}
+
+static bool isBlankLine(const char *line, int length) {
+    int index = skipBlank(line, 0, length);
+    return index >= length || line[index] == '\n';
+}
+
+/**
+ * match "#name" (blanks allowed around the '#'), returns the index right after the name or -1.
+ */
+static int matchDirective(const char *line, int length, const char *name, int nameLength) {
+    int index = skipBlank(line, 0, length);
+    if (index >= length || line[index] != '#') {
+        return -1;
+    }
+    index = skipBlank(line, index + 1, length);
+    if (index + nameLength > length || memcmp(line + index, name, nameLength) != 0) {
+        return -1;
+    }
+    index += nameLength;
+    if (index < length && isIdentifierChar(line[index])) {
+        return -1;
+    }
+    return index;
+}
+
+/**
+ * the identifier after the blanks at index, returns its start and writes its length (0 when there is none).
+ */
+static int readIdentifier(const char *line, int index, int length, int *identifierLength) {
+    int start = skipBlank(line, index, length);
+    int end = start;
+    while (end < length && isIdentifierChar(line[end])) {
+        end++;
+    }
+    *identifierLength = end - start;
+    return start;
+}
+
+static ProcessedSource *createProcessedSource(size_t textCapacity) {
+    ProcessedSource *source = pccNew<ProcessedSource>(preprocessorSpace);
+    source->capacity = textCapacity < INIT_TEXT_CAPACITY ? INIT_TEXT_CAPACITY : textCapacity;
+    source->text = pccNewArray<char>(preprocessorSpace, source->capacity);
+    source->lineCapacity = INIT_LINE_CAPACITY;
+    source->lines = pccNewArray<SourceLine>(preprocessorSpace, source->lineCapacity);
+    source->fileCapacity = INIT_FILE_CAPACITY;
+    source->fileNames = pccNewArray<const char *>(preprocessorSpace, source->fileCapacity);
+    return source;
+}
+
+static uint32_t addFileName(const char *fileName) {
+    ProcessedSource *source = processedSource;
+    size_t capacity = source->fileCapacity;
+    source->fileNames = (const char **) growArray(source->fileNames, source->fileCount, &capacity,
+                                                  source->fileCount + 1, sizeof(const char *));
+    source->fileCapacity = capacity;
+    source->fileNames[source->fileCount] = fileName;
+    return source->fileCount++;
+}
+
+static void appendLine(const char *line, int length, uint32_t fileIndex, uint32_t lineNumber) {
+    ProcessedSource *source = processedSource;
+    if (source->size + length + 1 > UINT32_MAX) {
+        loge(PREPROCESSOR_TAG, "translation unit larger than 4GB");
         exit(-1);
     }
-    char buffer[BUFFER_SIZE];
-    while (fgets(buffer, BUFFER_SIZE, inputFile) != nullptr) {
-        if (ignoreComment(buffer)) {
+    //keep one byte for the terminator
+    source->text = (char *) growArray(source->text, source->size, &source->capacity,
+                                      source->size + length + 1, sizeof(char));
+    memcpy(source->text + source->size, line, length);
+    size_t lineCapacity = source->lineCapacity;
+    source->lines = (SourceLine *) growArray(source->lines, source->lineCount, &lineCapacity,
+                                             source->lineCount + 1, sizeof(SourceLine));
+    source->lineCapacity = lineCapacity;
+    SourceLine *sourceLine = &source->lines[source->lineCount++];
+    sourceLine->offset = source->size;
+    sourceLine->length = length;
+    sourceLine->fileIndex = fileIndex;
+    sourceLine->lineNumber = lineNumber;
+    source->size += length;
+    source->text[source->size] = '\0';
+}
+
+/**
+ * detect the classic include guard: the first significant line is #ifndef X, the second #define X
+ * and the last one the #endif closing the #ifndef, with no #else or #elif of its own in between.
+ * blank and // lines are not significant.
+ */
+static bool detectIncludeGuard(const MappedFile *mappedFile, IncludeGuard *guard) {
+    memset(guard, 0, sizeof(IncludeGuard));
+    uint32_t lineNumber = 0;
+    uint32_t significantCount = 0;
+    //#if nesting, the guard #ifndef must stay open until the last significant line
+    int depth = 0;
+    bool closed = false;
+    const char *cursor = mappedFile->data;
+    const char *end = mappedFile->data + mappedFile->size;
+    while (cursor < end) {
+        const char *lineEnd = (const char *) memchr(cursor, '\n', end - cursor);
+        lineEnd = lineEnd == nullptr ? end : lineEnd + 1;
+        int length = lineEnd - cursor;
+        const char *line = cursor;
+        cursor = lineEnd;
+        lineNumber++;
+        if (isBlankLine(line, length) || ignoreComment(line, length)) {
+            continue;
+        }
+        if (closed) {
+            //something after the closing #endif
+            return false;
+        }
+        significantCount++;
+        int index;
+        if (significantCount == 1) {
+            index = matchDirective(line, length, "ifndef", 6);
+            if (index < 0) {
+                return false;
+            }
+            int start = readIdentifier(line, index, length, &guard->macroLength);
+            if (guard->macroLength == 0) {
+                return false;
+            }
+            guard->macro = line + start;
+            depth = 1;
             continue;
         }
-        if (processLine(buffer)) {
+        if (significantCount == 2) {
+            index = matchDirective(line, length, DEFINE_TAG, DEFINE_TAG_LEN);
+            int macroLength = 0;
+            int start = index < 0 ? 0 : readIdentifier(line, index, length, &macroLength);
+            if (index < 0 || macroLength != guard->macroLength
+                || memcmp(line + start, guard->macro, macroLength) != 0) {
+                return false;
+            }
             continue;
         }
-        ProcessedSource *p = (ProcessedSource *) (pccMalloc(PREPROCESSOR_TAG, sizeof(ProcessedSource)));
-        int lineLength = strlen(buffer);
-        p->line = (char *) pccMalloc(PREPROCESSOR_TAG, lineLength);
-        p->next = nullptr;
-        memcpy((void *) p->line, buffer, lineLength);
-        p->length = lineLength;
-        //linked list
-        if (sourceHead == nullptr) {
-            sourceHead = p;
-        } else {
-            ProcessedSource *tail = sourceHead;
-            while (tail->next != nullptr) {
-                tail = tail->next;
+        if (matchDirective(line, length, "if", 2) >= 0
+            || matchDirective(line, length, "ifdef", 5) >= 0
+            || matchDirective(line, length, "ifndef", 6) >= 0) {
+            depth++;
+        } else if (matchDirective(line, length, "endif", 5) >= 0) {
+            depth--;
+            if (depth == 0) {
+                closed = true;
             }
-            tail->next = p;
+        } else if (depth == 1 && (matchDirective(line, length, "else", 4) >= 0
+                                  || matchDirective(line, length, "elif", 4) >= 0)) {
+            //a branch of the guard #ifndef itself, the second include takes it
+            return false;
         }
     }
-    fclose(inputFile);
+    return closed;
 }
 
-bool processLine(char *line) {
-    int length = strlen(line);
+/**
+ * the index of the '\' when the line ends in one, -1 otherwise.
+ */
+static int continuationIndex(const char *line, int length) {
+    int end = length;
+    while (end > 0 && (line[end - 1] == '\n' || line[end - 1] == '\r')) {
+        end--;
+    }
+    return end > 0 && line[end - 1] == '\\' ? end - 1 : -1;
+}
+
+static void appendSplice(size_t *spliceSize, const char *text, int length) {
+    if (spliceBuffer == nullptr) {
+        spliceCapacity = INIT_LINE_CAPACITY;
+        spliceBuffer = pccNewArray<char>(preprocessorSpace, spliceCapacity);
+    }
+    spliceBuffer = (char *) growArray(spliceBuffer, *spliceSize, &spliceCapacity, *spliceSize + length, sizeof(char));
+    memcpy(spliceBuffer + *spliceSize, text, length);
+    *spliceSize += length;
+}
+
+/**
+ * cheap check for '#' first, most lines are no directive at all.
+ */
+static ConditionalDirective matchConditional(const char *line, int length, int *index) {
+    int start = skipBlank(line, 0, length);
+    if (start >= length || line[start] != '#') {
+        return DIRECTIVE_NONE;
+    }
+    if ((*index = matchDirective(line, length, "if", 2)) >= 0) {
+        return DIRECTIVE_IF;
+    }
+    if ((*index = matchDirective(line, length, "ifdef", 5)) >= 0) {
+        return DIRECTIVE_IFDEF;
+    }
+    if ((*index = matchDirective(line, length, "ifndef", 6)) >= 0) {
+        return DIRECTIVE_IFNDEF;
+    }
+    if ((*index = matchDirective(line, length, "elif", 4)) >= 0) {
+        return DIRECTIVE_ELIF;
+    }
+    if ((*index = matchDirective(line, length, "else", 4)) >= 0) {
+        return DIRECTIVE_ELSE;
+    }
+    if ((*index = matchDirective(line, length, "endif", 5)) >= 0) {
+        return DIRECTIVE_ENDIF;
+    }
+    return DIRECTIVE_NONE;
+}
+
+/**
+ * skip a disabled region without copying or lexing it, only the first char of every line is looked at.
+ * returns the start of the #elif, #else or #endif ending the region, or end.
+ */
+static const char *skipDisabledRegion(const char *cursor, const char *end, uint32_t *lineNumber) {
+    int depth = 0;
+    while (cursor < end) {
+        const char *first = cursor;
+        while (first < end && (*first == ' ' || *first == '\t')) {
+            first++;
+        }
+        //a last line of only blanks leaves nothing to search
+        const char *lineEnd = first < end ? (const char *) memchr(first, '\n', (size_t) (end - first)) : nullptr;
+        lineEnd = lineEnd == nullptr ? end : lineEnd + 1;
+        if (first < end && *first == '#') {
+            int index = 0;
+            ConditionalDirective directive = matchConditional(cursor, lineEnd - cursor, &index);
+            if (directive == DIRECTIVE_IF || directive == DIRECTIVE_IFDEF || directive == DIRECTIVE_IFNDEF) {
+                depth++;
+            } else if (directive == DIRECTIVE_ENDIF) {
+                if (depth == 0) {
+                    return cursor;
+                }
+                depth--;
+            } else if ((directive == DIRECTIVE_ELIF || directive == DIRECTIVE_ELSE) && depth == 0) {
+                return cursor;
+            }
+        }
+        (*lineNumber)++;
+        cursor = lineEnd;
+    }
+    return end;
+}
+
+/**
+ * the line without its '\n', for messages.
+ */
+static int visibleLength(const char *line, int length) {
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+        length--;
+    }
+    return length;
+}
+
+/**
+ * where the line's text ends before joining the next line to it: at a // comment outside literals,
+ * else before the line break.
+ */
+static int joinableLength(const char *line, int length) {
+    for (int i = 0; i < length; i++) {
+        char c = line[i];
+        if (c == '"' || c == '\'') {
+            for (i++; i < length && line[i] != c; i++) {
+                if (line[i] == '\\') {
+                    i++;
+                }
+            }
+        } else if (c == '/' && i + 1 < length && line[i + 1] == '/') {
+            return i;
+        }
+    }
+    return visibleLength(line, length);
+}
+
+static bool evaluateIf(const char *fileName, uint32_t lineNumber, const char *line, int index, int length) {
+    int expressionLength = 0;
+    const char *expression = expandCondition(line, index, length, &expressionLength);
+    long long value = 0;
+    const char *errorMessage = nullptr;
+    if (!evaluateCondition(expression, expressionLength, &value, &errorMessage)) {
+        loge(PREPROCESSOR_TAG, "%s:%u: %s in #if: %.*s", fileName, lineNumber, errorMessage,
+             visibleLength(line, length), line);
+        exit(-1);
+    }
+    return value != 0;
+}
+
+/**
+ * returns whether the lines after the directive are compiled.
+ */
+static bool processConditional(ConditionalStack *stack, ConditionalDirective directive,
+                               const char *fileName, uint32_t lineNumber,
+                               const char *line, int index, int length) {
+    if (directive != DIRECTIVE_IF && directive != DIRECTIVE_IFDEF && directive != DIRECTIVE_IFNDEF
+        && stack->depth == 0) {
+        loge(PREPROCESSOR_TAG, "%s:%u: %.*s without #if", fileName, lineNumber, visibleLength(line, length), line);
+        exit(-1);
+    }
+    Conditional *top = stack->depth > 0 ? &stack->conditionals[stack->depth - 1] : nullptr;
+    switch (directive) {
+        case DIRECTIVE_IF:
+        case DIRECTIVE_IFDEF:
+        case DIRECTIVE_IFNDEF: {
+            if (stack->depth == MAX_CONDITIONAL_DEPTH) {
+                loge(PREPROCESSOR_TAG, "%s:%u: #if nested too deep", fileName, lineNumber);
+                exit(-1);
+            }
+            bool value;
+            if (directive == DIRECTIVE_IF) {
+                value = evaluateIf(fileName, lineNumber, line, index, length);
+            } else {
+                int nameLength = 0;
+                int start = readIdentifier(line, index, length, &nameLength);
+                if (nameLength == 0) {
+                    loge(PREPROCESSOR_TAG, "%s:%u: macro name missing: %.*s", fileName, lineNumber,
+                         visibleLength(line, length), line);
+                    exit(-1);
+                }
+                value = isMacroDefined(line + start, nameLength) == (directive == DIRECTIVE_IFDEF);
+            }
+            stack->conditionals[stack->depth++] = {value, false, lineNumber};
+            return value;
+        }
+        case DIRECTIVE_ELIF: {
+            if (top->seenElse) {
+                loge(PREPROCESSOR_TAG, "%s:%u: #elif after #else", fileName, lineNumber);
+                exit(-1);
+            }
+            if (top->taken) {
+                return false;
+            }
+            top->taken = evaluateIf(fileName, lineNumber, line, index, length);
+            return top->taken;
+        }
+        case DIRECTIVE_ELSE: {
+            if (top->seenElse) {
+                loge(PREPROCESSOR_TAG, "%s:%u: #else after #else", fileName, lineNumber);
+                exit(-1);
+            }
+            top->seenElse = true;
+            bool active = !top->taken;
+            top->taken = true;
+            return active;
+        }
+        case DIRECTIVE_ENDIF:
+            stack->depth--;
+            return true;
+        case DIRECTIVE_NONE:
+            break;
+    }
+    return true;
+}
+
+/**
+ * split the mapping into lines (the '\n' is kept, like fgets did) and append the kept ones.
+ * ordinary lines go through macro expansion, the line table keeps their original line number.
+ * disabled #if regions are skipped by skipDisabledRegion and never reach the output.
+ */
+static void processSource(const char *fileName, const MappedFile *mappedFile) {
+    ConditionalStack conditionalStack;
+    conditionalStack.depth = 0;
+    uint32_t fileIndex = addFileName(fileName);
+    uint32_t lineNumber = 0;
+    const char *cursor = mappedFile->data;
+    const char *end = mappedFile->data + mappedFile->size;
+    while (cursor < end) {
+        const char *lineEnd = (const char *) memchr(cursor, '\n', end - cursor);
+        lineEnd = lineEnd == nullptr ? end : lineEnd + 1;
+        const char *line = cursor;
+        int length = lineEnd - cursor;
+        cursor = lineEnd;
+        uint32_t firstLineNumber = ++lineNumber;
+        int continuation = continuationIndex(line, length);
+        if (continuation >= 0) {
+            size_t spliceSize = 0;
+            while (continuation >= 0 && cursor < end) {
+                appendSplice(&spliceSize, line, continuation);
+                lineEnd = (const char *) memchr(cursor, '\n', end - cursor);
+                lineEnd = lineEnd == nullptr ? end : lineEnd + 1;
+                line = cursor;
+                length = lineEnd - cursor;
+                cursor = lineEnd;
+                lineNumber++;
+                continuation = continuationIndex(line, length);
+            }
+            appendSplice(&spliceSize, line, length);
+            line = spliceBuffer;
+            length = spliceSize;
+        }
+        int index = 0;
+        ConditionalDirective directive = matchConditional(line, length, &index);
+        if (directive != DIRECTIVE_NONE) {
+            if (!processConditional(&conditionalStack, directive, fileName, firstLineNumber, line, index, length)) {
+                const char *skipStart = cursor;
+                cursor = skipDisabledRegion(cursor, end, &lineNumber);
+                processedSource->skippedBytes += cursor - skipStart;
+            }
+            continue;
+        }
+        if (ignoreComment(line, length) || processLine(line, length)) {
+            continue;
+        }
+        int expandedLength = 0;
+        const char *expanded = expandMacros(line, length, &expandedLength);
+        if (expanded == nullptr) {
+            //the arguments of an invocation go on in the next lines, they are joined by a blank
+            size_t spliceSize = 0;
+            if (line == spliceBuffer) {
+                spliceSize = length;
+            } else {
+                appendSplice(&spliceSize, line, length);
+            }
+            while (expanded == nullptr) {
+                if (cursor >= end) {
+                    loge(PREPROCESSOR_TAG, "%s:%u: unterminated macro invocation", fileName, firstLineNumber);
+                    exit(-1);
+                }
+                spliceSize = joinableLength(spliceBuffer, spliceSize);
+                appendSplice(&spliceSize, " ", 1);
+                lineEnd = (const char *) memchr(cursor, '\n', end - cursor);
+                lineEnd = lineEnd == nullptr ? end : lineEnd + 1;
+                appendSplice(&spliceSize, cursor, lineEnd - cursor);
+                cursor = lineEnd;
+                lineNumber++;
+                expanded = expandMacros(spliceBuffer, spliceSize, &expandedLength);
+            }
+        }
+        appendLine(expanded, expandedLength, fileIndex, firstLineNumber);
+    }
+    if (conditionalStack.depth > 0) {
+        loge(PREPROCESSOR_TAG, "%s:%u: unterminated #if", fileName,
+             conditionalStack.conditionals[conditionalStack.depth - 1].lineNumber);
+        exit(-1);
+    }
+}
+
+static bool processFile(const char *path) {
+    MappedFile mappedFile;
+    if (!mapInputFile(path, &mappedFile)) {
+        return false;
+    }
+    if (processedSource == nullptr) {
+        processedSource = createProcessedSource(mappedFile.size + 1);
+    }
+    processedSource->inputBytes += mappedFile.size;
+    IncludeGuard guard;
+    bool guarded = currentIncludeFile != nullptr && detectIncludeGuard(&mappedFile, &guard);
+    if (guarded && currentIncludeFile->guardMacro == nullptr) {
+        char *macro = pccNewArray<char>(preprocessorSpace, guard.macroLength + 1);
+        memcpy(macro, guard.macro, guard.macroLength);
+        currentIncludeFile->guardMacro = macro;
+    }
+    if (guarded && isMacroDefined(guard.macro, guard.macroLength)) {
+        //the guard was defined before the first include, the whole file is compiled out
+        processedSource->skippedBytes += mappedFile.size;
+        unmapInputFile(&mappedFile);
+        return true;
+    }
+    processSource(path, &mappedFile);
+    //every kept line is copied into the output buffer
+    unmapInputFile(&mappedFile);
+    return true;
+}
+
+static void initIncludeTable(IncludeTable *table) {
+    table->capacity = INIT_INCLUDE_TABLE_CAPACITY;
+    table->count = 0;
+    table->slots = pccNewArray<IncludeSlot>(preprocessorSpace, table->capacity);
+}
+
+static uint64_t hashFileIdentity(const FileIdentity *identity) {
+    return hashMix64(identity->device * 31 + identity->inode) ^ hashMix64(identity->modifyTime);
+}
+
+static bool isSameFile(const FileIdentity *a, const FileIdentity *b) {
+    return a->device == b->device && a->inode == b->inode && a->modifyTime == b->modifyTime;
+}
+
+template<typename Match>
+static IncludeSlot *findIncludeSlot(IncludeTable *table, uint64_t hash, Match match) {
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        IncludeSlot *slot = &table->slots[i];
+        if (slot->file == nullptr || (slot->hash == hash && match(slot))) {
+            return slot;
+        }
+    }
+}
+
+/**
+ * keep the load factor under 3/4, called before every insertion.
+ */
+static void reserveIncludeSlot(IncludeTable *table) {
+    if ((table->count + 1) * 4 <= table->capacity * 3) {
+        return;
+    }
+    IncludeSlot *oldSlots = table->slots;
+    uint32_t oldCapacity = table->capacity;
+    table->capacity = oldCapacity * 2;
+    table->slots = pccNewArray<IncludeSlot>(preprocessorSpace, table->capacity);
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].file == nullptr) {
+            continue;
+        }
+        uint32_t index = oldSlots[i].hash & mask;
+        while (table->slots[index].file != nullptr) {
+            index = (index + 1) & mask;
+        }
+        table->slots[index] = oldSlots[i];
+    }
+    pccSpaceFree(preprocessorSpace, oldSlots);
+}
+
+static IncludeFile *findOrAddIncludeFile(const char *path, const FileIdentity *identity) {
+    reserveIncludeSlot(&includeFileTable);
+    uint64_t hash = hashFileIdentity(identity);
+    IncludeSlot *slot = findIncludeSlot(&includeFileTable, hash, [identity](IncludeSlot *candidate) {
+        return isSameFile(&candidate->file->identity, identity);
+    });
+    if (slot->file == nullptr) {
+        IncludeFile *file = pccNew<IncludeFile>(preprocessorSpace);
+        file->path = path;
+        file->identity = *identity;
+        slot->hash = hash;
+        slot->file = file;
+        includeFileTable.count++;
+    }
+    return slot->file;
+}
+
+static char *joinIncludePath(const char *directory, const char *includeFileName) {
+    size_t directoryLength = strlen(directory);
+    bool needSeparator = directoryLength > 0 && directory[directoryLength - 1] != '/';
+    size_t pathLength = directoryLength + (needSeparator ? 1 : 0) + strlen(includeFileName);
+    char *path = pccNewArray<char>(preprocessorSpace, pathLength + 1);
+    strcpy(path, directory);
+    if (needSeparator) {
+        strcat(path, "/");
+    }
+    strcat(path, includeFileName);
+    return path;
+}
+
+/**
+ * search -I paths, the working directory and the bundled include/ in that order.
+ * a spelling is resolved once per compilation, later includes of it never touch the file system.
+ */
+static IncludeFile *resolveInclude(const char *includeFileName) {
+    includeCacheStat.lookups++;
+    reserveIncludeSlot(&includeNameTable);
+    uint64_t hash = hashBytes(includeFileName, strlen(includeFileName));
+    IncludeSlot *slot = findIncludeSlot(&includeNameTable, hash, [includeFileName](IncludeSlot *candidate) {
+        return strcmp(candidate->name, includeFileName) == 0;
+    });
+    if (slot->file != nullptr) {
+        includeCacheStat.nameHits++;
+        return slot->file;
+    }
+    for (uint32_t i = 0; i < includePathCount + 2; i++) {
+        const char *directory = i < includePathCount ? includePaths[i] : (i == includePathCount ? "" : "include/");
+        char *path = joinIncludePath(directory, includeFileName);
+        FileIdentity identity;
+        if (!statInputFile(path, &identity)) {
+            pccSpaceFree(preprocessorSpace, path);
+            continue;
+        }
+        slot->hash = hash;
+        slot->name = includeFileName;
+        slot->file = findOrAddIncludeFile(path, &identity);
+        includeNameTable.count++;
+        return slot->file;
+    }
+    return nullptr;
+}
+
+void extraInclude(const char *includeFileName) {
+    IncludeFile *file = resolveInclude(includeFileName);
+    if (file == nullptr) {
+        loge(PREPROCESSOR_TAG, "can not found header file: %s", includeFileName);
+        exit(-1);
+    }
+    if (file->pragmaOnce || file->precompiled
+        || (file->guardMacro != nullptr && isMacroDefined(file->guardMacro, strlen(file->guardMacro)))) {
+        includeCacheStat.skipped++;
+        logd(PREPROCESSOR_TAG, "skip included file: %s", file->path);
+        return;
+    }
+    file->includeCount++;
+    IncludeFile *parentFile = currentIncludeFile;
+    currentIncludeFile = file;
+    if (!processFile(file->path)) {
+        loge(PREPROCESSOR_TAG, "can not open header file: %s", file->path);
+        exit(-1);
+    }
+    currentIncludeFile = parentFile;
+}
+
+/**
+ * only #pragma once is known, every other pragma is dropped.
+ */
+static void processPragma(const char *line, int index, int length) {
+    int nameLength = 0;
+    int start = readIdentifier(line, index, length, &nameLength);
+    if (nameLength == 4 && memcmp(line + start, "once", 4) == 0) {
+        if (currentIncludeFile != nullptr) {
+            currentIncludeFile->pragmaOnce = true;
+        }
+        return;
+    }
+    logd(PREPROCESSOR_TAG, "ignore #pragma: %.*s", length, line);
+}
+
+bool processLine(const char *line, int length) {
+    int pragmaIndex = matchDirective(line, length, PRAGMA_TAG, PRAGMA_TAG_LEN);
+    if (pragmaIndex >= 0) {
+        processPragma(line, pragmaIndex, length);
+        return true;
+    }
+    int defineIndex = matchDirective(line, length, DEFINE_TAG, DEFINE_TAG_LEN);
+    if (defineIndex >= 0) {
+        defineMacro(line, defineIndex, length);
+        return true;
+    }
+    int undefIndex = matchDirective(line, length, UNDEF_TAG, UNDEF_TAG_LEN);
+    if (undefIndex >= 0) {
+        undefineMacro(line, undefIndex, length);
+        return true;
+    }
+    if (matchDirective(line, length, ERROR_TAG, ERROR_TAG_LEN) >= 0) {
+        loge(PREPROCESSOR_TAG, "%.*s", visibleLength(line, length), line);
+        exit(-1);
+    }
     bool skipTrim = true;
     bool isMacro = false;
     for (int i = 0; i < length; i++) {
@@ -88,11 +804,10 @@ bool processLine(char *line) {
         }
         skipTrim = false;
         if (isMacro) {
-            bool isInclude = true;
-            for (int j = 0; j < INCLUDE_TAG_LEN; j++) {
+            bool isInclude = i + INCLUDE_TAG_LEN <= length;
+            for (int j = 0; isInclude && j < INCLUDE_TAG_LEN; j++) {
                 if (line[j + i] != INCLUDE_TAG[j]) {
                     isInclude = false;
-                    break;
                 }
             }
             if (isInclude) {
@@ -106,11 +821,11 @@ bool processLine(char *line) {
                     }
                 }
                 if (startIdx == -1 || endIdx == -1 || endIdx - startIdx < 2) {
-                    loge(PREPROCESSOR_TAG, "invalid #include: %s", line);
+                    loge(PREPROCESSOR_TAG, "invalid #include: %.*s", length, line);
                     exit(-1);
                 }
                 int includeFileLen = endIdx - startIdx + 1;
-                char *includeFileName = (char *) pccMalloc(PREPROCESSOR_TAG, includeFileLen);
+                char *includeFileName = pccNewArray<char>(preprocessorSpace, includeFileLen + 1);
                 memcpy(includeFileName, line + startIdx, includeFileLen);
                 logd(PREPROCESSOR_TAG, "find include file: \"%s\"", includeFileName);
                 extraInclude(includeFileName);
@@ -125,38 +840,82 @@ bool processLine(char *line) {
     return false;
 }
 
+static void readyPreprocessor() {
+    if (preprocessorReady) {
+        return;
+    }
+    processedSource = nullptr;
+    currentIncludeFile = nullptr;
+    initIncludeTable(&includeNameTable);
+    initIncludeTable(&includeFileTable);
+    includeCacheStat = {0, 0, 0};
+    initMacroTable();
+    preprocessorReady = true;
+}
+
 ProcessedSource *preprocess(const char *sourceFilePath) {
     logd(PREPROCESSOR_TAG, "preprocess...");
-    FILE *inputFile = fopen(sourceFilePath, "r");
-    char buffer[BUFFER_SIZE];
-    while (fgets(buffer, BUFFER_SIZE, inputFile) != nullptr) {
-        if (ignoreComment(buffer)) {
-            continue;
-        }
-        if (processLine(buffer)) {
-            continue;
+    readyPreprocessor();
+    //the main file is in the file table too, a precompiled header records it with its includes
+    FileIdentity identity;
+    if (statInputFile(sourceFilePath, &identity)) {
+        IncludeFile *mainFile = findOrAddIncludeFile(sourceFilePath, &identity);
+        mainFile->includeCount++;
+    }
+    if (!processFile(sourceFilePath)) {
+        loge(PREPROCESSOR_TAG, "can not open source file: %s", sourceFilePath);
+        exit(-1);
+    }
+    logd(PREPROCESSOR_TAG, "preprocessed %u lines, %zu bytes", processedSource->lineCount, processedSource->size);
+    logd(PREPROCESSOR_TAG, "input %llu bytes: %llu processed, %llu skipped in disabled regions",
+         (unsigned long long) processedSource->inputBytes,
+         (unsigned long long) (processedSource->inputBytes - processedSource->skippedBytes),
+         (unsigned long long) processedSource->skippedBytes);
+    logd(PREPROCESSOR_TAG, "include cache: %u files, %u lookups, %u name hits, %u skipped",
+         includeFileTable.count, includeCacheStat.lookups, includeCacheStat.nameHits, includeCacheStat.skipped);
+    MacroStat macroStat;
+    getMacroStat(&macroStat);
+    logd(PREPROCESSOR_TAG, "macros: %u defined, %llu expansions, %llu lookups, %.2f probes per lookup",
+         macroStat.macroCount, (unsigned long long) macroStat.expansions, (unsigned long long) macroStat.lookups,
+         macroStat.lookups == 0 ? 0.0 : (double) macroStat.probes / macroStat.lookups);
+    return processedSource;
+}
+
+void addIncludePath(const char *path) {
+    if (includePathCount == includePathCapacity) {
+        includePathCapacity = includePathCapacity == 0 ? INIT_INCLUDE_PATH_CAPACITY : includePathCapacity * 2;
+        includePaths = (const char **) realloc(includePaths, includePathCapacity * sizeof(const char *));
+        if (includePaths == nullptr) {
+            loge(PREPROCESSOR_TAG, "out of memory");
+            exit(-1);
         }
-        ProcessedSource *p = (ProcessedSource *) (pccMalloc(PREPROCESSOR_TAG, sizeof(ProcessedSource)));
-        int lineLength = strlen(buffer);
-        p->line = (char *) pccMalloc(PREPROCESSOR_TAG, lineLength);
-        p->next = nullptr;
-        memcpy((void *) p->line, buffer, lineLength);
-        p->length = lineLength;
-        //linked list
-        if (sourceHead == nullptr) {
-            sourceHead = p;
-        } else {
-            ProcessedSource *tail = sourceHead;
-            while (tail->next != nullptr) {
-                tail = tail->next;
-            }
-            tail->next = p;
+    }
+    includePaths[includePathCount++] = path;
+}
+
+void addPrecompiledFile(const char *path, const FileIdentity *identity) {
+    readyPreprocessor();
+    IncludeFile *file = findOrAddIncludeFile(path, identity);
+    file->precompiled = true;
+}
+
+void visitIncludedFiles(IncludedFileVisitor visitor, void *arg) {
+    for (uint32_t i = 0; i < includeFileTable.capacity; i++) {
+        IncludeFile *file = includeFileTable.slots[i].file;
+        if (file != nullptr && (file->includeCount > 0 || file->precompiled)) {
+            visitor(file->path, &file->identity, arg);
         }
     }
-    fclose(inputFile);
-    return sourceHead;
 }
 
 void releasePreProcessorMemory() {
-    pccFreeSpace(PREPROCESSOR_TAG);
-}
\ No newline at end of file
+    preprocessorReady = false;
+    processedSource = nullptr;
+    currentIncludeFile = nullptr;
+    includeNameTable = {nullptr, 0, 0};
+    includeFileTable = {nullptr, 0, 0};
+    spliceBuffer = nullptr;
+    spliceCapacity = 0;
+    releaseMacroMemory();
+    pccResetSpace(preprocessorSpace);
+}
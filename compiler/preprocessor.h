@@ -5,13 +5,60 @@
 #ifndef PCC_PREPROCESSOR_H
 #define PCC_PREPROCESSOR_H
 
+#include <stdint.h>
+#include <stddef.h>
+#include "file.h"
+
+struct SourceLine {
+    //start of the line in ProcessedSource::text, the trailing '\n' is part of the line
+    uint32_t offset;
+    uint32_t length;
+    //origin: index into ProcessedSource::fileNames and 1 based line number in that file
+    uint32_t fileIndex;
+    uint32_t lineNumber;
+};
+
+/**
+ * the preprocessed translation unit: every kept line in one contiguous buffer,
+ * plus a side table with where each line starts and where it came from.
+ */
 struct ProcessedSource {
-    char *line;
-    int length;
-    ProcessedSource *next;
+    //null terminated
+    char *text;
+    size_t size;
+    size_t capacity;
+
+    SourceLine *lines;
+    uint32_t lineCount;
+    uint32_t lineCapacity;
+
+    const char **fileNames;
+    uint32_t fileCount;
+    uint32_t fileCapacity;
+
+    //bytes of every processed file, and the part of them in disabled #if regions that was only scanned
+    uint64_t inputBytes;
+    uint64_t skippedBytes;
 };
 
 extern ProcessedSource *preprocess(const char *sourceFilePath);
+
+/**
+ * -I, searched in order before the working directory and the bundled include/.
+ */
+extern void addIncludePath(const char *path);
+/**
+ * mark a file as provided by a precompiled header before preprocess, every #include of it is skipped.
+ */
+extern void addPrecompiledFile(const char *path, const FileIdentity *identity);
+
+typedef void (*IncludedFileVisitor)(const char *path, const FileIdentity *identity, void *arg);
+
+/**
+ * visit the main file and every file it included, after preprocess.
+ */
+extern void visitIncludedFiles(IncludedFileVisitor visitor, void *arg);
+
 extern void releasePreProcessorMemory();
 
 #endif //PCC_PREPROCESSOR_H
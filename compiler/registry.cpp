@@ -0,0 +1,130 @@
+//
+// Created by Park Yu on 2024/12/21.
+//
+
+#include "registry.h"
+#include "hash.h"
+#include "mspace.h"
+
+static const char *REGISTRY_TAG = "registry";
+
+static MemSpace *registrySpace = pccCreateSpace(REGISTRY_TAG);
+
+#define INIT_REGISTRY_CAPACITY 256
+
+/**
+ * open addressing, linear probing, functions are never removed.
+ * infos are allocated one by one so pointers to them survive a grow.
+ */
+struct FunctionSlot {
+    const char *name;
+    FunctionInfo *info;
+};
+
+struct FunctionRegistry {
+    FunctionSlot *slots;
+    uint32_t capacity;
+    uint32_t count;
+};
+
+static FunctionRegistry registry = {nullptr, 0, 0};
+//the parser threads look up calls at the same time
+static std::atomic<uint64_t> lookups(0);
+static std::atomic<uint64_t> probes(0);
+
+void initFunctionRegistry() {
+    registry.capacity = INIT_REGISTRY_CAPACITY;
+    registry.slots = pccNewArray<FunctionSlot>(registrySpace, registry.capacity);
+    registry.count = 0;
+    lookups = 0;
+    probes = 0;
+}
+
+static inline uint32_t slotIndex(const char *name, uint32_t mask) {
+    return (uint32_t) hashMix64((uint64_t) (uintptr_t) name) & mask;
+}
+
+static FunctionSlot *probeSlot(const char *name) {
+    uint32_t mask = registry.capacity - 1;
+    uint32_t index = slotIndex(name, mask);
+    uint64_t probeCount = 1;
+    for (;; index = (index + 1) & mask, probeCount++) {
+        FunctionSlot *slot = &registry.slots[index];
+        if (slot->name == nullptr || slot->name == name) {
+            lookups.fetch_add(1, std::memory_order_relaxed);
+            probes.fetch_add(probeCount, std::memory_order_relaxed);
+            return slot;
+        }
+    }
+}
+
+static void growRegistry() {
+    FunctionSlot *oldSlots = registry.slots;
+    uint32_t oldCapacity = registry.capacity;
+    registry.capacity = oldCapacity * 2;
+    registry.slots = pccNewArray<FunctionSlot>(registrySpace, registry.capacity);
+    uint32_t mask = registry.capacity - 1;
+    for (uint32_t i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].name == nullptr) {
+            continue;
+        }
+        uint32_t index = slotIndex(oldSlots[i].name, mask);
+        while (registry.slots[index].name != nullptr) {
+            index = (index + 1) & mask;
+        }
+        registry.slots[index] = oldSlots[i];
+    }
+    pccSpaceFree(registrySpace, oldSlots);
+}
+
+FunctionInfo *registerFunction(AstMethodDefine *define) {
+    const char *name = define->identity->name;
+    FunctionSlot *slot = probeSlot(name);
+    if (slot->name != nullptr) {
+        return slot->info;
+    }
+    //load factor stays below 1/2
+    if ((registry.count + 1) * 2 > registry.capacity) {
+        growRegistry();
+        slot = probeSlot(name);
+    }
+    FunctionInfo *info = pccNew<FunctionInfo>(registrySpace);
+    info->name = name;
+    info->index = registry.count;
+    info->define = define;
+    info->returnType = *define->type;
+    info->isExtern = true;
+    info->textIndex = -1;
+    slot->name = name;
+    slot->info = info;
+    registry.count++;
+    return info;
+}
+
+FunctionInfo *findFunction(const char *name) {
+    if (registry.slots == nullptr) {
+        return nullptr;
+    }
+    return probeSlot(name)->info;
+}
+
+uint32_t getFunctionCount() {
+    return registry.count;
+}
+
+void getFunctionRegistryStat(FunctionRegistryStat *stat) {
+    *stat = {registry.count, 0, 0, lookups.load(std::memory_order_relaxed), probes.load(std::memory_order_relaxed)};
+    for (uint32_t i = 0; i < registry.capacity; i++) {
+        const FunctionInfo *info = registry.slots[i].info;
+        if (info == nullptr) {
+            continue;
+        }
+        stat->externCount += info->isExtern;
+        stat->callCount += info->callCount;
+    }
+}
+
+void releaseFunctionRegistryMemory() {
+    registry = {nullptr, 0, 0};
+    pccResetSpace(registrySpace);
+}
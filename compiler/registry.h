@@ -0,0 +1,63 @@
+//
+// Created by Park Yu on 2024/12/21.
+//
+
+#ifndef PCC_REGISTRY_H
+#define PCC_REGISTRY_H
+
+#include <stdint.h>
+#include <atomic>
+#include "ast.h"
+
+/**
+ * what every phase knows about a function, built while parsing and kept until the binary is written.
+ */
+struct FunctionInfo {
+    //interned, compared by pointer
+    const char *name;
+    //registration order, code parsed after the first declaration sees only functions with a smaller index
+    uint32_t index;
+    //the first declaration, the parser checks calls against it. valid until releaseAstMemory
+    AstMethodDefine *define;
+    AstType returnType;
+    uint32_t paramCount;
+    //no body seen, the backend links it against a stub
+    bool isExtern;
+    //calls of it in the source, counted by every parser thread
+    std::atomic<uint32_t> callCount;
+    //instruction index of its label once the backend emitted it, -1 before
+    int32_t textIndex;
+};
+
+struct FunctionRegistryStat {
+    uint32_t functionCount;
+    uint32_t externCount;
+    uint64_t callCount;
+    uint64_t lookups;
+    //slots visited by all lookups, probes / lookups is the average chain length
+    uint64_t probes;
+};
+
+/**
+ * start a compilation with no functions.
+ */
+extern void initFunctionRegistry();
+
+/**
+ * register the function define declares, before its params are parsed so the body can call it.
+ * the first declaration of a name is kept, later ones return the same info.
+ */
+extern FunctionInfo *registerFunction(AstMethodDefine *define);
+
+/**
+ * O(1), nullptr for a name no declaration registered. safe on several threads while nothing registers.
+ */
+extern FunctionInfo *findFunction(const char *name);
+
+extern uint32_t getFunctionCount();
+
+extern void getFunctionRegistryStat(FunctionRegistryStat *stat);
+
+extern void releaseFunctionRegistryMemory();
+
+#endif //PCC_REGISTRY_H
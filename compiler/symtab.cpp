@@ -0,0 +1,205 @@
+//
+// Created by Park Yu on 2024/12/20.
+//
+
+#include <string.h>
+#include "symtab.h"
+#include "hash.h"
+
+#define INIT_SYMBOL_SLOT_CAPACITY 256
+#define INIT_SYMBOL_CAPACITY 64
+#define INIT_SCOPE_CAPACITY 16
+#define NO_SYMBOL UINT32_MAX
+
+/**
+ * one declaration. it is alive while its scope is open: the scope at its depth is still the one it was made in.
+ */
+struct Symbol {
+    AstIdentity *identity;
+    uint32_t scopeDepth;
+    uint32_t scopeSerial;
+    //the declaration of the same name this one hides, NO_SYMBOL when none
+    uint32_t shadowed;
+};
+
+/**
+ * a slot belongs to the method of its epoch, older slots count as empty.
+ * names are never removed inside a method, so probe chains have no holes.
+ */
+struct SymbolSlot {
+    const char *name;
+    uint32_t epoch;
+    //innermost declaration of name, its scope may be closed already
+    uint32_t symbol;
+    //declarations of name in this method
+    uint32_t declarationCount;
+};
+
+struct SymbolTable {
+    MemSpace *space;
+    SymbolSlot *slots;
+    uint32_t capacity;
+    //slots of the current epoch
+    uint32_t nameCount;
+    uint32_t epoch;
+
+    Symbol *symbols;
+    uint32_t symbolCount;
+    uint32_t symbolCapacity;
+
+    //serial of the open scope at every depth, depth 0 is the method's
+    uint32_t *scopeSerials;
+    uint32_t scopeDepth;
+    uint32_t scopeCapacity;
+    uint32_t nextScopeSerial;
+
+    uint64_t lookups;
+    uint64_t probes;
+};
+
+SymbolTable *createSymbolTable(MemSpace *space) {
+    SymbolTable *table = pccNew<SymbolTable>(space);
+    table->space = space;
+    table->capacity = INIT_SYMBOL_SLOT_CAPACITY;
+    table->slots = pccNewArray<SymbolSlot>(space, table->capacity);
+    table->symbolCapacity = INIT_SYMBOL_CAPACITY;
+    table->symbols = pccNewArray<Symbol>(space, table->symbolCapacity);
+    table->scopeCapacity = INIT_SCOPE_CAPACITY;
+    table->scopeSerials = pccNewArray<uint32_t>(space, table->scopeCapacity);
+    return table;
+}
+
+static inline uint32_t slotIndex(const char *name, uint32_t mask) {
+    return (uint32_t) hashMix64((uint64_t) (uintptr_t) name) & mask;
+}
+
+/**
+ * keep the slots of this method, the ones of earlier methods are dropped on the way.
+ */
+static void growSlots(SymbolTable *table) {
+    SymbolSlot *oldSlots = table->slots;
+    uint32_t oldCapacity = table->capacity;
+    table->capacity = oldCapacity * 2;
+    table->slots = pccNewArray<SymbolSlot>(table->space, table->capacity);
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].epoch != table->epoch) {
+            continue;
+        }
+        uint32_t index = slotIndex(oldSlots[i].name, mask);
+        while (table->slots[index].epoch == table->epoch) {
+            index = (index + 1) & mask;
+        }
+        table->slots[index] = oldSlots[i];
+    }
+    pccSpaceFree(table->space, oldSlots);
+}
+
+/**
+ * the slot of name, or the free one it would take.
+ */
+static SymbolSlot *probeSlot(SymbolTable *table, const char *name) {
+    table->lookups++;
+    uint32_t mask = table->capacity - 1;
+    uint32_t index = slotIndex(name, mask);
+    for (;; index = (index + 1) & mask) {
+        table->probes++;
+        SymbolSlot *slot = &table->slots[index];
+        if (slot->epoch != table->epoch || slot->name == name) {
+            return slot;
+        }
+    }
+}
+
+template<typename T>
+static T *growArray(MemSpace *space, T *array, uint32_t count, uint32_t *capacity) {
+    *capacity *= 2;
+    T *grown = pccNewArray<T>(space, *capacity);
+    memcpy(grown, array, count * sizeof(T));
+    pccSpaceFree(space, array);
+    return grown;
+}
+
+static inline bool isSymbolAlive(SymbolTable *table, const Symbol *symbol) {
+    return symbol->scopeDepth <= table->scopeDepth
+           && table->scopeSerials[symbol->scopeDepth] == symbol->scopeSerial;
+}
+
+/**
+ * the innermost declaration of the slot that is alive. closed scopes never open again,
+ * so the slot skips the dead ones for good.
+ */
+static uint32_t findAliveSymbol(SymbolTable *table, SymbolSlot *slot) {
+    uint32_t index = slot->symbol;
+    while (index != NO_SYMBOL && !isSymbolAlive(table, &table->symbols[index])) {
+        index = table->symbols[index].shadowed;
+    }
+    slot->symbol = index;
+    return index;
+}
+
+void beginMethodScope(SymbolTable *table) {
+    table->epoch++;
+    table->nameCount = 0;
+    table->symbolCount = 0;
+    table->scopeDepth = 0;
+    table->scopeSerials[0] = table->nextScopeSerial++;
+}
+
+void openScope(SymbolTable *table) {
+    if (table->scopeDepth + 1 == table->scopeCapacity) {
+        table->scopeSerials = growArray(table->space, table->scopeSerials, table->scopeCapacity,
+                                        &table->scopeCapacity);
+    }
+    table->scopeSerials[++table->scopeDepth] = table->nextScopeSerial++;
+}
+
+void closeScope(SymbolTable *table) {
+    table->scopeDepth--;
+}
+
+uint32_t declareSymbol(SymbolTable *table, const char *name, AstIdentity *identity) {
+    SymbolSlot *slot = probeSlot(table, name);
+    if (slot->epoch != table->epoch) {
+        //load factor stays below 1/2
+        if ((table->nameCount + 1) * 2 > table->capacity) {
+            growSlots(table);
+            slot = probeSlot(table, name);
+        }
+        slot->name = name;
+        slot->epoch = table->epoch;
+        slot->symbol = NO_SYMBOL;
+        slot->declarationCount = 0;
+        table->nameCount++;
+    }
+    uint32_t hidden = findAliveSymbol(table, slot);
+    if (hidden != NO_SYMBOL && table->symbols[hidden].scopeDepth == table->scopeDepth) {
+        return SYMBOL_REDEFINED;
+    }
+    if (table->symbolCount == table->symbolCapacity) {
+        table->symbols = growArray(table->space, table->symbols, table->symbolCount, &table->symbolCapacity);
+    }
+    Symbol *symbol = &table->symbols[table->symbolCount];
+    symbol->identity = identity;
+    symbol->scopeDepth = table->scopeDepth;
+    symbol->scopeSerial = table->scopeSerials[table->scopeDepth];
+    symbol->shadowed = hidden;
+    slot->symbol = table->symbolCount++;
+    return slot->declarationCount++;
+}
+
+AstIdentity *findSymbol(SymbolTable *table, const char *name) {
+    SymbolSlot *slot = probeSlot(table, name);
+    if (slot->epoch != table->epoch) {
+        return nullptr;
+    }
+    uint32_t index = findAliveSymbol(table, slot);
+    return index == NO_SYMBOL ? nullptr : table->symbols[index].identity;
+}
+
+void getSymbolTableStat(SymbolTable *table, SymbolTableStat *stat) {
+    stat->symbolCount = table->symbolCount;
+    stat->scopeDepth = table->scopeDepth;
+    stat->lookups = table->lookups;
+    stat->probes = table->probes;
+}
@@ -0,0 +1,61 @@
+//
+// Created by Park Yu on 2024/12/20.
+//
+
+#ifndef PCC_SYMTAB_H
+#define PCC_SYMTAB_H
+
+#include <stdint.h>
+#include "ast.h"
+#include "mspace.h"
+
+//declareSymbol: the innermost scope already declares the name
+#define SYMBOL_REDEFINED UINT32_MAX
+
+struct SymbolTableStat {
+    //declarations of the current method and the scopes open now
+    uint32_t symbolCount;
+    uint32_t scopeDepth;
+    uint64_t lookups;
+    //slots visited by all lookups, probes / lookups is the average chain length
+    uint64_t probes;
+};
+
+/**
+ * the vars of one method, block scoped. keys are interned names, so a probe compares pointers.
+ * open addressing over every name of the method, each name points at its innermost declaration,
+ * which points at the one it hides. closing a scope only forgets it, lookups skip its declarations.
+ */
+struct SymbolTable;
+
+/**
+ * the table and everything it grows into live in space.
+ */
+extern SymbolTable *createSymbolTable(MemSpace *space);
+
+/**
+ * forget the last method and open its outermost scope, the one of the params and the body block.
+ */
+extern void beginMethodScope(SymbolTable *table);
+
+extern void openScope(SymbolTable *table);
+
+/**
+ * O(1), the declarations of the scope stay in the table but are never found again.
+ */
+extern void closeScope(SymbolTable *table);
+
+/**
+ * declare name in the innermost scope.
+ * returns how many declarations of name came before it in this method, SYMBOL_REDEFINED when one is in this scope.
+ */
+extern uint32_t declareSymbol(SymbolTable *table, const char *name, AstIdentity *identity);
+
+/**
+ * the innermost declaration of name in an open scope, nullptr when there is none.
+ */
+extern AstIdentity *findSymbol(SymbolTable *table, const char *name);
+
+extern void getSymbolTableStat(SymbolTable *table, SymbolTableStat *stat);
+
+#endif //PCC_SYMTAB_H
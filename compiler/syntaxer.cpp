@@ -2,264 +2,505 @@
 // Created by Park Yu on 2024/9/11.
 //
 #include <limits.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "syntaxer.h"
 #include "logger.h"
 #include "string.h"
 #include "mspace.h"
+#include "keyword.h"
+#include "lexer.h"
+#include "symtab.h"
+#include "registry.h"
+#include "intern.h"
 
 //16KB
 #define BUFFER_SIZE 16384
 #define SYNTAX_TAG "syntaxer"
+//chunk array entries of an arena before its first doubling
+#define INIT_AST_CHUNK_CAPACITY 16
 
-struct VarListNode {
-    AstIdentity *identity;
-    VarListNode *next;
-};
+static MemSpace *syntaxSpace = pccCreateSpace(SYNTAX_TAG);
+
+//the space of the calling thread: syntaxSpace, or the one forked for a worker
+static thread_local MemSpace *threadSpace;
+//vars of the method the calling thread parses
+static thread_local SymbolTable *varTable;
+//functions declared before that method, calls of later ones are undefined
+static thread_local uint32_t visibleFunctionCount;
+//shared by every thread: a stream over a token list never slides
+static TokenStream *tokenStream;
+//internString is not thread safe, only the renaming of shadowed vars calls it while parsing
+static std::mutex internLock;
 
-struct VarStackNode {
-    VarListNode *varListHead;
-    VarStackNode *next;
+/**
+ * a method body left for the workers, its signature is parsed and registered already.
+ */
+struct DeferredBody {
+    AstMethodDefine *define;
+    //the { of the body
+    Token *token;
+    uint32_t visibleFunctionCount;
 };
 
-struct MethodListNode {
-    AstMethodDefine *methodDefine;
-    MethodListNode *next;
+#define INIT_DEFERRED_BODY_CAPACITY 256
+
+//set by buildAstParallel: method bodies are skipped by brace matching and parsed later
+static bool deferringBodies = false;
+static DeferredBody *deferredBodies;
+static uint32_t deferredBodyCount;
+static uint32_t deferredBodyCapacity;
+
+/**
+ * the chunk of T a thread takes nodes from, nodes [start, next) are handed out and left more follow.
+ */
+struct AstCursor {
+    uint32_t start;
+    uint32_t next;
+    uint32_t left;
 };
 
-static VarStackNode *varStackHead;
-static MethodListNode *methodListHead;
+template<typename T>
+static thread_local AstCursor astCursor = {0, 0, 0};
 
-inline static bool hasVarDefine(const char *name) {
-    VarStackNode *stackNode = varStackHead;
-    while (stackNode != nullptr) {
-        VarListNode *p = stackNode->varListHead;
-        while (p != nullptr) {
-            if (strcmp(p->identity->name, name) == 0) {
-                return true;
-            }
-            p = p->next;
-        }
-        stackNode = stackNode->next;
-    }
-    return false;
+//a chunk is claimed under it once every AST_CHUNK_SIZE nodes of a type, the nodes themselves are not locked
+static std::mutex astArenaLock;
+
+/**
+ * count the nodes of the cursor's chunk, the rest of it stays unused. holds astArenaLock.
+ */
+template<typename T>
+static void retireAstChunk(AstArena<T> &arena, AstCursor *cursor) {
+    arena.nodeCount += cursor->next - cursor->start;
+    *cursor = {0, 0, 0};
 }
 
-inline static bool hasMethodDefine(const char *name) {
-    MethodListNode *p = methodListHead;
-    while (p != nullptr) {
-        if (strcmp(p->methodDefine->identity->name, name) == 0) {
-            return true;
+/**
+ * claim chunkCount chunks in a row for the cursor, they share one block so their nodes are consecutive in memory.
+ */
+template<typename T>
+static void claimAstChunks(AstCursor *cursor, uint32_t chunkCount) {
+    std::lock_guard<std::mutex> guard(astArenaLock);
+    AstArena<T> &arena = astArena<T>;
+    retireAstChunk(arena, cursor);
+    if (chunkCount > AST_MAX_CHUNK_COUNT - arena.chunkCount) {
+        loge(SYNTAX_TAG, "[-]error: too many ast nodes");
+        exit(-1);
+    }
+    uint32_t firstChunkIndex = arena.chunkCount;
+    arena.chunkCount += chunkCount;
+    T **chunks = arena.chunks.load(std::memory_order_relaxed);
+    if (arena.chunkCount > arena.chunkCapacity) {
+        uint32_t capacity = arena.chunkCapacity == 0 ? INIT_AST_CHUNK_CAPACITY : arena.chunkCapacity;
+        while (capacity < arena.chunkCount) {
+            capacity *= 2;
+        }
+        //the old array is not freed, other threads may still be reading it
+        T **grown = pccNewArray<T *>(threadSpace, capacity);
+        if (chunks != nullptr) {
+            memcpy(grown, chunks, firstChunkIndex * sizeof(T *));
         }
-        p = p->next;
+        chunks = grown;
+        arena.chunkCapacity = capacity;
+    }
+    T *nodes = pccNewArray<T>(threadSpace, (size_t) chunkCount * AST_CHUNK_SIZE);
+    for (uint32_t i = 0; i < chunkCount; i++) {
+        chunks[firstChunkIndex + i] = &nodes[(size_t) i * AST_CHUNK_SIZE];
+    }
+    arena.chunks.store(chunks, std::memory_order_release);
+    cursor->start = firstChunkIndex << AST_CHUNK_BITS;
+    cursor->left = chunkCount * AST_CHUNK_SIZE;
+    if (firstChunkIndex == 0) {
+        //index 0 is the null reference
+        cursor->start = 1;
+        cursor->left--;
     }
-    return false;
+    cursor->next = cursor->start;
 }
 
-inline static AstMethodDefine *getMethodDefine(const char *name) {
-    MethodListNode *p = methodListHead;
-    while (p != nullptr) {
-        if (strcmp(p->methodDefine->identity->name, name) == 0) {
-            return p->methodDefine;
-        }
-        p = p->next;
+/**
+ * count zero filled nodes of T with consecutive indexes, the returned ref is the first one.
+ * they are consecutive in memory too, &*nodes is an array of count.
+ */
+template<typename T>
+static AstRef<T> newAstNodes(uint32_t count) {
+    AstCursor &cursor = astCursor<T>;
+    if (cursor.left < count) {
+        //one node more than count, chunk 0 gives up its first one
+        claimAstChunks<T>(&cursor, (count >> AST_CHUNK_BITS) + 1);
     }
-    return nullptr;
+    cursor.left -= count;
+    AstRef<T> nodes(cursor.next);
+    cursor.next += count;
+    return nodes;
 }
 
-inline static void pushMethod(AstMethodDefine *astMethodDefine) {
-    MethodListNode *methodListNode = (MethodListNode *) pccMalloc(SYNTAX_TAG, sizeof(MethodListNode));
-    methodListNode->next = nullptr;
-    methodListNode->methodDefine = astMethodDefine;
+/**
+ * a zero filled node of the calling thread's chunk of T.
+ */
+template<typename T>
+static AstRef<T> newAstNode() {
+    return newAstNodes<T>(1);
+}
 
-    if (methodListHead == nullptr) {
-        methodListHead = methodListNode;
-    } else {
-        MethodListNode *p = methodListHead;
-        while (p->next != nullptr) {
-            p = p->next;
+/**
+ * count the nodes of every chunk the calling thread took from, called when it is done parsing.
+ */
+static void retireAstCursors() {
+    std::lock_guard<std::mutex> guard(astArenaLock);
+#define RETIRE_AST_CURSOR(type) retireAstChunk(astArena<type>, &astCursor<type>);
+    PCC_AST_NODE_TYPES(RETIRE_AST_CURSOR)
+#undef RETIRE_AST_CURSOR
+}
+
+/**
+ * the operands of a flat node that is still being parsed, the top ones belong to the innermost expression.
+ * an operand can hold a whole expression, a call argument, so the operands of several nodes pile up here
+ * until each is copied into a span of its own.
+ */
+template<typename T>
+struct ChainStack {
+    T *nodes;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+#define INIT_CHAIN_STACK_CAPACITY 64
+
+template<typename T>
+static thread_local ChainStack<T> chainStack = {nullptr, 0, 0};
+
+template<typename T>
+static void pushChainNode(const T &node) {
+    ChainStack<T> &stack = chainStack<T>;
+    if (stack.count == stack.capacity) {
+        uint32_t capacity = stack.capacity == 0 ? INIT_CHAIN_STACK_CAPACITY : stack.capacity * 2;
+        T *nodes = pccNewArray<T>(threadSpace, capacity);
+        if (stack.nodes != nullptr) {
+            memcpy(nodes, stack.nodes, stack.count * sizeof(T));
+            pccSpaceFree(threadSpace, stack.nodes);
         }
-        p->next = methodListNode;
+        stack.nodes = nodes;
+        stack.capacity = capacity;
     }
+    stack.nodes[stack.count++] = node;
+}
+
+/**
+ * move the nodes pushed since base into a span of the arena.
+ */
+template<typename T>
+static AstRef<T> popChainSpan(uint32_t base, uint32_t *count) {
+    ChainStack<T> &stack = chainStack<T>;
+    *count = stack.count - base;
+    AstRef<T> span = newAstNodes<T>(*count);
+    memcpy(&*span, &stack.nodes[base], *count * sizeof(T));
+    stack.count = base;
+    return span;
+}
 
-    VarStackNode *stackNode = (VarStackNode *) pccMalloc(SYNTAX_TAG, sizeof(VarStackNode));
-    stackNode->varListHead = nullptr;
-    stackNode->next = nullptr;
-    if (varStackHead == nullptr) {
-        varStackHead = stackNode;
+/**
+ * the next token, the window may slide: only the returned pointer and the one before it stay valid.
+ */
+inline static Token *consumeToken(Token *token) {
+    return advanceTokenStream(tokenStream, token);
+}
+
+/**
+ * register the method and open the scope of its params.
+ */
+inline static FunctionInfo *pushMethod(AstMethodDefine *astMethodDefine) {
+    FunctionInfo *function = registerFunction(astMethodDefine);
+    beginMethodScope(varTable);
+    visibleFunctionCount = getFunctionCount();
+    return function;
+}
+
+/**
+ * the function token calls, nullptr unless it was declared before the method being parsed.
+ */
+static FunctionInfo *findCalledFunction(const Token *token) {
+    FunctionInfo *function = findFunction(token->content);
+    return function != nullptr && function->index < visibleFunctionCount ? function : nullptr;
+}
+
+/**
+ * "file:line:column: message: spelling", the location of the token that did not fit.
+ */
+static void logTokenError(const Token *token, const char *message) {
+    uint32_t tokenIndex = tokenStream->windowStart + (uint32_t) (token - tokenStream->window);
+    loge(SYNTAX_TAG, "[-]error: %s:%u:%u: %s: %s", getTokenFileName(&tokenStream->files, tokenIndex), token->line,
+         token->column, message, token->content);
+}
+
+/**
+ * declare the var of token in the innermost scope. a spelling declared before in this method gets a name
+ * of its own, "i.1" for the second i, later phases know one var per name and method.
+ */
+static void declareVar(const Token *token, AstIdentity *identity) {
+    uint32_t earlier = declareSymbol(varTable, token->content, identity);
+    if (earlier == SYMBOL_REDEFINED) {
+        logTokenError(token, "var redefined");
+        exit(-1);
+    }
+    if (earlier == 0) {
+        identity->name = token->content;
     } else {
-        VarStackNode *stackTop = varStackHead;
-        while (stackTop->next != nullptr) {
-            stackTop = stackTop->next;
+        //spelling, '.', at most 10 digits and the terminator
+        size_t size = strlen(token->content) + 12;
+        char *name = pccNewArray<char>(threadSpace, size);
+        int length = snprintf(name, size, "%s.%u", token->content, earlier);
+        {
+            std::lock_guard<std::mutex> guard(internLock);
+            identity->name = internString(name, length);
         }
-        stackTop->next = stackNode;
+        pccSpaceFree(threadSpace, name);
     }
 }
 
-inline static void freeVarStack(VarStackNode *varStackNode) {
-    if (varStackNode->next != nullptr) {
-        loge(SYNTAX_TAG, "free non top node!");
-        exit(-1);
-    }
-    VarListNode *varListNode = varStackNode->varListHead;
-    while (varListNode != nullptr) {
-        VarListNode *next = varListNode->next;
-        pccFree(SYNTAX_TAG, varListNode);
-        varListNode = next;
+/**
+ * the name of the declaration the var token refers to, its spelling when nothing declares it.
+ */
+static const char *getVarName(const Token *token) {
+    AstIdentity *identity = findSymbol(varTable, token->content);
+    return identity != nullptr ? identity->name : token->content;
+}
+
+static void deferBody(AstMethodDefine *define, Token *token) {
+    if (deferredBodyCount == deferredBodyCapacity) {
+        uint32_t capacity = deferredBodyCapacity == 0 ? INIT_DEFERRED_BODY_CAPACITY : deferredBodyCapacity * 2;
+        DeferredBody *bodies = pccNewArray<DeferredBody>(syntaxSpace, capacity);
+        if (deferredBodies != nullptr) {
+            memcpy(bodies, deferredBodies, deferredBodyCount * sizeof(DeferredBody));
+            pccSpaceFree(syntaxSpace, deferredBodies);
+        }
+        deferredBodies = bodies;
+        deferredBodyCapacity = capacity;
     }
-    pccFree(SYNTAX_TAG, varStackNode);
+    deferredBodies[deferredBodyCount++] = {define, token, visibleFunctionCount};
 }
 
-inline static void popMethod() {
-    VarStackNode *stackTop = varStackHead;
-    if (stackTop->next == nullptr) {
-        freeVarStack(varStackHead);
-        varStackHead = nullptr;
-    } else {
-        while (stackTop->next->next != nullptr) {
-            stackTop = stackTop->next;
+/**
+ * the token after the } matching the { at token. braces only ever open and close blocks.
+ */
+static Token *skipBlock(Token *token) {
+    uint32_t depth = 0;
+    do {
+        if (token->kind == KIND_LEFT_BRACE) {
+            depth++;
+        } else if (token->kind == KIND_RIGHT_BRACE) {
+            depth--;
+        } else if (token->tokenType == TOKEN_END) {
+            logTokenError(token, "code block define need }");
+            exit(-1);
         }
-        freeVarStack(stackTop->next);
-        stackTop->next = nullptr;
+        token = consumeToken(token);
+    } while (depth > 0);
+    return token;
+}
+
+inline static PrimitiveType convertTokenType2PrimitiveType(const Token *token) {
+    const ReservedWord *reserved = getReservedWord(token->kind);
+    if (reserved == nullptr || reserved->primitiveType == TYPE_UNKNOWN) {
+        logTokenError(token, "unknown type");
+        return TYPE_UNKNOWN;
     }
+    return reserved->primitiveType;
 }
 
-inline static void addVar(AstIdentity *astIdentity) {
-    VarStackNode *stackTop = varStackHead;
-    while (stackTop->next != nullptr) {
-        stackTop = stackTop->next;
+Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType);
+
+inline static ArithmeticOperatorType convertToken2ArithmeticOperator(const Token *token) {
+    //a '*' after a factor multiplies, the lexer can not tell it from a dereference
+    switch (token->kind) {
+        case KIND_PLUS:
+            return ARITHMETIC_ADD;
+        case KIND_MINUS:
+            return ARITHMETIC_SUB;
+        case KIND_STAR:
+            return ARITHMETIC_MUL;
+        case KIND_SLASH:
+            return ARITHMETIC_DIV;
+        case KIND_PERCENT:
+            return ARITHMETIC_MOD;
+        default:
+            return ARITHMETIC_NULL;
     }
-    VarListNode *varListNode = (VarListNode *) pccMalloc(SYNTAX_TAG, sizeof(VarListNode));
-    varListNode->next = nullptr;
-    varListNode->identity = astIdentity;
-    if (stackTop->varListHead == nullptr) {
-        stackTop->varListHead = varListNode;
-    } else {
-        VarListNode *varListTail = stackTop->varListHead;
-        while (varListTail->next != nullptr) {
-            varListTail = varListTail->next;
+}
+
+/**
+ * precedence climbing over two left associative levels, + - below * / %, with the open operands on chain stacks:
+ * a * / % adds a factor to the open item, a + - closes the item into the expression, anything else closes both.
+ * every operator is one turn of the loop, so a chain of any length takes no stack.
+ */
+static Token *parseArithmeticExpression(Token *token, AstExpressionArithmetic *expression) {
+    uint32_t itemBase = chainStack<AstArithmeticItem>.count;
+    uint32_t factorBase = chainStack<AstArithmeticFactor>.count;
+    AstArithmeticItem item = {nullptr, 0, ARITHMETIC_NULL};
+    ArithmeticOperatorType factorOperator = ARITHMETIC_NULL;
+    for (;;) {
+        AstArithmeticFactor factor = {};
+        factor.arithmeticOperatorType = factorOperator;
+        token = travelAst(token, &factor, NODE_ARITHMETIC_FACTOR);
+        pushChainNode(factor);
+        ArithmeticOperatorType nextOperator = convertToken2ArithmeticOperator(token);
+        if (nextOperator == ARITHMETIC_MUL || nextOperator == ARITHMETIC_DIV || nextOperator == ARITHMETIC_MOD) {
+            factorOperator = nextOperator;
+            //consume * / %
+            token = consumeToken(token);
+            continue;
+        }
+        item.arithmeticFactors = popChainSpan<AstArithmeticFactor>(factorBase, &item.arithmeticFactorCount);
+        pushChainNode(item);
+        if (nextOperator == ARITHMETIC_NULL) {
+            break;
         }
-        varListTail->next = varListNode;
+        item.arithmeticOperatorType = nextOperator;
+        factorOperator = ARITHMETIC_NULL;
+        //consume + -
+        token = consumeToken(token);
     }
+    expression->arithmeticItems = popChainSpan<AstArithmeticItem>(itemBase, &expression->arithmeticItemCount);
+    return token;
 }
 
-inline static PrimitiveType convertTokenType2PrimitiveType(const char *type) {
-    if (strcmp(type, "char") == 0) {
-        return TYPE_CHAR;
-    } else if (strcmp(type, "short") == 0) {
-        return TYPE_SHORT;
-    } else if (strcmp(type, "int") == 0) {
-        return TYPE_INT;
-    } else if (strcmp(type, "long") == 0) {
-        return TYPE_LONG;
-    } else if (strcmp(type, "float") == 0) {
-        return TYPE_FLOAT;
-    } else if (strcmp(type, "double") == 0) {
-        return TYPE_DOUBLE;
-    } else if (strcmp(type, "void") == 0) {
-        return TYPE_VOID;
-    } else {
-        loge(SYNTAX_TAG, "[-]error: unknown type: %s", type);
-        return TYPE_UNKNOWN;
+/**
+ * the same climbing as parseArithmeticExpression, && binds tighter than ||.
+ */
+static Token *parseBoolExpression(Token *token, AstExpressionBool *expression) {
+    uint32_t itemBase = chainStack<AstBoolItem>.count;
+    uint32_t factorBase = chainStack<AstBoolFactor>.count;
+    for (;;) {
+        AstBoolFactor factor = {};
+        token = travelAst(token, &factor, NODE_BOOL_FACTOR);
+        pushChainNode(factor);
+        if (token->kind == KIND_AND) {
+            //consume &&
+            token = consumeToken(token);
+            continue;
+        }
+        AstBoolItem item;
+        item.boolFactors = popChainSpan<AstBoolFactor>(factorBase, &item.boolFactorCount);
+        pushChainNode(item);
+        if (token->kind != KIND_OR) {
+            break;
+        }
+        //consume ||
+        token = consumeToken(token);
     }
+    expression->boolItems = popChainSpan<AstBoolItem>(itemBase, &expression->boolItemCount);
+    return token;
 }
 
 Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
     switch (nodeType) {
         case NODE_PROGRAM: {
             AstProgram *astProgram = (AstProgram *) currentNode;
-            if (token == nullptr) {
+            if (token->tokenType == TOKEN_END) {
                 astProgram->methodSeq = nullptr;
             } else {
-                astProgram->methodSeq = (AstMethodSeq *) pccMalloc(SYNTAX_TAG, sizeof(AstMethodSeq));
+                astProgram->methodSeq = newAstNode<AstMethodSeq>();
                 token = travelAst(token, astProgram->methodSeq, NODE_METHOD_SEQ);
             }
             break;
         }
         case NODE_METHOD_SEQ: {
             AstMethodSeq *astMethodSeq = (AstMethodSeq *) currentNode;
-            astMethodSeq->methodDefine = (AstMethodDefine *) pccMalloc(SYNTAX_TAG, sizeof(AstMethodDefine));
+            astMethodSeq->methodDefine = newAstNode<AstMethodDefine>();
             token = travelAst(token, astMethodSeq->methodDefine, NODE_METHOD_DEFINE);
-            if (token != nullptr) {
-                astMethodSeq->nextAstMethodSeq = (AstMethodSeq *) pccMalloc(SYNTAX_TAG, sizeof(AstMethodSeq));
+            if (token->tokenType != TOKEN_END) {
+                astMethodSeq->nextAstMethodSeq = newAstNode<AstMethodSeq>();
                 token = travelAst(token, astMethodSeq->nextAstMethodSeq, NODE_METHOD_SEQ);
             }
             break;
         }
         case NODE_METHOD_DEFINE: {
             AstMethodDefine *astMethodDefine = (AstMethodDefine *) currentNode;
-            if (token->tokenType == TOKEN_KEYWORD && strcmp(token->content, "extern") == 0) {
+            if (token->kind == KIND_EXTERN) {
                 //consume extern
-                token = token->next;
+                token = consumeToken(token);
                 astMethodDefine->defineType = METHOD_EXTERN;
             } else {
                 astMethodDefine->defineType = METHOD_IMPL;
             }
             //method type
             if (token->tokenType != TOKEN_TYPE && token->tokenType != TOKEN_POINTER_TYPE) {
-                loge(SYNTAX_TAG, "[-]error: method define need type: %s", token->content);
+                logTokenError(token, "method define need type");
                 exit(-1);
             }
-            astMethodDefine->type = (AstType *) pccMalloc(SYNTAX_TAG, sizeof(AstType));
+            astMethodDefine->type = newAstNode<AstType>();
             astMethodDefine->type->isPointer = (token->tokenType == TOKEN_POINTER_TYPE);
-            astMethodDefine->type->primitiveType = convertTokenType2PrimitiveType(token->content);
-            token = token->next;
+            astMethodDefine->type->primitiveType = convertTokenType2PrimitiveType(token);
+            token = consumeToken(token);
             //method name
             if (token->tokenType != TOKEN_IDENTIFIER) {
-                loge(SYNTAX_TAG, "[-]error: method define need identifier: %s", token->content);
+                logTokenError(token, "method define need identifier");
                 exit(-1);
             }
-            astMethodDefine->identity = (AstIdentity *) pccMalloc(SYNTAX_TAG, sizeof(AstIdentity));
+            astMethodDefine->identity = newAstNode<AstIdentity>();
             astMethodDefine->identity->name = token->content;
             astMethodDefine->identity->type = ID_METHOD;
-            token = token->next;
+            token = consumeToken(token);
             //method (
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, "(") != 0) {
-                loge(SYNTAX_TAG, "[-]error: method define need (: %s", token->content);
+            if (token->kind != KIND_LEFT_PAREN) {
+                logTokenError(token, "method define need (");
                 exit(-1);
             }
-            token = token->next;
-            pushMethod(astMethodDefine);
+            token = consumeToken(token);
+            FunctionInfo *function = pushMethod(astMethodDefine);
             //method param
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ")") == 0) {
+            if (token->kind == KIND_RIGHT_PAREN) {
                 astMethodDefine->paramList = nullptr;
             } else {
-                astMethodDefine->paramList = (AstParamList *) pccMalloc(SYNTAX_TAG, sizeof(AstParamList));
+                astMethodDefine->paramList = newAstNode<AstParamList>();
                 token = travelAst(token, astMethodDefine->paramList, NODE_PARAM_LIST);
             }
             //method )
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ")") != 0) {
-                loge(SYNTAX_TAG, "[-]error: method define need ): %s", token->content);
+            if (token->kind != KIND_RIGHT_PAREN) {
+                logTokenError(token, "method define need )");
                 exit(-1);
             }
-            token = token->next;
+            token = consumeToken(token);
+            if (function->define == astMethodDefine) {
+                for (AstParamList *param = astMethodDefine->paramList; param != nullptr; param = param->next) {
+                    function->paramCount++;
+                }
+            }
             // method code block "{}"
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ";") == 0) {
+            if (token->kind == KIND_SEMICOLON) {
                 //extern a method without "extern" keyword
                 astMethodDefine->defineType = METHOD_EXTERN;
                 astMethodDefine->statementBlock = nullptr;
-                token = token->next;
+                token = consumeToken(token);
             } else {
                 if (astMethodDefine->defineType == METHOD_EXTERN) {
-                    loge(SYNTAX_TAG, "[-]error: method define need \";\" at end: %s", token->content);
+                    logTokenError(token, "method define need \";\" at end");
                     exit(-1);
                 } else {
                     //method code block
-                    astMethodDefine->statementBlock = (AstStatementBlock *) pccMalloc(SYNTAX_TAG,
-                                                                                      sizeof(AstStatementBlock));
-                    token = travelAst(token, astMethodDefine->statementBlock, NODE_STATEMENT_BLOCK);
+                    function->isExtern = false;
+                    astMethodDefine->statementBlock = newAstNode<AstStatementBlock>();
+                    if (deferringBodies) {
+                        deferBody(astMethodDefine, token);
+                        token = skipBlock(token);
+                    } else {
+                        token = travelAst(token, astMethodDefine->statementBlock, NODE_STATEMENT_BLOCK);
+                    }
                 }
             }
-            popMethod();
             break;
         }
         case NODE_PARAM_LIST: {
             AstParamList *astParamList = (AstParamList *) currentNode;
-            astParamList->paramDefine = (AstParamDefine *) pccMalloc(SYNTAX_TAG, sizeof(AstParamDefine));
+            astParamList->paramDefine = newAstNode<AstParamDefine>();
             token = travelAst(token, astParamList->paramDefine, NODE_PARAM_DEFINE);
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ",") == 0) {
+            if (token->kind == KIND_COMMA) {
                 //consume ","
-                token = token->next;
-                astParamList->next = (AstParamList *) pccMalloc(SYNTAX_TAG, sizeof(AstParamList));
+                token = consumeToken(token);
+                astParamList->next = newAstNode<AstParamList>();
                 token = travelAst(token, astParamList->next, NODE_PARAM_LIST);
             } else {
                 astParamList->next = nullptr;
@@ -269,55 +510,54 @@ Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
         case NODE_PARAM_DEFINE: {
             AstParamDefine *astParamDefine = (AstParamDefine *) currentNode;
             if (token->tokenType != TOKEN_TYPE && token->tokenType != TOKEN_POINTER_TYPE) {
-                loge(SYNTAX_TAG, "[-]error: param define need type: %s", token->content);
+                logTokenError(token, "param define need type");
                 exit(-1);
             }
-            astParamDefine->type = (AstType *) pccMalloc(SYNTAX_TAG, sizeof(AstType));
-            astParamDefine->type->primitiveType = convertTokenType2PrimitiveType(token->content);
+            astParamDefine->type = newAstNode<AstType>();
+            astParamDefine->type->primitiveType = convertTokenType2PrimitiveType(token);
             astParamDefine->type->isPointer = (token->tokenType == TOKEN_POINTER_TYPE);
-            token = token->next;
+            token = consumeToken(token);
             if (token->tokenType != TOKEN_IDENTIFIER) {
-                loge(SYNTAX_TAG, "[-]error: param define need identifier: %s", token->content);
+                logTokenError(token, "param define need identifier");
                 exit(-1);
             }
-            astParamDefine->identity = (AstIdentity *) pccMalloc(SYNTAX_TAG, sizeof(AstIdentity));
-            astParamDefine->identity->name = token->content;
+            astParamDefine->identity = newAstNode<AstIdentity>();
             astParamDefine->identity->type = ID_VAR;
-            addVar(astParamDefine->identity);
-            token = token->next;
+            declareVar(token, astParamDefine->identity);
+            token = consumeToken(token);
             break;
         }
         case NODE_STATEMENT_BLOCK: {
             AstStatementBlock *astStatementBlock = (AstStatementBlock *) currentNode;
             //block {
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, "{") != 0) {
-                loge(SYNTAX_TAG, "[-]error: code block define need {: %s", token->content);
+            if (token->kind != KIND_LEFT_BRACE) {
+                logTokenError(token, "code block define need {");
                 exit(-1);
             }
-            token = token->next;
+            token = consumeToken(token);
             //statement seq
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, "}") == 0) {
+            if (token->kind == KIND_RIGHT_BRACE) {
                 astStatementBlock->statementSeq = nullptr;
             } else {
-                astStatementBlock->statementSeq = (AstStatementSeq *) pccMalloc(SYNTAX_TAG, sizeof(AstStatementSeq));
+                astStatementBlock->statementSeq = newAstNode<AstStatementSeq>();
                 token = travelAst(token, astStatementBlock->statementSeq, NODE_STATEMENT_SEQ);
             }
             //block }
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, "}") != 0) {
-                loge(SYNTAX_TAG, "[-]error: code block define need }: %s", token->content);
+            if (token->kind != KIND_RIGHT_BRACE) {
+                logTokenError(token, "code block define need }");
                 exit(-1);
             }
-            token = token->next;
+            token = consumeToken(token);
             break;
         }
         case NODE_STATEMENT_SEQ: {
             AstStatementSeq *astStatementSeq = (AstStatementSeq *) currentNode;
-            astStatementSeq->statement = (AstStatement *) pccMalloc(SYNTAX_TAG, sizeof(AstStatement));
+            astStatementSeq->statement = newAstNode<AstStatement>();
             token = travelAst(token, astStatementSeq->statement, NODE_STATEMENT);
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, "}") == 0) {
+            if (token->kind == KIND_RIGHT_BRACE) {
                 astStatementSeq->next = nullptr;
             } else {
-                astStatementSeq->next = (AstStatementSeq *) pccMalloc(SYNTAX_TAG, sizeof(AstStatementSeq));
+                astStatementSeq->next = newAstNode<AstStatementSeq>();
                 token = travelAst(token, astStatementSeq->next, NODE_STATEMENT_SEQ);
             }
             break;
@@ -325,92 +565,92 @@ Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
         case NODE_STATEMENT: {
             AstStatement *astStatement = (AstStatement *) currentNode;
             if (token->tokenType == TOKEN_KEYWORD) {
-                if (strcmp(token->content, "if") == 0) {
-                    astStatement->statementType = STATEMENT_IF;
-                    astStatement->ifStatement = (AstStatementIf *) pccMalloc(SYNTAX_TAG, sizeof(AstStatementIf));
-                    //consume if
-                    token = token->next;
-                    token = travelAst(token, astStatement->ifStatement, NODE_STATEMENT_IF);
-                } else if (strcmp(token->content, "while") == 0) {
-                    astStatement->statementType = STATEMENT_WHILE;
-                    astStatement->whileStatement = (AstStatementWhile *) pccMalloc(SYNTAX_TAG,
-                                                                                   sizeof(AstStatementWhile));
-                    //consume while
-                    token = token->next;
-                    token = travelAst(token, astStatement->whileStatement, NODE_STATEMENT_WHILE);
-                } else if (strcmp(token->content, "for") == 0) {
-                    astStatement->statementType = STATEMENT_FOR;
-                    astStatement->forStatement = (AstStatementFor *) pccMalloc(SYNTAX_TAG, sizeof(AstStatementFor));
-                    //consume for
-                    token = token->next;
-                    token = travelAst(token, astStatement->forStatement, NODE_STATEMENT_FOR);
-                } else if (strcmp(token->content, "return") == 0) {
-                    astStatement->statementType = STATEMENT_RETURN;
-                    astStatement->returnStatement = (AstStatementReturn *) pccMalloc(SYNTAX_TAG,
-                                                                                     sizeof(AstStatementReturn));
-                    //consume return
-                    token = token->next;
-                    token = travelAst(token, astStatement->forStatement, NODE_STATEMENT_RETURN);
+                switch (token->kind) {
+                    case KIND_IF:
+                        astStatement->statementType = STATEMENT_IF;
+                        astStatement->ifStatement = newAstNode<AstStatementIf>();
+                        //consume if
+                        token = consumeToken(token);
+                        token = travelAst(token, astStatement->ifStatement, NODE_STATEMENT_IF);
+                        break;
+                    case KIND_WHILE:
+                        astStatement->statementType = STATEMENT_WHILE;
+                        astStatement->whileStatement = newAstNode<AstStatementWhile>();
+                        //consume while
+                        token = consumeToken(token);
+                        token = travelAst(token, astStatement->whileStatement, NODE_STATEMENT_WHILE);
+                        break;
+                    case KIND_FOR:
+                        astStatement->statementType = STATEMENT_FOR;
+                        astStatement->forStatement = newAstNode<AstStatementFor>();
+                        //consume for
+                        token = consumeToken(token);
+                        token = travelAst(token, astStatement->forStatement, NODE_STATEMENT_FOR);
+                        break;
+                    case KIND_RETURN:
+                        astStatement->statementType = STATEMENT_RETURN;
+                        astStatement->returnStatement = newAstNode<AstStatementReturn>();
+                        //consume return
+                        token = consumeToken(token);
+                        token = travelAst(token, astStatement->returnStatement, NODE_STATEMENT_RETURN);
+                        break;
+                    default:
+                        break;
                 }
             } else if (token->tokenType == TOKEN_TYPE || token->tokenType == TOKEN_POINTER_TYPE) {
                 astStatement->statementType = STATEMENT_DEFINE;
-                astStatement->defineStatement = (AstStatementDefine *) pccMalloc(SYNTAX_TAG,
-                                                                                 sizeof(AstStatementDefine));
-                astStatement->defineStatement->type = (AstType *) pccMalloc(SYNTAX_TAG, sizeof(AstType));
-                astStatement->defineStatement->type->primitiveType = convertTokenType2PrimitiveType(token->content);
+                astStatement->defineStatement = newAstNode<AstStatementDefine>();
+                astStatement->defineStatement->type = newAstNode<AstType>();
+                astStatement->defineStatement->type->primitiveType = convertTokenType2PrimitiveType(token);
                 astStatement->defineStatement->type->isPointer = (token->tokenType == TOKEN_POINTER_TYPE);
-                token = token->next;
+                token = consumeToken(token);
                 if (token->tokenType != TOKEN_IDENTIFIER) {
-                    loge(SYNTAX_TAG, "[-]error: var define need identifier: %s", token->content);
+                    logTokenError(token, "var define need identifier");
                     exit(-1);
                 }
-                astStatement->defineStatement->identity = (AstIdentity *) pccMalloc(SYNTAX_TAG, sizeof(AstIdentity));
-                astStatement->defineStatement->identity->name = token->content;
-                //record
-                addVar(astStatement->defineStatement->identity);
-                token = token->next;
-                if (token->tokenType != TOKEN_OPERATOR || strcmp(token->content, "=") != 0) {
-                    loge(SYNTAX_TAG, "[-]error: var define need init fromValue: %s", token->content);
+                astStatement->defineStatement->identity = newAstNode<AstIdentity>();
+                //record, the var is in scope in its own initializer
+                declareVar(token, astStatement->defineStatement->identity);
+                token = consumeToken(token);
+                if (token->kind != KIND_ASSIGN) {
+                    logTokenError(token, "var define need init fromValue");
                     exit(-1);
                 }
                 //consume =
-                token = token->next;
-                astStatement->defineStatement->expression = (AstExpression *) pccMalloc(SYNTAX_TAG,
-                                                                                        sizeof(AstExpression));
+                token = consumeToken(token);
+                astStatement->defineStatement->expression = newAstNode<AstExpression>();
                 token = travelAst(token, astStatement->defineStatement->expression, NODE_EXPRESSION);
-                if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ";") != 0) {
-                    loge(SYNTAX_TAG, "[-]error: define need ;: %s", token->content);
+                if (token->kind != KIND_SEMICOLON) {
+                    logTokenError(token, "define need ;");
                     exit(1);
                 }
                 //consume ;
-                token = token->next;
+                token = consumeToken(token);
             } else {
-                if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, "{") == 0) {
+                if (token->kind == KIND_LEFT_BRACE) {
                     //do not consume {, left it to block statement
                     astStatement->statementType = STATEMENT_BLOCK;
-                    astStatement->blockStatement = (AstStatementBlock *) pccMalloc(SYNTAX_TAG,
-                                                                                   sizeof(AstStatementBlock));
+                    astStatement->blockStatement = newAstNode<AstStatementBlock>();
+                    //the body block of a method shares the scope of its params, a nested block opens its own
+                    openScope(varTable);
                     token = travelAst(token, astStatement->blockStatement, NODE_STATEMENT_BLOCK);
+                    closeScope(varTable);
                 } else if (token->tokenType == TOKEN_IDENTIFIER
-                           && token->next != nullptr
-                           && token->next->tokenType == TOKEN_BOUNDARY
-                           && strcmp(token->next->content, "(") == 0
+                           && (token + 1)->kind == KIND_LEFT_PAREN
                         ) {
                     //this is method call
-                    if (hasMethodDefine(token->content)) {
+                    if (findCalledFunction(token) != nullptr) {
                         astStatement->statementType = STATEMENT_METHOD_CALL;
-                        astStatement->methodCallStatement = (AstStatementMethodCall *) pccMalloc(SYNTAX_TAG,
-                                                                                                 sizeof(AstStatementMethodCall));
+                        astStatement->methodCallStatement = newAstNode<AstStatementMethodCall>();
                         token = travelAst(token, astStatement->methodCallStatement, NODE_STATEMENT_METHOD_CALL);
                     } else {
-                        loge(SYNTAX_TAG, "[-]error: undefined method: %s", token->content);
+                        logTokenError(token, "undefined method");
                         exit(1);
                     }
                 } else {
                     //assume this is expressions statement
                     astStatement->statementType = STATEMENT_EXPRESSION;
-                    astStatement->expressionsStatement = (AstStatementExpressions *) pccMalloc(SYNTAX_TAG,
-                                                                                               sizeof(AstStatementExpressions));
+                    astStatement->expressionsStatement = newAstNode<AstStatementExpressions>();
                     token = travelAst(token, astStatement->expressionsStatement, NODE_STATEMENT_EXPRESSIONS);
                 }
             }
@@ -418,370 +658,264 @@ Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
         }
         case NODE_STATEMENT_EXPRESSIONS: {
             AstStatementExpressions *astStatementExpressions = (AstStatementExpressions *) currentNode;
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ";") == 0) {
+            if (token->kind == KIND_SEMICOLON) {
                 astStatementExpressions->expression = nullptr;
             } else {
-                astStatementExpressions->expression = (AstExpression *) pccMalloc(SYNTAX_TAG, sizeof(AstExpression));
+                astStatementExpressions->expression = newAstNode<AstExpression>();
                 token = travelAst(token, astStatementExpressions->expression, NODE_EXPRESSION);
             }
             //consume ;
-            token = token->next;
+            token = consumeToken(token);
             break;
         }
         case NODE_EXPRESSION: {
             AstExpression *astExpression = (AstExpression *) currentNode;
-            if (token->tokenType == TOKEN_IDENTIFIER && token->next != nullptr) {
-                if (token->next->tokenType == TOKEN_BOUNDARY
-                    && strcmp(token->next->content, "[") == 0) {
+            if (token->tokenType == TOKEN_IDENTIFIER) {
+                if ((token + 1)->kind == KIND_LEFT_BRACKET) {
                     Token *forwardToken = token;
                     while (forwardToken != nullptr) {
 
                     }
                 }
-                if (token->next->tokenType == TOKEN_OPERATOR
-                    && strcmp(token->next->content, "=") == 0) {
+                if ((token + 1)->kind == KIND_ASSIGN) {
                     //assignment
-                    if (hasVarDefine(token->content)) {
+                    if (findSymbol(varTable, token->content) != nullptr) {
                         astExpression->expressionType = EXPRESSION_ASSIGNMENT;
-                        astExpression->assignmentExpression = (AstExpressionAssignment *) pccMalloc(SYNTAX_TAG,
-                                                                                                    sizeof(AstExpressionAssignment));
+                        astExpression->assignmentExpression = newAstNode<AstExpressionAssignment>();
                         token = travelAst(token, astExpression->assignmentExpression, NODE_EXPRESSION_ASSIGNMENT);
                     } else {
-                        loge(SYNTAX_TAG, "[-]error: undefined var: %s", token->content);
+                        logTokenError(token, "undefined var");
                     }
                     break;
-                } else if (token->next->tokenType == TOKEN_BOUNDARY
-                           && strcmp(token->next->content, "[") == 0) {
+                } else if ((token + 1)->kind == KIND_LEFT_BRACKET) {
 
                 }
             }
 
 
             if (token->tokenType == TOKEN_IDENTIFIER
-                && token->next != nullptr
-                && token->next->tokenType == TOKEN_OPERATOR
-                && strcmp(token->next->content, "=") == 0) {
+                && (token + 1)->kind == KIND_ASSIGN) {
                 //assignment
-                if (hasVarDefine(token->content)) {
+                if (findSymbol(varTable, token->content) != nullptr) {
                     astExpression->expressionType = EXPRESSION_ASSIGNMENT;
-                    astExpression->assignmentExpression = (AstExpressionAssignment *) pccMalloc(SYNTAX_TAG,
-                                                                                                sizeof(AstExpressionAssignment));
+                    astExpression->assignmentExpression = newAstNode<AstExpressionAssignment>();
                     token = travelAst(token, astExpression->assignmentExpression, NODE_EXPRESSION_ASSIGNMENT);
                 } else {
-                    loge(SYNTAX_TAG, "[-]error: undefined var: %s", token->content);
+                    logTokenError(token, "undefined var");
                 }
                 break;
             } if (token->tokenType == TOKEN_IDENTIFIER
-                  && token->next != nullptr
-                  && token->next->tokenType == TOKEN_BOUNDARY
-                  && strcmp(token->next->content, "[") == 0) {
+                  && (token + 1)->kind == KIND_LEFT_BRACKET) {
                 //assignment
-                if (hasVarDefine(token->content)) {
+                if (findSymbol(varTable, token->content) != nullptr) {
                     astExpression->expressionType = EXPRESSION_ASSIGNMENT;
-                    astExpression->assignmentExpression = (AstExpressionAssignment *) pccMalloc(SYNTAX_TAG,
-                                                                                                sizeof(AstExpressionAssignment));
+                    astExpression->assignmentExpression = newAstNode<AstExpressionAssignment>();
                     token = travelAst(token, astExpression->assignmentExpression, NODE_EXPRESSION_ASSIGNMENT);
                 } else {
-                    loge(SYNTAX_TAG, "[-]error: undefined var: %s", token->content);
+                    logTokenError(token, "undefined var");
                 }
                 break;
             } else {
                 astExpression->expressionType = EXPRESSION_ARITHMETIC;
-                astExpression->arithmeticExpression = (AstExpressionArithmetic *) pccMalloc(SYNTAX_TAG,
-                                                                                            sizeof(AstExpressionArithmetic));
+                astExpression->arithmeticExpression = newAstNode<AstExpressionArithmetic>();
                 token = travelAst(token, astExpression->arithmeticExpression, NODE_EXPRESSION_ARITHMETIC);
             }
             break;
         }
         case NODE_EXPRESSION_ASSIGNMENT: {
             AstExpressionAssignment *astExpressionAssignment = (AstExpressionAssignment *) currentNode;
-            astExpressionAssignment->identity = (AstIdentity *) pccMalloc(SYNTAX_TAG, sizeof(AstIdentity));
-            astExpressionAssignment->identity->name = token->content;
+            astExpressionAssignment->identity = newAstNode<AstIdentity>();
+            astExpressionAssignment->identity->name = getVarName(token);
             //consume identity
-            token = token->next;
-            if (token->tokenType != TOKEN_OPERATOR || strcmp(token->content, "=") != 0) {
-                loge(SYNTAX_TAG, "[-]error: var assignment need fromValue: %s", token->content);
+            token = consumeToken(token);
+            if (token->kind != KIND_ASSIGN) {
+                logTokenError(token, "var assignment need fromValue");
                 exit(-1);
             }
             //consume =
-            token = token->next;
-            astExpressionAssignment->expression = (AstExpression *) pccMalloc(SYNTAX_TAG,
-                                                                              sizeof(AstExpression));
+            token = consumeToken(token);
+            astExpressionAssignment->expression = newAstNode<AstExpression>();
             token = travelAst(token, astExpressionAssignment->expression,
                               NODE_EXPRESSION);
             break;
         }
         case NODE_OBJECT_LIST: {
             AstObjectList *astObjectList = (AstObjectList *) currentNode;
-            astObjectList->expression = (AstExpression *) pccMalloc(SYNTAX_TAG, sizeof(AstExpression));
+            astObjectList->expression = newAstNode<AstExpression>();
             token = travelAst(token, astObjectList->expression, NODE_EXPRESSION);
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ",") == 0) {
+            if (token->kind == KIND_COMMA) {
                 //consume ,
-                token = token->next;
-                astObjectList->objectMore = (AstObjectList *) pccMalloc(SYNTAX_TAG, sizeof(AstObjectList));
+                token = consumeToken(token);
+                astObjectList->objectMore = newAstNode<AstObjectList>();
                 token = travelAst(token, astObjectList->objectMore, NODE_OBJECT_LIST);
             }
             break;
         }
         case NODE_STATEMENT_IF: {
             AstStatementIf *astStatementIf = (AstStatementIf *) currentNode;
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, "(") != 0) {
-                loge(SYNTAX_TAG, "[-]error: need (: %s", token->content);
+            if (token->kind != KIND_LEFT_PAREN) {
+                logTokenError(token, "need (");
                 exit(-1);
             }
             //consume (
-            token = token->next;
-            astStatementIf->expression = (AstExpressionBool *) pccMalloc(SYNTAX_TAG, sizeof(AstExpressionBool));
+            token = consumeToken(token);
+            astStatementIf->expression = newAstNode<AstExpressionBool>();
             token = travelAst(token, astStatementIf->expression, NODE_EXPRESSION_BOOL);
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ")") != 0) {
-                loge(SYNTAX_TAG, "[-]error: need ): %s", token->content);
+            if (token->kind != KIND_RIGHT_PAREN) {
+                logTokenError(token, "need )");
                 exit(-1);
             }
             //consume )
-            token = token->next;
-            astStatementIf->trueStatement = (AstStatement *) pccMalloc(SYNTAX_TAG, sizeof(AstStatement));
+            token = consumeToken(token);
+            astStatementIf->trueStatement = newAstNode<AstStatement>();
             token = travelAst(token, astStatementIf->trueStatement, NODE_STATEMENT);
-            if (token->tokenType != TOKEN_KEYWORD || strcmp(token->content, "else") != 0) {
+            if (token->kind != KIND_ELSE) {
                 astStatementIf->falseStatement = nullptr;
             } else {
                 //consume else
-                token = token->next;
-                astStatementIf->falseStatement = (AstStatement *) pccMalloc(SYNTAX_TAG, sizeof(AstStatement));
+                token = consumeToken(token);
+                astStatementIf->falseStatement = newAstNode<AstStatement>();
                 token = travelAst(token, astStatementIf->falseStatement, NODE_STATEMENT);
             }
             break;
         }
         case NODE_STATEMENT_WHILE: {
             AstStatementWhile *astStatementWhile = (AstStatementWhile *) currentNode;
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, "(") != 0) {
-                loge(SYNTAX_TAG, "[-]error: need (: %s", token->content);
+            if (token->kind != KIND_LEFT_PAREN) {
+                logTokenError(token, "need (");
                 exit(-1);
             }
             //consume (
-            token = token->next;
-            astStatementWhile->expression = (AstExpressionBool *) pccMalloc(SYNTAX_TAG, sizeof(AstExpressionBool));
+            token = consumeToken(token);
+            astStatementWhile->expression = newAstNode<AstExpressionBool>();
             token = travelAst(token, astStatementWhile->expression, NODE_EXPRESSION_BOOL);
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ")") != 0) {
-                loge(SYNTAX_TAG, "[-]error: need ): %s", token->content);
+            if (token->kind != KIND_RIGHT_PAREN) {
+                logTokenError(token, "need )");
                 exit(-1);
             }
             //consume )
-            token = token->next;
-            astStatementWhile->statement = (AstStatement *) pccMalloc(SYNTAX_TAG, sizeof(AstStatement));
+            token = consumeToken(token);
+            astStatementWhile->statement = newAstNode<AstStatement>();
             token = travelAst(token, astStatementWhile->statement, NODE_STATEMENT);
             break;
         }
         case NODE_STATEMENT_FOR: {
             AstStatementFor *astStatementFor = (AstStatementFor *) currentNode;
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, "(") != 0) {
-                loge(SYNTAX_TAG, "[-]error: need (: %s", token->content);
+            if (token->kind != KIND_LEFT_PAREN) {
+                logTokenError(token, "need (");
                 exit(-1);
             }
             //consume (
-            token = token->next;
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ";") == 0) {
+            token = consumeToken(token);
+            if (token->kind == KIND_SEMICOLON) {
                 astStatementFor->initExpression = nullptr;
             } else {
-                astStatementFor->initExpression = (AstExpression *) pccMalloc(SYNTAX_TAG, sizeof(AstExpression));
+                astStatementFor->initExpression = newAstNode<AstExpression>();
                 token = travelAst(token, astStatementFor->initExpression, NODE_EXPRESSION);
             }
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ";") != 0) {
-                loge(SYNTAX_TAG, "[-]error: for 1st need ;: %s", token->content);
+            if (token->kind != KIND_SEMICOLON) {
+                logTokenError(token, "for 1st need ;");
                 exit(-1);
             }
             //consume ;
-            token = token->next;
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ";") == 0) {
+            token = consumeToken(token);
+            if (token->kind == KIND_SEMICOLON) {
                 astStatementFor->controlExpression = nullptr;
             } else {
-                astStatementFor->controlExpression = (AstExpressionBool *) pccMalloc(SYNTAX_TAG,
-                                                                                     sizeof(AstExpressionBool));
+                astStatementFor->controlExpression = newAstNode<AstExpressionBool>();
                 token = travelAst(token, astStatementFor->controlExpression, NODE_EXPRESSION_BOOL);
             }
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ";") != 0) {
-                loge(SYNTAX_TAG, "[-]error: for 2nd need ;: %s", token->content);
+            if (token->kind != KIND_SEMICOLON) {
+                logTokenError(token, "for 2nd need ;");
                 exit(-1);
             }
             //consume ;
-            token = token->next;
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ")") == 0) {
+            token = consumeToken(token);
+            if (token->kind == KIND_RIGHT_PAREN) {
                 astStatementFor->afterExpression = nullptr;
             } else {
-                astStatementFor->afterExpression = (AstExpression *) pccMalloc(SYNTAX_TAG, sizeof(AstExpression));
+                astStatementFor->afterExpression = newAstNode<AstExpression>();
                 token = travelAst(token, astStatementFor->afterExpression, NODE_EXPRESSION);
             }
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ")") != 0) {
-                loge(SYNTAX_TAG, "[-]error: need ): %s", token->content);
+            if (token->kind != KIND_RIGHT_PAREN) {
+                logTokenError(token, "need )");
                 exit(-1);
             }
             //consume )
-            token = token->next;
-            astStatementFor->statement = (AstStatement *) pccMalloc(SYNTAX_TAG, sizeof(AstStatement));
+            token = consumeToken(token);
+            astStatementFor->statement = newAstNode<AstStatement>();
             token = travelAst(token, astStatementFor->statement, NODE_STATEMENT);
             break;
         }
         case NODE_STATEMENT_RETURN: {
             AstStatementReturn *astStatementReturn = (AstStatementReturn *) currentNode;
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ";") == 0) {
+            if (token->kind == KIND_SEMICOLON) {
                 //void return
                 //todo check return type with method signature
                 astStatementReturn->expression = nullptr;
             } else {
-                astStatementReturn->expression = (AstExpression *) pccMalloc(SYNTAX_TAG, sizeof(AstExpression));
+                astStatementReturn->expression = newAstNode<AstExpression>();
                 token = travelAst(token, astStatementReturn->expression, NODE_EXPRESSION);
             }
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ";") != 0) {
-                loge(SYNTAX_TAG, "[-]error: return need ;: %s", token->content);
+            if (token->kind != KIND_SEMICOLON) {
+                logTokenError(token, "return need ;");
                 exit(-1);
             }
             //consume ;
-            token = token->next;
+            token = consumeToken(token);
             break;
         }
         case NODE_EXPRESSION_ARITHMETIC: {
-            AstExpressionArithmetic *astExpressionArithmetic = (AstExpressionArithmetic *) currentNode;
-            astExpressionArithmetic->arithmeticItem = (AstArithmeticItem *) pccMalloc(SYNTAX_TAG,
-                                                                                      sizeof(AstArithmeticItem));
-            token = travelAst(token, astExpressionArithmetic->arithmeticItem, NODE_ARITHMETIC_ITEM);
-            if (token->tokenType == TOKEN_OPERATOR) {
-                if (strcmp(token->content, "+") == 0 || strcmp(token->content, "-") == 0) {
-                    astExpressionArithmetic->arithmeticExpressMore = (AstExpressionArithmeticMore *) pccMalloc(
-                            SYNTAX_TAG,
-                            sizeof(AstExpressionArithmeticMore));
-                    token = travelAst(token, astExpressionArithmetic->arithmeticExpressMore,
-                                      NODE_EXPRESSION_ARITHMETIC_MORE);
-                } else {
-                    astExpressionArithmetic->arithmeticExpressMore = nullptr;
-                }
-            } else {
-                astExpressionArithmetic->arithmeticExpressMore = nullptr;
-            }
-
-            break;
-        }
-        case NODE_EXPRESSION_ARITHMETIC_MORE: {
-            AstExpressionArithmeticMore *astExpressionArithmeticMore = (AstExpressionArithmeticMore *) currentNode;
-            if (strcmp(token->content, "+") == 0) {
-                astExpressionArithmeticMore->arithmeticOperatorType = ARITHMETIC_ADD;
-            } else if (strcmp(token->content, "-") == 0) {
-                astExpressionArithmeticMore->arithmeticOperatorType = ARITHMETIC_SUB;
-            }
-            //consume + -
-            token = token->next;
-            astExpressionArithmeticMore->arithmeticItem = (AstArithmeticItem *) pccMalloc(SYNTAX_TAG,
-                                                                                          sizeof(AstArithmeticItem));
-            token = travelAst(token, astExpressionArithmeticMore->arithmeticItem, NODE_ARITHMETIC_ITEM);
-            if (strcmp(token->content, "+") == 0 || strcmp(token->content, "-") == 0) {
-                astExpressionArithmeticMore->arithmeticExpressMore = (AstExpressionArithmeticMore *) pccMalloc(
-                        SYNTAX_TAG,
-                        sizeof(AstExpressionArithmeticMore));
-                token = travelAst(token, astExpressionArithmeticMore->arithmeticExpressMore,
-                                  NODE_EXPRESSION_ARITHMETIC_MORE);
-            } else {
-                astExpressionArithmeticMore->arithmeticExpressMore = nullptr;
-            }
-            break;
-        }
-        case NODE_ARITHMETIC_ITEM: {
-            AstArithmeticItem *astArithmeticItem = (AstArithmeticItem *) currentNode;
-            astArithmeticItem->arithmeticFactor = (AstArithmeticFactor *) pccMalloc(SYNTAX_TAG,
-                                                                                    sizeof(AstArithmeticFactor));
-            token = travelAst(token, astArithmeticItem->arithmeticFactor, NODE_ARITHMETIC_FACTOR);
-            if (token->tokenType == TOKEN_OPERATOR) {
-                if (strcmp(token->content, "*") == 0
-                    || strcmp(token->content, "/") == 0
-                    || strcmp(token->content, "%") == 0) {
-                    astArithmeticItem->arithmeticItemMore = (AstArithmeticItemMore *) pccMalloc(SYNTAX_TAG,
-                                                                                                sizeof(AstArithmeticItemMore));
-                    token = travelAst(token, astArithmeticItem->arithmeticItemMore,
-                                      NODE_ARITHMETIC_ITEM_MORE);
-                } else {
-                    astArithmeticItem->arithmeticItemMore = nullptr;
-                }
-            } else {
-                astArithmeticItem->arithmeticItemMore = nullptr;
-            }
-            break;
-        }
-        case NODE_ARITHMETIC_ITEM_MORE: {
-            AstArithmeticItemMore *astArithmeticItemMore = (AstArithmeticItemMore *) currentNode;
-            if (strcmp(token->content, "*") == 0) {
-                astArithmeticItemMore->arithmeticOperatorType = ARITHMETIC_MUL;
-            } else if (strcmp(token->content, "/") == 0) {
-                astArithmeticItemMore->arithmeticOperatorType = ARITHMETIC_DIV;
-            } else if (strcmp(token->content, "%") == 0) {
-                astArithmeticItemMore->arithmeticOperatorType = ARITHMETIC_MOD;
-            }
-            //consume * / %
-            token = token->next;
-            astArithmeticItemMore->arithmeticFactor = (AstArithmeticFactor *) pccMalloc(SYNTAX_TAG,
-                                                                                        sizeof(AstArithmeticFactor));
-            token = travelAst(token, astArithmeticItemMore->arithmeticFactor, NODE_ARITHMETIC_FACTOR);
-            if (token->tokenType == TOKEN_OPERATOR) {
-                if (strcmp(token->content, "*") == 0
-                    || strcmp(token->content, "/") == 0
-                    || strcmp(token->content, "%") == 0) {
-                    astArithmeticItemMore->arithmeticItemMore = (AstArithmeticItemMore *) pccMalloc(SYNTAX_TAG,
-                                                                                                    sizeof(AstArithmeticItemMore));
-                    token = travelAst(token, astArithmeticItemMore->arithmeticItemMore,
-                                      NODE_ARITHMETIC_ITEM_MORE);
-                } else {
-                    astArithmeticItemMore->arithmeticItemMore = nullptr;
-                }
-            } else {
-                astArithmeticItemMore->arithmeticItemMore = nullptr;
-            }
+            token = parseArithmeticExpression(token, (AstExpressionArithmetic *) currentNode);
             break;
         }
         case NODE_ARITHMETIC_FACTOR: {
             AstArithmeticFactor *astArithmeticFactor = (AstArithmeticFactor *) currentNode;
             if (token->tokenType == TOKEN_IDENTIFIER) {
-                if (token->next->tokenType == TOKEN_BOUNDARY && strcmp(token->next->content, "(") == 0) {
+                if ((token + 1)->kind == KIND_LEFT_PAREN) {
                     //method return val
-                    if (hasMethodDefine(token->content)) {
+                    if (findCalledFunction(token) != nullptr) {
                         astArithmeticFactor->factorType = ARITHMETIC_METHOD_RET;
-                        astArithmeticFactor->methodCall = (AstStatementMethodCall *) pccMalloc(SYNTAX_TAG,
-                                                                                               sizeof(AstStatementMethodCall));
+                        astArithmeticFactor->methodCall = newAstNode<AstStatementMethodCall>();
                         token = travelAst(token, astArithmeticFactor->methodCall, NODE_STATEMENT_METHOD_CALL);
                         //do not consume method call's ;
                     } else {
-                        loge(SYNTAX_TAG, "[-]error: undefined method: %s", token->content);
+                        logTokenError(token, "undefined method");
                         exit(-1);
                     }
                 } else {
-                    if (hasVarDefine(token->content)) {
+                    if (findSymbol(varTable, token->content) != nullptr) {
                         astArithmeticFactor->factorType = ARITHMETIC_IDENTITY;
-                        astArithmeticFactor->identity = (AstIdentity *) pccMalloc(SYNTAX_TAG, sizeof(AstIdentity));
-                        astArithmeticFactor->identity->name = token->content;
+                        astArithmeticFactor->identity = newAstNode<AstIdentity>();
+                        astArithmeticFactor->identity->name = getVarName(token);
                         //consume identifier
-                        token = token->next;
+                        token = consumeToken(token);
                     } else {
-                        loge(SYNTAX_TAG, "[-]error: undefined var: %s", token->content);
+                        logTokenError(token, "undefined var");
                         exit(-1);
                     }
                 }
             } else if (token->tokenType == TOKEN_INTEGER || token->tokenType == TOKEN_FLOAT) {
                 astArithmeticFactor->factorType = ARITHMETIC_PRIMITIVE;
-                astArithmeticFactor->primitiveData = (AstPrimitiveData *) pccMalloc(SYNTAX_TAG,
-                                                                                    sizeof(AstPrimitiveData));
+                astArithmeticFactor->primitiveData = newAstNode<AstPrimitiveData>();
                 token = travelAst(token, astArithmeticFactor->primitiveData, NODE_PRIMITIVE_DATA);
-            } else if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, "(") == 0) {
-                loge(SYNTAX_TAG, "[-]error: not impl yet: %s", token->content);
+            } else if (token->kind == KIND_LEFT_PAREN) {
+                logTokenError(token, "not impl yet");
                 exit(-1);
-            } else if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, "{") == 0) {
+            } else if (token->kind == KIND_LEFT_BRACE) {
                 //array, consume {
-                token = token->next;
+                token = consumeToken(token);
                 astArithmeticFactor->factorType = ARITHMETIC_ARRAY;
-                astArithmeticFactor->array = (AstArrayData *) pccMalloc(SYNTAX_TAG, sizeof(AstArrayData));
+                astArithmeticFactor->array = newAstNode<AstArrayData>();
                 token = travelAst(token, astArithmeticFactor->array, NODE_ARRAY_DATA);
-                if (strcmp(token->content, "}") != 0) {
-                    loge(SYNTAX_TAG, "[-] array need \"}\" to finish");
+                if (token->kind != KIND_RIGHT_BRACE) {
+                    logTokenError(token, "array need \"}\" to finish");
                     exit(-1);
                 }
-                token = token->next;
+                token = consumeToken(token);
             } else if (token->tokenType == TOKEN_CHARS) {
                 astArithmeticFactor->factorType = ARITHMETIC_ARRAY;
-                astArithmeticFactor->array = (AstArrayData *) pccMalloc(SYNTAX_TAG, sizeof(AstArrayData));
+                astArithmeticFactor->array = newAstNode<AstArrayData>();
                 const char *contentData = token->content;
                 int contentLength = strlen(contentData);
                 AstArrayData *array = astArithmeticFactor->array;
@@ -793,35 +927,35 @@ Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
                     if (i == contentLength - 1) {
                         array->next = nullptr;
                     } else {
-                        array->next = (AstArrayData *) pccMalloc(SYNTAX_TAG, sizeof(AstArrayData));
+                        array->next = newAstNode<AstArrayData>();
                         array = array->next;
                     }
                 }
                 //consume this string
-                token = token->next;
+                token = consumeToken(token);
             } else if (token->tokenType == TOKEN_CHARS) {
                 astArithmeticFactor->factorType = ARITHMETIC_ARRAY;
                 // consume this point op
-                token = token->next;
-                astArithmeticFactor->identity = (AstIdentity *) pccMalloc(SYNTAX_TAG, sizeof(AstIdentity));
+                token = consumeToken(token);
+                astArithmeticFactor->identity = newAstNode<AstIdentity>();
                 astArithmeticFactor->identity->name = token->content;
-                token = token->next;
+                token = consumeToken(token);
                 exit(-1);
             } else if (token->tokenType == TOKEN_POINTER_OPERATOR) {
-                if (strcmp(token->content, "&") == 0) {
+                if (token->kind == KIND_AMPERSAND) {
                     //get address for identity
                     astArithmeticFactor->factorType = ARITHMETIC_ADR_P;
-                } else if (strcmp(token->content, "*") == 0) {
+                } else if (token->kind == KIND_STAR) {
                     //dereference from address
                     astArithmeticFactor->factorType = ARITHMETIC_DREF_P;
                 }
                 // consume this point op
-                token = token->next;
-                astArithmeticFactor->identity = (AstIdentity *) pccMalloc(SYNTAX_TAG, sizeof(AstIdentity));
-                astArithmeticFactor->identity->name = token->content;
-                token = token->next;
+                token = consumeToken(token);
+                astArithmeticFactor->identity = newAstNode<AstIdentity>();
+                astArithmeticFactor->identity->name = getVarName(token);
+                token = consumeToken(token);
             } else {
-                loge(SYNTAX_TAG, "[-]error: except valid identifier or num: %s", token->content);
+                logTokenError(token, "except valid identifier or num");
                 exit(-1);
             }
             break;
@@ -829,10 +963,10 @@ Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
         case NODE_ARRAY_DATA: {
             AstArrayData *astArrayData = (AstArrayData *) currentNode;
             token = travelAst(token, &astArrayData->data, NODE_PRIMITIVE_DATA);
-            if (strcmp(token->content, ",") == 0) {
+            if (token->kind == KIND_COMMA) {
                 //consume ,
-                token = token->next;
-                astArrayData->next = (AstArrayData *) pccMalloc(SYNTAX_TAG, sizeof(AstArrayData));
+                token = consumeToken(token);
+                astArrayData->next = newAstNode<AstArrayData>();
                 token = travelAst(token, astArrayData->next, NODE_ARRAY_DATA);
             } else {
                 astArrayData->next = nullptr;
@@ -846,7 +980,7 @@ Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
             if (token->tokenType == TOKEN_INTEGER) {
                 long num = strtol(token->content, &consumedCharsPtr, 10);
                 if (consumedCharsPtr == token->content) {
-                    loge(SYNTAX_TAG, "[-]error: can not convert int: %s", token->content);
+                    logTokenError(token, "can not convert int");
                     exit(-1);
                 }
                 if (num <= CHAR_MAX) {
@@ -866,13 +1000,13 @@ Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
                     astPrimitiveData->type.primitiveType = TYPE_LONG;
                     astPrimitiveData->dataChar = (long) num;
                 } else {
-                    loge(SYNTAX_TAG, "[-]error: int out of range: %s", token->content);
+                    logTokenError(token, "int out of range");
                     exit(-1);
                 }
             } else if (token->tokenType == TOKEN_FLOAT) {
                 double num = strtod(token->content, &consumedCharsPtr);
                 if (consumedCharsPtr == token->content) {
-                    loge(SYNTAX_TAG, "[-]error: can not convert int: %s", token->content);
+                    logTokenError(token, "can not convert int");
                     exit(-1);
                 }
                 //todo: pass the float width to here.
@@ -887,136 +1021,105 @@ Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
                 }
             }
             //consume integer or float
-            token = token->next;
+            token = consumeToken(token);
             break;
         }
         case NODE_STATEMENT_METHOD_CALL: {
             AstStatementMethodCall *astStatementMethodCall = (AstStatementMethodCall *) currentNode;
-            astStatementMethodCall->identity = (AstIdentity *) pccMalloc(SYNTAX_TAG, sizeof(AstIdentity));
+            astStatementMethodCall->identity = newAstNode<AstIdentity>();
             astStatementMethodCall->identity->name = token->content;
-            token = token->next;
+            token = consumeToken(token);
             //fill method call ret type
-            AstMethodDefine *methodDefine = getMethodDefine(astStatementMethodCall->identity->name);
-            if (methodDefine == nullptr) {
-                loge(SYNTAX_TAG, "can not found method define when call method:%s",
-                     astStatementMethodCall->identity->name);
+            FunctionInfo *function = findFunction(astStatementMethodCall->identity->name);
+            if (function == nullptr) {
+                logTokenError(token - 1, "can not found method define when call method");
                 exit(1);
             }
-            astStatementMethodCall->retType = methodDefine->type;
+            function->callCount.fetch_add(1, std::memory_order_relaxed);
+            astStatementMethodCall->retType = function->define->type;
             //check next token
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, "(") != 0) {
-                loge(SYNTAX_TAG, "[-]error: method call need (: %s", token->content);
+            if (token->kind != KIND_LEFT_PAREN) {
+                logTokenError(token, "method call need (");
             }
             //consume (
-            token = token->next;
-            if (token->tokenType == TOKEN_BOUNDARY && strcmp(token->content, ")") == 0) {
+            token = consumeToken(token);
+            if (token->kind == KIND_RIGHT_PAREN) {
                 astStatementMethodCall->objectList = nullptr;
             } else {
-                astStatementMethodCall->objectList = (AstObjectList *) pccMalloc(SYNTAX_TAG,
-                                                                                 sizeof(AstObjectList));
+                astStatementMethodCall->objectList = newAstNode<AstObjectList>();
                 token = travelAst(token, astStatementMethodCall->objectList,
                                   NODE_OBJECT_LIST);
             }
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ")") != 0) {
-                loge(SYNTAX_TAG, "[-]error: method call need ): %s", token->content);
+            if (token->kind != KIND_RIGHT_PAREN) {
+                logTokenError(token, "method call need )");
             }
             //consume )
-            token = token->next;
-            if (token->tokenType != TOKEN_BOUNDARY || strcmp(token->content, ";") != 0) {
-                loge(SYNTAX_TAG, "[-]error: method call need ;: %s", token->content);
+            token = consumeToken(token);
+            if (token->kind != KIND_SEMICOLON) {
+                logTokenError(token, "method call need ;");
             }
             //fixme: method call is not a statement, it is a expression
             //DO NOT consume ;
             break;
         }
         case NODE_EXPRESSION_BOOL: {
-            AstExpressionBool *astExpressionBool = (AstExpressionBool *) currentNode;
-            astExpressionBool->boolItem = (AstBoolItem *) pccMalloc(SYNTAX_TAG, sizeof(AstBoolItem));
-            token = travelAst(token, astExpressionBool->boolItem, NODE_BOOL_ITEM);
-            if (token->tokenType == TOKEN_BOOL && strcmp(token->content, "||") == 0) {
-                //must be ||
-                astExpressionBool->next = (AstExpressionBool *) pccMalloc(SYNTAX_TAG, sizeof(AstExpressionBool));
-                token = travelAst(token, astExpressionBool->next, NODE_EXPRESSION_BOOL);
-            } else {
-                astExpressionBool->next = nullptr;
-            }
-            break;
-        }
-        case NODE_BOOL_ITEM: {
-            AstBoolItem *astBoolItem = (AstBoolItem *) currentNode;
-            astBoolItem->boolFactor = (AstBoolFactor *) pccMalloc(SYNTAX_TAG, sizeof(AstBoolFactor));
-            token = travelAst(token, astBoolItem->boolFactor, NODE_BOOL_FACTOR);
-            if (token->tokenType == TOKEN_BOOL && strcmp(token->content, "&&") == 0) {
-                // must be &&
-                astBoolItem->next = (AstBoolItem *) pccMalloc(SYNTAX_TAG, sizeof(AstBoolItem));
-                token = travelAst(token, astBoolItem->next, NODE_BOOL_ITEM);
-            } else {
-                astBoolItem->next = nullptr;
-            }
+            token = parseBoolExpression(token, (AstExpressionBool *) currentNode);
             break;
         }
         case NODE_BOOL_FACTOR: {
             AstBoolFactor *astBoolFactor = (AstBoolFactor *) currentNode;
-            if (strcmp(token->content, "!") == 0) {
+            //a run of ! is a chain of inverts, built in a loop
+            while (token->kind == KIND_NOT) {
                 astBoolFactor->boolFactorType = BOOL_FACTOR_INVERT;
-                astBoolFactor->invertBoolFactor = (AstBoolFactorInvert *) pccMalloc(SYNTAX_TAG,
-                                                                                    sizeof(AstBoolFactorInvert));
-                token = travelAst(token, astBoolFactor->invertBoolFactor, NODE_BOOL_FACTOR_INVERT);
-            } else {
-                astBoolFactor->boolFactorType = BOOL_FACTOR_RELATION;
-                astBoolFactor->arithmeticBoolFactor = (AstBoolFactorCompareArithmetic *) pccMalloc(SYNTAX_TAG,
-                                                                                                   sizeof(AstBoolFactorCompareArithmetic));
-                token = travelAst(token, astBoolFactor->arithmeticBoolFactor,
-                                  NODE_BOOL_FACTOR_COMPARE_ARITHMETIC);
-            }
-            break;
-        }
-        case NODE_BOOL_FACTOR_INVERT: {
-            AstBoolFactorInvert *astBoolFactorInvert = (AstBoolFactorInvert *) currentNode;
-            if (token->tokenType != TOKEN_OPERATOR || strcmp(token->content, "!") != 0) {
-                loge(SYNTAX_TAG, "[-]error: need ;: %s", token->content);
-                exit(-1);
+                astBoolFactor->invertBoolFactor = newAstNode<AstBoolFactorInvert>();
+                //consume !
+                token = consumeToken(token);
+                AstBoolFactorInvert *astBoolFactorInvert = astBoolFactor->invertBoolFactor;
+                astBoolFactorInvert->boolFactor = newAstNode<AstBoolFactor>();
+                astBoolFactor = astBoolFactorInvert->boolFactor;
             }
-            //consume !
-            token = token->next;
-            astBoolFactorInvert->boolFactor = (AstBoolFactor *) pccMalloc(SYNTAX_TAG, sizeof(AstBoolFactor));
-            token = travelAst(token, astBoolFactorInvert->boolFactor, NODE_BOOL_FACTOR);
+            astBoolFactor->boolFactorType = BOOL_FACTOR_RELATION;
+            astBoolFactor->arithmeticBoolFactor = newAstNode<AstBoolFactorCompareArithmetic>();
+            token = travelAst(token, astBoolFactor->arithmeticBoolFactor, NODE_BOOL_FACTOR_COMPARE_ARITHMETIC);
             break;
         }
         case NODE_BOOL_FACTOR_COMPARE_ARITHMETIC: {
             AstBoolFactorCompareArithmetic *astBoolFactorCompareArithmetic = (AstBoolFactorCompareArithmetic *) currentNode;
-            astBoolFactorCompareArithmetic->firstArithmeticExpression = (AstExpressionArithmetic *) pccMalloc(
-                    SYNTAX_TAG,
-                    sizeof(AstExpressionArithmetic));
+            astBoolFactorCompareArithmetic->firstArithmeticExpression = newAstNode<AstExpressionArithmetic>();
             token = travelAst(token, astBoolFactorCompareArithmetic->firstArithmeticExpression,
                               NODE_EXPRESSION_ARITHMETIC);
 
             if (token->tokenType != TOKEN_OPERATOR && token->tokenType != TOKEN_OPERATOR_2) {
-                loge(SYNTAX_TAG, "[-]error: need relation operator: %s", token->content);
+                logTokenError(token, "need relation operator");
                 exit(-1);
             }
-            if (strcmp(token->content, "==") == 0) {
-                astBoolFactorCompareArithmetic->relationOperation = RELATION_EQ;
-            } else if (strcmp(token->content, "!=") == 0) {
-                astBoolFactorCompareArithmetic->relationOperation = RELATION_NOT_EQ;
-            } else if (strcmp(token->content, ">") == 0) {
-                astBoolFactorCompareArithmetic->relationOperation = RELATION_GREATER;
-            } else if (strcmp(token->content, ">=") == 0) {
-                astBoolFactorCompareArithmetic->relationOperation = RELATION_GREATER_EQ;
-            } else if (strcmp(token->content, "<") == 0) {
-                astBoolFactorCompareArithmetic->relationOperation = RELATION_LESS;
-            } else if (strcmp(token->content, "<=") == 0) {
-                astBoolFactorCompareArithmetic->relationOperation = RELATION_LESS_EQ;
-            } else {
-                loge(SYNTAX_TAG, "[-]error: unknown relation operator: %s", token->content);
-                exit(-1);
+            switch (token->kind) {
+                case KIND_EQUAL:
+                    astBoolFactorCompareArithmetic->relationOperation = RELATION_EQ;
+                    break;
+                case KIND_NOT_EQUAL:
+                    astBoolFactorCompareArithmetic->relationOperation = RELATION_NOT_EQ;
+                    break;
+                case KIND_GREATER:
+                    astBoolFactorCompareArithmetic->relationOperation = RELATION_GREATER;
+                    break;
+                case KIND_GREATER_EQUAL:
+                    astBoolFactorCompareArithmetic->relationOperation = RELATION_GREATER_EQ;
+                    break;
+                case KIND_LESS:
+                    astBoolFactorCompareArithmetic->relationOperation = RELATION_LESS;
+                    break;
+                case KIND_LESS_EQUAL:
+                    astBoolFactorCompareArithmetic->relationOperation = RELATION_LESS_EQ;
+                    break;
+                default:
+                    logTokenError(token, "unknown relation operator");
+                    exit(-1);
             }
             //consume relation op
-            token = token->next;
+            token = consumeToken(token);
 
-            astBoolFactorCompareArithmetic->secondArithmeticExpression = (AstExpressionArithmetic *) pccMalloc(
-                    SYNTAX_TAG,
-                    sizeof(AstExpressionArithmetic));
+            astBoolFactorCompareArithmetic->secondArithmeticExpression = newAstNode<AstExpressionArithmetic>();
             token = travelAst(token, astBoolFactorCompareArithmetic->secondArithmeticExpression,
                               NODE_EXPRESSION_ARITHMETIC);
             break;
@@ -1025,16 +1128,143 @@ Token *travelAst(Token *token, void *currentNode, AstNodeType nodeType) {
     return token;
 }
 
-AstProgram *buildAst(Token *token) {
+/**
+ * state of a parse on the calling thread, the program node comes first.
+ */
+static AstProgram *beginParse(TokenStream *tokens) {
     logd(SYNTAX_TAG, "syntax analysis...");
-    AstProgram *program = (AstProgram *) pccMalloc(SYNTAX_TAG, sizeof(AstProgram));
-    if (token != nullptr && token->tokenType == TOKEN_HEAD) {
-        token = token->next;
+    threadSpace = syntaxSpace;
+    AstProgram *program = newAstNode<AstProgram>();
+    tokenStream = tokens;
+    //the table of an earlier parse went with its space
+    varTable = createSymbolTable(syntaxSpace);
+    initFunctionRegistry();
+    return program;
+}
+
+static void endParse(const SymbolTableStat *varStat) {
+    retireAstCursors();
+    logd(SYNTAX_TAG, "var lookups: %llu, %.2f probes per lookup", (unsigned long long) varStat->lookups,
+         varStat->lookups == 0 ? 0.0 : (double) varStat->probes / varStat->lookups);
+    FunctionRegistryStat functionStat;
+    getFunctionRegistryStat(&functionStat);
+    logd(SYNTAX_TAG, "functions: %u, %u extern, %llu calls: %llu lookups, %.2f probes per lookup",
+         functionStat.functionCount, functionStat.externCount, (unsigned long long) functionStat.callCount,
+         (unsigned long long) functionStat.lookups,
+         functionStat.lookups == 0 ? 0.0 : (double) functionStat.probes / functionStat.lookups);
+    AstMemoryStat memoryStat;
+    getAstMemoryStat(&memoryStat);
+    logd(SYNTAX_TAG, "ast nodes: %llu, %llu bytes in %llu bytes of chunks", (unsigned long long) memoryStat.nodeCount,
+         (unsigned long long) memoryStat.nodeBytes, (unsigned long long) memoryStat.chunkBytes);
+}
+
+AstProgram *buildAst(TokenStream *tokens) {
+    AstProgram *program = beginParse(tokens);
+    travelAst(tokens->window, program, NODE_PROGRAM);
+    SymbolTableStat varStat;
+    getSymbolTableStat(varTable, &varStat);
+    endParse(&varStat);
+    return program;
+}
+
+/**
+ * take deferred bodies in turn until none is left. the params are declared again in the thread's table,
+ * in the same order, so the body sees the scope the serial parser gives it.
+ */
+static void parseDeferredBodies(std::atomic<uint32_t> *nextBody, SymbolTableStat *varStat) {
+    for (;;) {
+        uint32_t index = nextBody->fetch_add(1, std::memory_order_relaxed);
+        if (index >= deferredBodyCount) {
+            break;
+        }
+        const DeferredBody *body = &deferredBodies[index];
+        beginMethodScope(varTable);
+        visibleFunctionCount = body->visibleFunctionCount;
+        for (AstParamList *param = body->define->paramList; param != nullptr; param = param->next) {
+            AstIdentity *identity = param->paramDefine->identity;
+            declareSymbol(varTable, identity->name, identity);
+        }
+        travelAst(body->token, body->define->statementBlock, NODE_STATEMENT_BLOCK);
+    }
+    getSymbolTableStat(varTable, varStat);
+}
+
+static void runParseWorker(MemSpace *space, std::atomic<uint32_t> *nextBody, SymbolTableStat *varStat) {
+    threadSpace = space;
+    varTable = createSymbolTable(space);
+    parseDeferredBodies(nextBody, varStat);
+    retireAstCursors();
+}
+
+AstProgram *buildAstParallel(TokenStream *tokens, uint32_t jobCount) {
+    if (!tokens->ended) {
+        loge(SYNTAX_TAG, "[-]error: the parallel parser needs every token up front");
+        exit(-1);
+    }
+    AstProgram *program = beginParse(tokens);
+    deferredBodies = nullptr;
+    deferredBodyCount = 0;
+    deferredBodyCapacity = 0;
+    deferringBodies = true;
+    travelAst(tokens->window, program, NODE_PROGRAM);
+    deferringBodies = false;
+    logd(SYNTAX_TAG, "%u method bodies on %u threads", deferredBodyCount, jobCount);
+
+    //thread 0 is the calling one, it parses too
+    MemSpace **spaces = pccNewArray<MemSpace *>(syntaxSpace, jobCount);
+    SymbolTableStat *varStats = pccNewArray<SymbolTableStat>(syntaxSpace, jobCount);
+    std::atomic<uint32_t> nextBody(0);
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; i < jobCount; i++) {
+        spaces[i] = pccForkSpace(syntaxSpace);
+        workers.emplace_back(runParseWorker, spaces[i], &nextBody, &varStats[i]);
     }
-    travelAst(token, program, NODE_PROGRAM);
+    parseDeferredBodies(&nextBody, &varStats[0]);
+    for (uint32_t i = 1; i < jobCount; i++) {
+        workers[i - 1].join();
+        pccMergeSpace(syntaxSpace, spaces[i]);
+    }
+    SymbolTableStat varStat = {};
+    for (uint32_t i = 0; i < jobCount; i++) {
+        varStat.lookups += varStats[i].lookups;
+        varStat.probes += varStats[i].probes;
+    }
+    endParse(&varStat);
     return program;
 }
 
+template<typename T>
+static void addArenaStat(const AstArena<T> &arena, AstMemoryStat *stat) {
+    stat->nodeCount += arena.nodeCount;
+    stat->nodeBytes += arena.nodeCount * sizeof(T);
+    stat->chunkBytes += (uint64_t) arena.chunkCount * AST_CHUNK_SIZE * sizeof(T);
+}
+
+void getAstMemoryStat(AstMemoryStat *stat) {
+    *stat = {0, 0, 0};
+#define ADD_ARENA_STAT(type) addArenaStat(astArena<type>, stat);
+    PCC_AST_NODE_TYPES(ADD_ARENA_STAT)
+#undef ADD_ARENA_STAT
+}
+
+template<typename T>
+static void resetAstArena(AstArena<T> &arena) {
+    arena.chunks.store(nullptr, std::memory_order_relaxed);
+    arena.chunkCapacity = 0;
+    arena.chunkCount = 0;
+    arena.nodeCount = 0;
+}
+
 void releaseAstMemory() {
-    pccFreeSpace(SYNTAX_TAG);
+#define RESET_ARENA(type) resetAstArena(astArena<type>); astCursor<type> = {0, 0, 0};
+    PCC_AST_NODE_TYPES(RESET_ARENA)
+#undef RESET_ARENA
+#define RESET_CHAIN_STACK(type) chainStack<type> = {nullptr, 0, 0};
+    RESET_CHAIN_STACK(AstArithmeticFactor) RESET_CHAIN_STACK(AstArithmeticItem)
+    RESET_CHAIN_STACK(AstBoolFactor) RESET_CHAIN_STACK(AstBoolItem)
+#undef RESET_CHAIN_STACK
+    deferredBodies = nullptr;
+    deferredBodyCount = 0;
+    deferredBodyCapacity = 0;
+    pccResetSpace(syntaxSpace);
 }
\ No newline at end of file
@@ -8,7 +8,30 @@
 #include "ast.h"
 #include "token.h"
 
-AstProgram *buildAst(Token *token);
+/**
+ * parse while pulling tokens from the stream, the parser looks at most one token ahead.
+ */
+AstProgram *buildAst(TokenStream *tokens);
+
+/**
+ * the same tree as buildAst on jobCount threads: signatures are parsed in order and every method body is
+ * skipped by brace matching, then the bodies are parsed by whichever thread is free. the stream must hold
+ * every token (openTokenListStream), the threads read it at once.
+ */
+AstProgram *buildAstParallel(TokenStream *tokens, uint32_t jobCount);
+
+struct AstMemoryStat {
+    uint64_t nodeCount;
+    //bytes of the node records
+    uint64_t nodeBytes;
+    //bytes of the chunks, the tail of the last chunk of every type is still unused
+    uint64_t chunkBytes;
+};
+
+/**
+ * what the nodes of the last buildAst take, summed over the arenas of all node types.
+ */
+void getAstMemoryStat(AstMemoryStat *stat);
 
 void releaseAstMemory();
 
@@ -5,8 +5,10 @@
 #ifndef PCC_CC_TOKEN_H
 #define PCC_CC_TOKEN_H
 
-enum TokenType {
-    TOKEN_HEAD,
+#include <stdint.h>
+
+enum TokenType : uint8_t {
+    TOKEN_END,//closes the token array
     TOKEN_BOUNDARY,
     TOKEN_OPERATOR,
     TOKEN_OPERATOR_2,
@@ -23,10 +25,133 @@ enum TokenType {
     TOKEN_IDENTIFIER
 };
 
+/**
+ * the reserved words, a new keyword or type name is one line here: its TokenKind, the lexer's perfect hash and
+ * the parser's primitive type all come from these lists (keyword.h).
+ * X(kind, spelling) for keywords, X(kind, spelling, primitive type) for type names.
+ */
+#define PCC_KEYWORDS(X) \
+    X(KIND_IF, "if") \
+    X(KIND_ELSE, "else") \
+    X(KIND_FOR, "for") \
+    X(KIND_WHILE, "while") \
+    X(KIND_RETURN, "return") \
+    X(KIND_EXTERN, "extern")
+
+#define PCC_TYPE_NAMES(X) \
+    X(KIND_VOID, "void", TYPE_VOID) \
+    X(KIND_CHAR, "char", TYPE_CHAR) \
+    X(KIND_INT, "int", TYPE_INT) \
+    X(KIND_SHORT, "short", TYPE_SHORT) \
+    X(KIND_LONG, "long", TYPE_LONG) \
+    X(KIND_FLOAT, "float", TYPE_FLOAT) \
+    X(KIND_DOUBLE, "double", TYPE_DOUBLE)
+
+#define PCC_WORD_KIND(kind, ...) kind,
+
+/**
+ * which keyword, type, punctuator or operator a token is, the parser switches on it instead of comparing spellings.
+ * the reserved words come first, in the order of their lists.
+ */
+enum TokenKind : uint8_t {
+    //identifiers, literals and the end token
+    KIND_NONE,
+
+    PCC_KEYWORDS(PCC_WORD_KIND)
+    PCC_TYPE_NAMES(PCC_WORD_KIND)
+
+    KIND_LEFT_BRACKET,
+    KIND_RIGHT_BRACKET,
+    KIND_LEFT_BRACE,
+    KIND_RIGHT_BRACE,
+    KIND_LEFT_PAREN,
+    KIND_RIGHT_PAREN,
+    KIND_COMMA,
+    KIND_SEMICOLON,
+
+    KIND_ASSIGN,
+    KIND_PLUS,
+    KIND_MINUS,
+    KIND_STAR,
+    KIND_SLASH,
+    KIND_PERCENT,
+    KIND_LESS,
+    KIND_GREATER,
+    KIND_NOT,
+    KIND_AMPERSAND,
+
+    KIND_EQUAL,
+    KIND_NOT_EQUAL,
+    KIND_LESS_EQUAL,
+    KIND_GREATER_EQUAL,
+    KIND_PLUS_ASSIGN,
+    KIND_MINUS_ASSIGN,
+    KIND_SLASH_ASSIGN,
+    KIND_PERCENT_ASSIGN,
+    KIND_AND,
+    KIND_OR,
+};
+
 struct Token {
-    TokenType tokenType;
     const char *content;
-    Token *next;
+    //1 based
+    uint32_t line;
+    //1 based, the column counts bytes of the preprocessed line, longer lines stop at UINT16_MAX
+    uint16_t column;
+    TokenType tokenType;
+    TokenKind kind;
+};
+
+//a 1m line source has millions of tokens, the file of a token is in TokenFiles instead
+static_assert(sizeof(Token) == 16, "Token is padded");
+
+struct TokenFileRun {
+    uint32_t firstToken;
+    //index into TokenFiles::names
+    uint32_t fileIndex;
+};
+
+/**
+ * the file names of a token list or stream, tokens of one file come in runs: an include starts one, its end
+ * starts another. a run lasts until the first token of the next one, getTokenFileName (lexer.h) finds it.
+ */
+struct TokenFiles {
+    const char **names;
+    uint32_t nameCount;
+    TokenFileRun *runs;
+    uint32_t runCount;
+    uint32_t runCapacity;
+};
+
+/**
+ * every token of a translation unit in one array, the token after the last one is a TOKEN_END,
+ * so the parser can always look one token ahead.
+ */
+struct TokenList {
+    Token *tokens;
+    //without the end token
+    uint32_t count;
+    TokenFiles files;
+};
+
+struct TokenStreamSource;
+
+/**
+ * the tokens of a translation unit pulled from the lexer a window at a time, only the window is in memory.
+ * the parser walks the window with pointers, advanceTokenStream (lexer.h) slides it along.
+ */
+struct TokenStream {
+    Token *window;
+    //one past the last token in the window
+    Token *end;
+    //the end token is in the window, nothing is left to lex
+    bool ended;
+    //index of window[0] among all tokens of the stream
+    uint32_t windowStart;
+    TokenFiles files;
+    //log every token as it is lexed
+    bool printTokens;
+    TokenStreamSource *source;
 };
 
 #endif //PCC_CC_TOKEN_H
@@ -8,6 +8,11 @@
 #include <stdarg.h>
 #include <cstdlib>
 #include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "logger.h"
 
 static const char *FILE_TAG = "file";
@@ -27,70 +32,252 @@ uint64_t alignDownTo(uint64_t value, uint64_t alignment) {
     return value - remainder; // 向下对齐
 }
 
-static FILE *targetFile = nullptr;
-static volatile uint32_t fileOffset = 0;
+/**
+ * the whole output image is built in memory, wrappers write into it by offset.
+ * OUTPUT_BUFFERED: heap buffer, reaches the disk with a single write at closeFile.
+ * OUTPUT_MMAP: the file itself is ftruncate-d and mapped, payloads are copied straight into place
+ * and padding is never written at all.
+ */
+struct OutputImage {
+    int fd;
+    FileOutputMode mode;
+    char *buffer;
+    size_t capacity;
+    //bytes written so far, the file size
+    size_t size;
+    //append position
+    size_t offset;
+};
+
+//64KB, enough for most programs without growing
+#define IMAGE_INIT_CAPACITY 65536
+
+static FileOutputMode outputMode = OUTPUT_BUFFERED;
+
+static OutputImage outputImage = {-1, OUTPUT_BUFFERED, nullptr, 0, 0, 0};
+
+void setFileOutputMode(FileOutputMode mode) {
+    outputMode = mode;
+}
+
+static void mapImage(size_t capacity) {
+    //the extended range of the file reads as zero
+    if (ftruncate(outputImage.fd, capacity) != 0) {
+        loge(FILE_TAG, "ftruncate output failed: %s", strerror(errno));
+        exit(-1);
+    }
+    if (outputImage.buffer != nullptr) {
+        munmap(outputImage.buffer, outputImage.capacity);
+    }
+    void *buffer = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, outputImage.fd, 0);
+    if (buffer == MAP_FAILED) {
+        loge(FILE_TAG, "mmap output failed: %s", strerror(errno));
+        exit(-1);
+    }
+    outputImage.buffer = (char *) buffer;
+    outputImage.capacity = capacity;
+}
+
+static void ensureImageCapacity(size_t required) {
+    if (required <= outputImage.capacity) {
+        return;
+    }
+    size_t capacity = outputImage.capacity == 0 ? IMAGE_INIT_CAPACITY : outputImage.capacity;
+    while (capacity < required) {
+        capacity *= 2;
+    }
+    if (outputImage.mode == OUTPUT_MMAP) {
+        mapImage(capacity);
+        return;
+    }
+    char *buffer = (char *) realloc(outputImage.buffer, capacity);
+    if (buffer == nullptr) {
+        loge(FILE_TAG, "out of memory: output image size=%zu", capacity);
+        exit(-1);
+    }
+    //gaps left by alignment or reserve must read as zero
+    memset(buffer + outputImage.capacity, 0, capacity - outputImage.capacity);
+    outputImage.buffer = buffer;
+    outputImage.capacity = capacity;
+}
 
 void openFile(const char *fileName) {
-    if (targetFile != nullptr) {
+    if (outputImage.fd >= 0) {
         loge(FILE_TAG, "current file is not closed.");
         return;
     }
-    FILE *file = fopen(fileName, "w+b");
-    if (file == nullptr) {
+    //a shared mapping needs read access too
+    int flags = (outputMode == OUTPUT_MMAP ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+    int fd = open(fileName, flags, 0666);
+    if (fd < 0) {
         loge(FILE_TAG, "Failed to open file");
-        targetFile = nullptr;
         return;
     }
-    targetFile = file;
-    fileOffset = 0;
+    outputImage.fd = fd;
+    outputImage.mode = outputMode;
+    outputImage.size = 0;
+    outputImage.offset = 0;
+    if (outputImage.mode == OUTPUT_BUFFERED) {
+        ensureImageCapacity(IMAGE_INIT_CAPACITY);
+    }
+}
+
+void presizeFile(uint64_t sizeInByte) {
+    if (outputImage.fd < 0 || sizeInByte <= outputImage.capacity) {
+        return;
+    }
+    if (outputImage.mode == OUTPUT_MMAP) {
+        mapImage(sizeInByte);
+    } else {
+        ensureImageCapacity(sizeInByte);
+    }
+}
+
+void writeFileAt(uint64_t offset, const void *ptr, size_t sizeInByte) {
+    if (outputImage.fd < 0) {
+        loge(FILE_TAG, "internal error: no file is open.(patch)\n");
+        return;
+    }
+    ensureImageCapacity(offset + sizeInByte);
+    memcpy(outputImage.buffer + offset, ptr, sizeInByte);
+    if (offset + sizeInByte > outputImage.size) {
+        outputImage.size = offset + sizeInByte;
+    }
 }
 
 void writeFile(const char *format, ...) {
-    if (targetFile == nullptr) {
+    if (outputImage.fd < 0) {
         loge(FILE_TAG, "internal error: no file is open.(text)\n");
         return;
     }
     va_list args;
     va_start(args, format);
-    vfprintf(targetFile, format, args);
+    int length = vsnprintf(nullptr, 0, format, args);
+    va_end(args);
+    if (length <= 0) {
+        return;
+    }
+    //vsnprintf always writes the terminator
+    ensureImageCapacity(outputImage.offset + length + 1);
+    va_start(args, format);
+    vsnprintf(outputImage.buffer + outputImage.offset, length + 1, format, args);
     va_end(args);
-    fflush(targetFile);
+    outputImage.buffer[outputImage.offset + length] = 0;
+    outputImage.offset += length;
+    if (outputImage.offset > outputImage.size) {
+        outputImage.size = outputImage.offset;
+    }
 }
 
 void writeFileB(const void *ptr, size_t sizeInByte) {
-    if (targetFile == nullptr) {
+    if (outputImage.fd < 0) {
         loge(FILE_TAG, "internal error: no file is open.(binary)\n");
         return;
     }
-    fwrite(ptr, 1, sizeInByte, targetFile);
-    fflush(targetFile);
-    fileOffset += sizeInByte;
+    writeFileAt(outputImage.offset, ptr, sizeInByte);
+    outputImage.offset += sizeInByte;
+}
+
+uint64_t reserveFile(size_t sizeInByte) {
+    uint64_t offset = outputImage.offset;
+    ensureImageCapacity(offset + sizeInByte);
+    outputImage.offset += sizeInByte;
+    if (outputImage.offset > outputImage.size) {
+        outputImage.size = outputImage.offset;
+    }
+    return offset;
 }
 
-uint32_t getCurrentFileOffset() {
-    return fileOffset;
+uint64_t getCurrentFileOffset() {
+    return outputImage.offset;
 }
 
 void writeEmptyAlignment(uint32_t alignment) {
-    int targetOffset = alignTo(fileOffset, alignment);
-    int fillByte = targetOffset - fileOffset;
-    if (fillByte == 0) {
+    uint64_t targetOffset = alignTo(outputImage.offset, alignment);
+    if (targetOffset == outputImage.offset) {
         return;
     }
-    char *emptyData = (char *) malloc(fillByte);
-    memset(emptyData, 0, fillByte);
-    writeFileB(emptyData, fillByte);
-    if (targetOffset != fileOffset) {
-        loge(FILE_TAG, "can not fill empty to alignment:%d: %d->%d", alignment, fileOffset, targetOffset);
-        exit(-1);
-    }
+    //the image is zero filled, skipping is enough
+    reserveFile(targetOffset - outputImage.offset);
 }
 
 void closeFile() {
-    if (targetFile == nullptr) {
+    if (outputImage.fd < 0) {
         loge(FILE_TAG, "internal error: no file is open, can't close.\n");
         return;
     }
-    fclose(targetFile);
-    targetFile = nullptr;
-}
\ No newline at end of file
+    if (outputImage.mode == OUTPUT_MMAP) {
+        if (outputImage.buffer != nullptr) {
+            munmap(outputImage.buffer, outputImage.capacity);
+        }
+        //drop the unused tail of the mapping
+        if (ftruncate(outputImage.fd, outputImage.size) != 0) {
+            loge(FILE_TAG, "ftruncate output failed: %s", strerror(errno));
+            exit(-1);
+        }
+        close(outputImage.fd);
+        outputImage = {-1, OUTPUT_BUFFERED, nullptr, 0, 0, 0};
+        return;
+    }
+    size_t written = 0;
+    while (written < outputImage.size) {
+        ssize_t result = write(outputImage.fd, outputImage.buffer + written, outputImage.size - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            loge(FILE_TAG, "write output failed: %s", strerror(errno));
+            exit(-1);
+        }
+        written += result;
+    }
+    close(outputImage.fd);
+    free(outputImage.buffer);
+    outputImage = {-1, OUTPUT_BUFFERED, nullptr, 0, 0, 0};
+}
+
+bool mapInputFile(const char *path, MappedFile *mappedFile) {
+    mappedFile->data = nullptr;
+    mappedFile->size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        return false;
+    }
+    if (fileStat.st_size > 0) {
+        void *data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            loge(FILE_TAG, "mmap %s failed: %s", path, strerror(errno));
+            close(fd);
+            return false;
+        }
+        mappedFile->data = (const char *) data;
+        mappedFile->size = fileStat.st_size;
+    }
+    //the mapping stays valid after close
+    close(fd);
+    return true;
+}
+
+void unmapInputFile(MappedFile *mappedFile) {
+    if (mappedFile->data != nullptr) {
+        munmap((void *) mappedFile->data, mappedFile->size);
+    }
+    mappedFile->data = nullptr;
+    mappedFile->size = 0;
+}
+
+bool statInputFile(const char *path, FileIdentity *identity) {
+    struct stat fileStat;
+    if (stat(path, &fileStat) != 0 || !S_ISREG(fileStat.st_mode)) {
+        return false;
+    }
+    identity->device = fileStat.st_dev;
+    identity->inode = fileStat.st_ino;
+    identity->modifyTime = fileStat.st_mtime;
+    return true;
+}
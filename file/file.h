@@ -11,14 +11,73 @@
 uint64_t alignTo(uint64_t value, uint64_t alignment);
 uint64_t alignDownTo(uint64_t value, uint64_t alignment);
 
+enum FileOutputMode {
+    OUTPUT_BUFFERED,
+    OUTPUT_MMAP,
+};
+
+/**
+ * takes effect at the next openFile.
+ */
+extern void setFileOutputMode(FileOutputMode mode);
+
 extern void openFile(const char *fileName);
 
+/**
+ * hint the final file size once the layout is known, the image is grown (or the file truncated and mapped) once.
+ */
+extern void presizeFile(uint64_t sizeInByte);
+
 extern void writeFile(const char *format, ...);
 
 extern void writeFileB(const void *ptr, size_t sizeInByte);
 
+/**
+ * overwrite bytes already in the image, headers are patched this way once the layout is known.
+ */
+extern void writeFileAt(uint64_t offset, const void *ptr, size_t sizeInByte);
+
+/**
+ * skip sizeInByte zero bytes and return where they start.
+ */
+extern uint64_t reserveFile(size_t sizeInByte);
+
+extern uint64_t getCurrentFileOffset();
+
 void writeEmptyAlignment(uint32_t alignment);
 
+/**
+ * flush the whole image with one write.
+ */
 extern void closeFile();
 
+/**
+ * read only view of a whole input file.
+ */
+struct MappedFile {
+    const char *data;
+    size_t size;
+};
+
+/**
+ * map path read-only, false when it can not be opened. an empty file maps to data=nullptr, size=0.
+ */
+extern bool mapInputFile(const char *path, MappedFile *mappedFile);
+
+extern void unmapInputFile(MappedFile *mappedFile);
+
+/**
+ * identity of an input file, two paths naming the same unchanged file compare equal.
+ */
+struct FileIdentity {
+    uint64_t device;
+    uint64_t inode;
+    int64_t modifyTime;
+};
+
+/**
+ * stat a regular file, false when it does not exist or is not a regular file.
+ */
+extern bool statInputFile(const char *path, FileIdentity *identity);
+
 #endif //PCC_CC_FILE_H
@@ -13,9 +13,12 @@
 #include "linux_syscall.h"
 #include "mspace.h"
 #include "stack.h"
+#include "intern.h"
 
 #define ARM64_TAG "arm64_asm"
 
+static MemSpace *arm64Space = pccCreateSpace(ARM64_TAG);
+
 #define ARM_STACK_ALIGN 16
 #define ARM_BLOCK_32_ALIGN 4
 #define ARM_BLOCK_64_ALIGN 8
@@ -47,7 +50,7 @@ int alignStackSize(int reqSize) {
 //};
 //static StackVarListNode *currentStackVarListHead;
 
-static Stack *currentStackVarStack = createStack(ARM64_TAG);
+static Stack *currentStackVarStack = createStack(arm64Space);
 
 static inline void pushStackVar(StackVar *stackVar) {
     currentStackVarStack->push(currentStackVarStack, stackVar);
@@ -108,7 +111,7 @@ static const char *commonRegsVarName[COMMON_REG_SIZE];
  */
 int isVarExistInCommonReg(const char *varName) {
     for (int i = 0; i < COMMON_REG_SIZE; i++) {
-        if (commonRegsVarName[i] != nullptr && strcmp(commonRegsVarName[i], varName) == 0) {
+        if (commonRegsVarName[i] == varName) {
             return i;
         }
     }
@@ -120,7 +123,7 @@ bool isOperandEqualVarName(MirOperand *mirOperand, const char *varName) {
         return false;
     }
     if (mirOperand->type.primitiveType == OPERAND_IDENTITY) {
-        if (strcmp(mirOperand->identity, varName) == 0) {
+        if (mirOperand->identity == varName) {
             return true;
         }
     }
@@ -131,7 +134,7 @@ bool isMirCodeUseVar(MirCode *mirCode, const char *varName) {
     switch (mirCode->mirType) {
         case MIR_2: {
             Mir2 *mir2 = mirCode->mir2;
-            if (strcmp(mir2->distIdentity, varName) == 0) {
+            if (mir2->distIdentity == varName) {
                 return true;
             }
             if (isOperandEqualVarName(&mir2->fromValue, varName)) {
@@ -141,7 +144,7 @@ bool isMirCodeUseVar(MirCode *mirCode, const char *varName) {
         }
         case MIR_3: {
             Mir3 *mir3 = mirCode->mir3;
-            if (strcmp(mir3->distIdentity, varName) == 0) {
+            if (mir3->distIdentity == varName) {
                 return true;
             }
             if (isOperandEqualVarName(&mir3->value1, varName)) {
@@ -283,7 +286,7 @@ int getVarSizeFromStack(const char *varName) {
     currentStackVarStack->resetIterator(currentStackVarStack);
     StackVar *p = (StackVar *) currentStackVarStack->iteratorNext(currentStackVarStack);
     while (p != nullptr) {
-        if (strcmp(p->varName, varName) == 0) {
+        if (p->varName == varName) {
             return p->varSize;
         }
         p = (StackVar *) currentStackVarStack->iteratorNext(currentStackVarStack);
@@ -345,7 +348,7 @@ uint64_t getVarStackOffset(const char *varName) {
     currentStackVarStack->resetIterator(currentStackVarStack);
     StackVar *p = (StackVar *) currentStackVarStack->iteratorNext(currentStackVarStack);
     while (p != nullptr) {
-        if (strcmp(p->varName, varName) == 0) {
+        if (p->varName == varName) {
             return p->stackOffset;
         }
         p = (StackVar *) currentStackVarStack->iteratorNext(currentStackVarStack);
@@ -795,9 +798,9 @@ void generateCodes(MirCode *mirCode) {
                 } else {
                     //value1 must be reg!!!
                     int paramRegIndex = allocParamReg(paramIndex);
-                    char *paramVarName = (char *) malloc(sizeof(char) * 3);
-                    snprintf(paramVarName, 3, "%d", paramIndex);
-                    commonRegsVarName[paramRegIndex] = paramVarName;
+                    char paramVarName[3];
+                    int paramVarNameLength = snprintf(paramVarName, 3, "%d", paramIndex);
+                    commonRegsVarName[paramRegIndex] = internString(paramVarName, paramVarNameLength);
                     const char *paramRegName = getCommonRegName(
                             paramRegIndex,
                             getMirOperandSizeInByte(mirOperand->type)
@@ -1010,7 +1013,7 @@ int computeMethodStackSize(MirMethod *mirMethod) {
         mirMethodParam = mirMethodParam->next;
     }
     //compute var size
-    Stack *currentMethodVarList = createStack(ARM64_TAG);//const char *
+    Stack *currentMethodVarList = createStack(arm64Space);//const char *
     MirCode *mirCode = mirMethod->code;
     while (mirCode != nullptr) {
         switch (mirCode->mirType) {
@@ -1019,7 +1022,7 @@ int computeMethodStackSize(MirMethod *mirMethod) {
                 currentMethodVarList->resetIterator(currentMethodVarList);
                 const char *varIdentity = (const char *) currentMethodVarList->iteratorNext(currentMethodVarList);
                 while (varIdentity != nullptr) {
-                    if (strcmp(varIdentity, mirCode->mir3->distIdentity) == 0) {
+                    if (varIdentity == mirCode->mir3->distIdentity) {
                         varFound = true;
                         break;
                     }
@@ -1036,7 +1039,7 @@ int computeMethodStackSize(MirMethod *mirMethod) {
                 currentMethodVarList->resetIterator(currentMethodVarList);
                 const char *varIdentity = (const char *) currentMethodVarList->iteratorNext(currentMethodVarList);
                 while (varIdentity != nullptr) {
-                    if (strcmp(varIdentity, mirCode->mir2->distIdentity) == 0) {
+                    if (varIdentity == mirCode->mir2->distIdentity) {
                         varFound = true;
                         break;
                     }
@@ -5,11 +5,15 @@
 #include "binary_arm64.h"
 #include "logger.h"
 #include "mspace.h"
+#include "intern.h"
+#include "registry.h"
 #include "file.h"
 #include "register_arm64.h"
 
 #define BIN_TAG "arm64_bin"
 
+static MemSpace *binSpace = pccCreateSpace(BIN_TAG);
+
 struct LabelList {
     const char *label;
     int index;
@@ -60,9 +64,15 @@ int getCurrentInstCount() {
 
 void emitLabel(const char *label) {
     logd(BIN_TAG, "%s:", label);
-    LabelList *labelList = (LabelList *) pccMalloc(BIN_TAG, sizeof(LabelList));
+    LabelList *labelList = pccNew<LabelList>(binSpace);
     labelList->index = instCount;
-    labelList->label = label;
+    //the syscall stubs pass literals, labels are interned so relocation compares pointers
+    labelList->label = internCString(label);
+    //calls find the first label of a function through the registry
+    FunctionInfo *function = findFunction(labelList->label);
+    if (function != nullptr && function->textIndex == -1) {
+        function->textIndex = instCount;
+    }
     if (labelListHead == nullptr) {
         labelListHead = labelList;
     } else {
@@ -75,7 +85,7 @@ void emitLabel(const char *label) {
 }
 
 void emitInst(Inst inst) {
-    InstList *instList = (InstList *) pccMalloc(BIN_TAG, sizeof(InstList));
+    InstList *instList = pccNew<InstList>(binSpace);
     instList->inst = inst;
     instList->needRelocation = false;
     instList->next = nullptr;
@@ -92,19 +102,19 @@ void emitInst(Inst inst) {
 }
 
 void emitRelocateDataInst(Arm64Inst inst, Operand dist, const char *label) {
-    InstList *instList = (InstList *) pccMalloc(BIN_TAG, sizeof(InstList));
+    InstList *instList = pccNew<InstList>(binSpace);
     instList->inst = 0;
 
     instList->needRelocation = true;
     instList->relocateType = RELOCATE_DATA;
     instList->dataRelocateInfo.inst = inst;
     instList->dataRelocateInfo.dist = dist;
-    instList->dataRelocateInfo.label = label;
+    instList->dataRelocateInfo.label = internCString(label);
     instList->index = instCount++;
 
     InstList *fixAddList = nullptr;
     if (inst == INST_ADRP) {
-        fixAddList = (InstList *) pccMalloc(BIN_TAG, sizeof(InstList));
+        fixAddList = pccNew<InstList>(binSpace);
         fixAddList->inst = 0;
         fixAddList->needRelocation = true;
         fixAddList->relocateType = RELOCATE_DATA_FIX;
@@ -125,14 +135,14 @@ void emitRelocateDataInst(Arm64Inst inst, Operand dist, const char *label) {
 }
 
 void emitRelocateBranchInst(Arm64Inst inst, BranchCondition branchCondition, const char *label) {
-    InstList *instList = (InstList *) pccMalloc(BIN_TAG, sizeof(InstList));
+    InstList *instList = pccNew<InstList>(binSpace);
     instList->inst = 0;
 
     instList->needRelocation = true;
     instList->relocateType = RELOCATE_BRANCH;
     instList->branchRelocateInfo.inst = inst;
     instList->branchRelocateInfo.branchCondition = branchCondition;
-    instList->branchRelocateInfo.label = label;
+    instList->branchRelocateInfo.label = internCString(label);
 
     instList->next = nullptr;
     instList->index = instCount++;
@@ -150,7 +160,7 @@ void emitRelocateBranchInst(Arm64Inst inst, BranchCondition branchCondition, con
 int getLabelIndex(const char *label) {
     LabelList *p = labelListHead;
     while (p != nullptr) {
-        if (p->label != nullptr && strcmp(label, p->label) == 0) {
+        if (p->label == label) {
             return p->index;
         }
         p = p->next;
@@ -181,7 +191,11 @@ void relocateBinary(uint64_t dataSectionVaddrOffset, uint64_t alignment) {
         if (p->needRelocation) {
             switch (p->relocateType) {
                 case RELOCATE_BRANCH: {
-                    int labelIndex = getLabelIndex(p->branchRelocateInfo.label);
+                    //calls resolve in O(1), branches to local labels walk the list
+                    FunctionInfo *function = findFunction(p->branchRelocateInfo.label);
+                    int labelIndex = function != nullptr && function->textIndex != -1
+                                     ? function->textIndex
+                                     : getLabelIndex(p->branchRelocateInfo.label);
                     if (labelIndex == -1) {
                         loge(BIN_TAG, "error: unknown label:%s", p->branchRelocateInfo.label);
                         exit(-1);
@@ -259,8 +273,8 @@ InstBuffer *getEmittedInstBuffer() {
     if (instListHead == nullptr) {
         return nullptr;
     }
-    InstBuffer *buffer = (InstBuffer *) pccMalloc(BIN_TAG, sizeof(InstBuffer));
-    buffer->result = (Inst *) pccMalloc(BIN_TAG, sizeof(Inst) * instCount);
+    InstBuffer *buffer = pccNew<InstBuffer>(binSpace);
+    buffer->result = pccNewArray<Inst>(binSpace, instCount);
     buffer->size = sizeof(Inst) * instCount;
     InstList *p = instListHead;
     int index = 0;
@@ -271,7 +285,7 @@ InstBuffer *getEmittedInstBuffer() {
         buffer->result[index++] = p->inst;
         InstList *pre = p;
         p = p->next;
-        free(pre);
+        pccSpaceFree(binSpace, pre);
     }
     if (index != instCount) {
         loge(BIN_TAG, "error: inst index invalid! %d, %d", instCount, index);
@@ -846,7 +860,7 @@ uint64_t dataOffset = 0;
 uint64_t getDataOffset(const char *label) {
     DataList *p = dataListHead;
     while (p != nullptr) {
-        if (strcmp(p->label, label) == 0) {
+        if (p->label == label) {
             return p->offset;
         }
         p = p->next;
@@ -857,9 +871,9 @@ uint64_t getDataOffset(const char *label) {
 void binaryData(const char *label, void *buffer, const char *type, uint32_t size) {
     logd(BIN_TAG, "%s:", label);
     logd(BIN_TAG, "\t#%02X: %s[%d]", dataOffset, type, size);
-    DataList *dataList = (DataList *) pccMalloc(BIN_TAG, sizeof(DataList));
+    DataList *dataList = pccNew<DataList>(binSpace);
     dataList->next = nullptr;
-    dataList->label = label;
+    dataList->label = internCString(label);
     dataList->buffer = buffer;
     dataList->size = size;
     dataList->offset = dataOffset;
@@ -881,8 +895,8 @@ DataBuffer *getEmittedDataBuffer() {
         loge(BIN_TAG, "not relocated yet!");
         exit(-1);
     }
-    DataBuffer *dataBuffer = (DataBuffer *) pccMalloc(BIN_TAG, sizeof(DataBuffer));
-    dataBuffer->result = pccMalloc(BIN_TAG, dataOffset);
+    DataBuffer *dataBuffer = pccNew<DataBuffer>(binSpace);
+    dataBuffer->result = pccSpaceAlloc(binSpace, dataOffset);
     dataBuffer->size = 0;
 
     DataList *p = dataListHead;
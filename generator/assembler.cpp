@@ -30,6 +30,8 @@ void generateElfArm64(Mir *mir,
     initLinuxArm64ProgramStart();
     initLinuxArm64SyscallWrapper();
     int sectionCount = generateArm64Target(mir);
+    //.text is always there, .data only when the program has global data
+    bool hasData = sectionCount > 1;
     programEntry += sizeof(Elf64_Ehdr);//elf header
     programHeaderCount += sectionCount;
     sectionHeaderCount += sectionCount;
@@ -45,28 +47,50 @@ void generateElfArm64(Mir *mir,
     InstBuffer *instBuffer = getEmittedInstBuffer();
     DataBuffer *dataBuffer = getEmittedDataBuffer();
 
+    presizeFile(alignTo(dataEntry + dataBuffer->size, alignment) + shstrtabSize);
+    //headers are written once the sections are laid out
+    uint64_t programHeaderOffset = sizeof(Elf64_Ehdr);
+    reserveFile(sizeof(Elf64_Ehdr) + programHeaderCount * sizeof(Elf64_Phdr));
+    uint64_t sectionHeaderOffset = reserveFile(sectionHeaderCount * sizeof(Elf64_Shdr));
+    //binary buffer
+    writeEmptyAlignment(alignment);
+    uint64_t textOffset = getCurrentFileOffset();
+    writeFileB(instBuffer->result, instBuffer->size);
+    writeEmptyAlignment(alignment);
+    uint64_t dataOffset = getCurrentFileOffset();
+    writeFileB(dataBuffer->result, dataBuffer->size);
+    writeEmptyAlignment(alignment);
+    uint64_t strTabOffset = getCurrentFileOffset();
+    writeFileB(shstrtabString, shstrtabSize);
+    if (textOffset != programEntry || dataOffset != dataEntry) {
+        loge(ASSEMBLER_TAG, "internal error: elf layout mismatch, text=%llu/%llu, data=%llu/%llu",
+             (unsigned long long) textOffset, (unsigned long long) programEntry,
+             (unsigned long long) dataOffset, (unsigned long long) dataEntry);
+        exit(-1);
+    }
+
     Elf64_Phdr *textProgramHeader = createProgramHeader(PT_LOAD,
                                                         PF_R | PF_X,
                                                         0,
                                                         0,
                                                         0,
-                                                        programEntry + instBuffer->size,
-                                                        programEntry + instBuffer->size,
-                                                        4096);
+                                                        textOffset + instBuffer->size,
+                                                        textOffset + instBuffer->size,
+                                                        alignment);
 
     Elf64_Phdr *dataProgramHeader = createProgramHeader(PT_LOAD,
                                                         PF_R | PF_W,
-                                                        dataEntry,
-                                                        dataEntry,
-                                                        dataEntry,
+                                                        dataOffset,
+                                                        dataOffset,
+                                                        dataOffset,
                                                         dataBuffer->size,
                                                         dataBuffer->size,
-                                                        4096);
+                                                        alignment);
     Elf64_Shdr *textSectionHeader = createSectionHeader(TEXT_SECTION_IDX,
                                                         SHT_PROGBITS,
                                                         SHF_ALLOC | SHF_EXECINSTR,
-                                                        programEntry,
-                                                        programEntry,
+                                                        textOffset,
+                                                        textOffset,
                                                         instBuffer->size,
                                                         0,
                                                         0,
@@ -76,34 +100,28 @@ void generateElfArm64(Mir *mir,
     Elf64_Shdr *dataSectionHeader = createSectionHeader(DATA_SECTION_IDX,
                                                         SHT_PROGBITS,
                                                         SHF_WRITE | SHF_ALLOC,
-                                                        dataEntry,
-                                                        dataEntry,
+                                                        dataOffset,
+                                                        dataOffset,
                                                         dataBuffer->size,
                                                         0,
                                                         0,
                                                         4,
                                                         0);
 
-    uint64_t strTabEntry = alignTo(dataEntry + dataBuffer->size, 4096);
-
     Elf64_Shdr *shstrtabSectionHeader = createSectionHeader(SHSTRTAB_SECTION_IDX,
                                                             SHT_STRTAB,
                                                             SHF_STRINGS | SHF_ALLOC,
-                                                            strTabEntry,
-                                                            strTabEntry,
-                                                            52,
+                                                            strTabOffset,
+                                                            strTabOffset,
+                                                            shstrtabSize,
                                                             0,
                                                             0,
                                                             4,
                                                             0);
 
-    uint64_t programHeaderOffset = sizeof(Elf64_Ehdr);
-    uint64_t sectionHeaderOffset = programHeaderOffset + (sizeof(Elf64_Phdr) * programHeaderCount);
-
-
     Elf64_Ehdr *elfHeader = createElfHeader(ET_DYN,
                                             EM_AARCH64,
-                                            programEntry,
+                                            textOffset,
                                             programHeaderOffset,
                                             sectionHeaderOffset,
                                             sizeof(Elf64_Phdr),
@@ -111,21 +129,21 @@ void generateElfArm64(Mir *mir,
                                             sizeof(Elf64_Shdr),
                                             sectionHeaderCount,
                                             sectionHeaderCount - 1);
-    writeFileB(elfHeader, sizeof(Elf64_Ehdr));
-    //program header
-    writeFileB(textProgramHeader, sizeof(Elf64_Phdr));
-    writeFileB(dataProgramHeader, sizeof(Elf64_Phdr));
+    writeFileAt(0, elfHeader, sizeof(Elf64_Ehdr));
+    //program header, the header counts only cover what is really emitted
+    writeFileAt(programHeaderOffset, textProgramHeader, sizeof(Elf64_Phdr));
+    if (hasData) {
+        writeFileAt(programHeaderOffset + sizeof(Elf64_Phdr), dataProgramHeader, sizeof(Elf64_Phdr));
+    }
     //section header
-    writeFileB(textSectionHeader, sizeof(Elf64_Shdr));
-    writeFileB(dataSectionHeader, sizeof(Elf64_Shdr));
-    writeFileB(shstrtabSectionHeader, sizeof(Elf64_Shdr));
-    //binary buffer
-    writeEmptyAlignment(4096);
-    writeFileB(instBuffer->result, instBuffer->size);
-    writeEmptyAlignment(4096);
-    writeFileB(dataBuffer->result, dataBuffer->size);
-    writeEmptyAlignment(4096);
-    writeFileB(shstrtabString, shstrtabSize);
+    uint64_t sectionHeaderEnd = sectionHeaderOffset;
+    writeFileAt(sectionHeaderEnd, textSectionHeader, sizeof(Elf64_Shdr));
+    sectionHeaderEnd += sizeof(Elf64_Shdr);
+    if (hasData) {
+        writeFileAt(sectionHeaderEnd, dataSectionHeader, sizeof(Elf64_Shdr));
+        sectionHeaderEnd += sizeof(Elf64_Shdr);
+    }
+    writeFileAt(sectionHeaderEnd, shstrtabSectionHeader, sizeof(Elf64_Shdr));
     logd(ASSEMBLER_TAG, "elf arm64 generation finish.");
 }
 
@@ -170,21 +188,25 @@ void generatePeArm64(Mir *mir,
                                                            IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ |
                                                            IMAGE_SCN_CNT_CODE); // 可执行，可读
 
-    // 4. 生成 PE 头部
+    // 4. 写入节数据, 头部最后回填
+    presizeFile(textSectionFileOffset + textSectionFileSize);
+    reserveFile(getPeHeaderSize() + sectionCount * sizeof(SectionHeader));
+    writeEmptyAlignment(fileAlignment);
+    writeFileB(instBuffer->result, instBuffer->size); // 写入指令
+    writeEmptyAlignment(fileAlignment);
+
+    // 5. 布局完成后生成 PE 头部, SizeOfImage 覆盖到最后一个节的末尾
+    uint32_t sizeOfImage = alignTo(textSectionVirtualAddress + textSectionVirtualSize, ramAlignment);
     void *peHeader = createPeHeader(IMAGE_FILE_MACHINE_ARM64, // ARM64 架构
                                     sectionCount,
                                     textSectionFileSize,
                                     textSectionVirtualAddress,
                                     IMAGE_BASE_64_EXE, // 默认 imageBase
                                     ramAlignment,
-                                    fileAlignment);
-
-    // 5. 写入 PE 文件
-    writeFileB(peHeader, getPeHeaderSize());//write header
-    writeFileB(textSectionHeader, sizeof(SectionHeader));
-    writeEmptyAlignment(fileAlignment);
-    writeFileB(instBuffer->result, instBuffer->size); // 写入指令
-    writeEmptyAlignment(fileAlignment);
+                                    fileAlignment,
+                                    sizeOfImage);
+    writeFileAt(0, peHeader, getPeHeaderSize());//write header
+    writeFileAt(getPeHeaderSize(), textSectionHeader, sizeof(SectionHeader));
     logd(ASSEMBLER_TAG, "pe arm64 generation finish.");
 }
 
@@ -289,13 +311,20 @@ void generateMachoArm64(Mir *mir,
             loadCommandSize,
             MH_NOUNDEFS | MH_PIE);
 
-    writeFileB(machHeader, sizeof(mach_header_64));
-    writeFileB(pageZeroLc, sizeof(segment_command_64));
-    writeFileB(textLc, sizeof(segment_command_64));
-    writeFileB(textSection, sizeof(section_64));
-    writeFileB(mainLc, sizeof(entry_point_command));
+    //load commands are patched in front of the code once it is written
+    presizeFile(codeFileAddr + instBuffer->size);
+    uint64_t headerOffset = reserveFile(currentFileAddr);
     writeEmptyAlignment(file_alignment);
     writeFileB(instBuffer->result, instBuffer->size);
+    writeFileAt(headerOffset, machHeader, sizeof(mach_header_64));
+    headerOffset += sizeof(mach_header_64);
+    writeFileAt(headerOffset, pageZeroLc, sizeof(segment_command_64));
+    headerOffset += sizeof(segment_command_64);
+    writeFileAt(headerOffset, textLc, sizeof(segment_command_64));
+    headerOffset += sizeof(segment_command_64);
+    writeFileAt(headerOffset, textSection, sizeof(section_64));
+    headerOffset += sizeof(section_64);
+    writeFileAt(headerOffset, mainLc, sizeof(entry_point_command));
     logd(ASSEMBLER_TAG, "mach-o arm64 generation finish.");
 }
 
@@ -6,10 +6,14 @@
 #include "compiler/preprocessor.h"
 #include "compiler/lexer.h"
 #include "compiler/syntaxer.h"
+#include "compiler/registry.h"
 #include "compiler/mir.h"
 #include "compiler/optimization.h"
+#include "compiler/pch.h"
 #include "config.h"
 #include "assembler.h"
+#include "memory/mem_report.h"
+#include "file/file.h"
 
 #define MAIN_TAG "main"
 
@@ -21,6 +25,9 @@ static int optimizationLevel = -1;
 static int outputAssembly = 0;
 static int sharedLib = 0;
 static int fpic = 0;
+static int emitPch = 0;
+static const char *includePchFileName = nullptr;
+static int parseJobCount = 1;
 
 static void version() {
     printf("\n");
@@ -46,7 +53,13 @@ static void usage(int exitcode) {
             "  -O<number>           \toptimization level\n"
             "  -a <target-arch>     \ttarget cpu inst (arm64, x86_64)\n"
             "  -p <target-platform> \ttarget os platform (linux, macos, windows, bare)\n"
+            "  -I <dir>             \tadd a header search path\n"
+            "  -emit-pch            \tprecompile the input as a header set, written to -o\n"
+            "  -include-pch=<file>  \treuse a precompiled header, ignored when stale\n"
+            "  -j <number>          \tparse method bodies on <number> threads\n"
             "  -shared              \twrapper as shared lib\n"
+            "  -fmem-report         \tprint memory usage of every phase\n"
+            "  -fmmap-output        \twrite the output file through mmap\n"
             "  -h                   \tprint this help\n"
             "\n"
     );
@@ -55,7 +68,7 @@ static void usage(int exitcode) {
 
 void processParams(int argc, char **argv) {
     for (;;) {
-        int opt = getopt(argc, argv, "O:o:a:p:s:f:Shv");
+        int opt = getopt(argc, argv, "O:o:a:p:s:f:I:e:i:j:Shv");
         if (opt == -1)
             break;
         switch (opt) {
@@ -93,10 +106,46 @@ void processParams(int argc, char **argv) {
                     targetPlatform = PLATFORM_BARE;
                 }
                 break;
+            case 'I':
+                logd(MAIN_TAG, "[+] include path=%s", optarg);
+                addIncludePath(optarg);
+                break;
+            case 'e':
+                if (optarg != nullptr && strcmp("mit-pch", optarg) == 0) {
+                    logd(MAIN_TAG, "[+] emit precompiled header");
+                    emitPch = 1;
+                } else {
+                    loge(MAIN_TAG, "[-] unknown opt=-e%s", optarg);
+                    usage(1);
+                }
+                break;
+            case 'i':
+                if (optarg != nullptr && strncmp("nclude-pch=", optarg, 11) == 0 && optarg[11] != '\0') {
+                    logd(MAIN_TAG, "[+] include precompiled header=%s", optarg + 11);
+                    includePchFileName = optarg + 11;
+                } else {
+                    loge(MAIN_TAG, "[-] unknown opt=-i%s", optarg);
+                    usage(1);
+                }
+                break;
+            case 'j':
+                parseJobCount = atoi(optarg);
+                logd(MAIN_TAG, "[+] parse jobs=%d", parseJobCount);
+                if (parseJobCount < 1) {
+                    loge(MAIN_TAG, "[-] -j needs at least 1 job");
+                    usage(1);
+                }
+                break;
             case 'f':
                 if (optarg != nullptr && strcmp("pic", optarg) == 0) {
                     logd(MAIN_TAG, "[+] position independent code (fPIC)");
                     fpic = 1;
+                } else if (optarg != nullptr && strcmp("mem-report", optarg) == 0) {
+                    logd(MAIN_TAG, "[+] memory report");
+                    enableMemReport();
+                } else if (optarg != nullptr && strcmp("mmap-output", optarg) == 0) {
+                    logd(MAIN_TAG, "[+] mmap output file");
+                    setFileOutputMode(OUTPUT_MMAP);
                 }
                 break;
             case 'h':
@@ -128,6 +177,11 @@ void processParams(int argc, char **argv) {
         usage(1);
     }
 
+    if (emitPch && outputFileName == nullptr) {
+        loge(MAIN_TAG, "-emit-pch needs -o <file>");
+        usage(1);
+    }
+
     // Ensure that the input source file is provided
     if (optind != argc - 1) {
         usage(1);
@@ -142,20 +196,43 @@ void processParams(int argc, char **argv) {
 int main(int argc, char **argv) {
     initLogger();
     processParams(argc, argv);
+    if (includePchFileName != nullptr && !loadPrecompiledHeader(includePchFileName)) {
+        logd(MAIN_TAG, "precompiled header not used, compiling from source");
+    }
     ProcessedSource *source = preprocess(sourceFileName);
-    Token *tokens = buildTokens(source);
+    recordMemPhase("preprocess");
+    if (emitPch) {
+        TokenList *tokens = buildTokens(source);
+        recordMemPhase("lexer");
+        writePrecompiledHeader(outputFileName, tokens);
+        return 0;
+    }
+    //the lexer runs inside the parser, a window of tokens at a time
+    TokenStream *tokens = openTokenStream(source, getPrecompiledTokens(), true);
+    AstProgram *program;
+    if (parseJobCount > 1) {
+        //the parser threads look at every method at once, so the lexer runs to the end first
+        program = buildAstParallel(openTokenListStream(drainTokenStream(tokens)), parseJobCount);
+    } else {
+        program = buildAst(tokens);
+    }
+    recordMemPhase("syntaxer");
     releasePreProcessorMemory();
-    printTokenStack(tokens);
-    AstProgram *program = buildAst(tokens);
     releaseLexerMemory();
+    releasePrecompiledHeaderMemory();
     Mir *mir = generateMir(program);
+    recordMemPhase("mir");
     releaseAstMemory();
     mir = optimize(mir, optimizationLevel);
+    recordMemPhase("optimize");
     printMir(mir);
     generateTargetFile(mir,
                        targetArch,
                        targetPlatform,
                        sharedLib,
                        outputFileName);
+    recordMemPhase("generate");
+    releaseFunctionRegistryMemory();
+    printMemReport();
     return 0;
 }
@@ -0,0 +1,140 @@
+//
+// Created by Park Yu on 2024/12/2.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "mem_report.h"
+#include "mspace.h"
+#include "../logger/logger.h"
+
+#define MEM_REPORT_TAG "mem_report"
+
+#define MAX_PHASE_COUNT 16
+#define MAX_SPACE_COUNT 32
+
+struct SpaceColumn {
+    const char *name;
+    size_t peakUsedBytes;
+};
+
+struct PhaseRecord {
+    const char *phase;
+    size_t rssBytes;
+    size_t usedBytes[MAX_SPACE_COUNT];
+};
+
+static bool memReportEnabled = false;
+
+static SpaceColumn spaceColumns[MAX_SPACE_COUNT];
+static int spaceColumnCount = 0;
+
+static PhaseRecord phaseRecords[MAX_PHASE_COUNT];
+static int phaseRecordCount = 0;
+
+void enableMemReport() {
+    memReportEnabled = true;
+}
+
+static size_t samplePeakRss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (size_t) usage.ru_maxrss;
+#else
+    return (size_t) usage.ru_maxrss * 1024;
+#endif
+}
+
+static size_t sampleRss() {
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm != nullptr) {
+        unsigned long pages = 0;
+        unsigned long residentPages = 0;
+        int matched = fscanf(statm, "%lu %lu", &pages, &residentPages);
+        fclose(statm);
+        if (matched == 2) {
+            return residentPages * (size_t) sysconf(_SC_PAGESIZE);
+        }
+    }
+    //no procfs (macos), the peak rss is the closest we can get
+    return samplePeakRss();
+}
+
+static int foundOrCreateColumn(const char *name) {
+    for (int i = 0; i < spaceColumnCount; i++) {
+        if (strcmp(spaceColumns[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (spaceColumnCount >= MAX_SPACE_COUNT) {
+        return -1;
+    }
+    spaceColumns[spaceColumnCount].name = name;
+    spaceColumns[spaceColumnCount].peakUsedBytes = 0;
+    return spaceColumnCount++;
+}
+
+static void recordSpacePeak(const MemSpaceStat *stat, void *) {
+    int column = foundOrCreateColumn(stat->name);
+    if (column >= 0 && stat->peakUsedBytes > spaceColumns[column].peakUsedBytes) {
+        spaceColumns[column].peakUsedBytes = stat->peakUsedBytes;
+    }
+}
+
+static void recordSpace(const MemSpaceStat *stat, void *arg) {
+    PhaseRecord *record = (PhaseRecord *) arg;
+    int column = foundOrCreateColumn(stat->name);
+    if (column >= 0) {
+        record->usedBytes[column] += stat->usedBytes;
+    }
+}
+
+void recordMemPhase(const char *phase) {
+    if (!memReportEnabled) {
+        return;
+    }
+    if (phaseRecordCount >= MAX_PHASE_COUNT) {
+        loge(MEM_REPORT_TAG, "too many phases, drop %s", phase);
+        return;
+    }
+    PhaseRecord *record = &phaseRecords[phaseRecordCount++];
+    memset(record, 0, sizeof(PhaseRecord));
+    record->phase = phase;
+    pccVisitSpaces(recordSpace, record);
+    record->rssBytes = sampleRss();
+}
+
+static inline size_t toKB(size_t bytes) {
+    return (bytes + 1023) / 1024;
+}
+
+void printMemReport() {
+    if (!memReportEnabled) {
+        return;
+    }
+    pccVisitSpaces(recordSpacePeak, nullptr);
+    fprintf(stderr, "\nmemory report (KB):\n");
+    fprintf(stderr, "%-12s %10s", "phase", "rss");
+    for (int i = 0; i < spaceColumnCount; i++) {
+        fprintf(stderr, " %12s", spaceColumns[i].name);
+    }
+    fprintf(stderr, "\n");
+    for (int r = 0; r < phaseRecordCount; r++) {
+        PhaseRecord *record = &phaseRecords[r];
+        fprintf(stderr, "%-12s %10zu", record->phase, toKB(record->rssBytes));
+        for (int i = 0; i < spaceColumnCount; i++) {
+            fprintf(stderr, " %12zu", toKB(record->usedBytes[i]));
+        }
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "%-12s %10zu", "peak", toKB(samplePeakRss()));
+    for (int i = 0; i < spaceColumnCount; i++) {
+        fprintf(stderr, " %12zu", toKB(spaceColumns[i].peakUsedBytes));
+    }
+    fprintf(stderr, "\n");
+}
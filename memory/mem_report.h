@@ -0,0 +1,23 @@
+//
+// Created by Park Yu on 2024/12/2.
+//
+
+#ifndef PCC_CC_MEM_REPORT_H
+#define PCC_CC_MEM_REPORT_H
+
+/**
+ * -fmem-report, records are dropped until enabled.
+ */
+extern void enableMemReport();
+
+/**
+ * snapshot every space and the process rss after a compile phase.
+ */
+extern void recordMemPhase(const char *phase);
+
+/**
+ * print one row per recorded phase and a final peak row to stderr.
+ */
+extern void printMemReport();
+
+#endif //PCC_CC_MEM_REPORT_H
@@ -2,110 +2,483 @@
 // Created by Park Yu on 2024/10/10.
 //
 
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include "config.h"
 #include "mspace.h"
 #include "../logger/logger.h"
 
 #define MSPACE_TAG "mspace"
 
-struct MemNode {
-    void *addr;
-    MemNode *next;
+//64KB
+#define CHUNK_SIZE 65536
+//every block is 8 byte aligned, enough for all ast/mir/inst structs
+#define BLOCK_ALIGNMENT 8
+//requests larger than this get a dedicated chunk, so they never waste the tail of the bump chunk
+#define LARGE_BLOCK_SIZE (CHUNK_SIZE / 4)
+//freed blocks up to this size are kept in per-size free lists and recycled
+#define SMALL_BLOCK_SIZE 512
+#define SIZE_CLASS_COUNT (SMALL_BLOCK_SIZE / BLOCK_ALIGNMENT + 1)
+
+#ifdef PCC_MSPACE_DEBUG
+#define BLOCK_LIVE_MAGIC 0x6b636f6c42657669UL
+#define BLOCK_FREE_MAGIC 0x6b636f6c42656572UL
+#define BLOCK_POISON 0xdd
+#endif
+
+struct MemSpace;
+
+/**
+ * every block is prefixed by its header, so pccFree knows the size class without any lookup.
+ */
+struct BlockHeader {
+#ifdef PCC_MSPACE_DEBUG
+    MemSpace *owner;
+    size_t magic;
+#endif
+    //aligned payload size
+    size_t size;
 };
 
-struct MemHead {
-    const char *tag;
-    MemHead *next;
+#define BLOCK_HEADER_SIZE ((sizeof(BlockHeader) + BLOCK_ALIGNMENT - 1) & ~((size_t) BLOCK_ALIGNMENT - 1))
 
-    MemNode *memNode;
+//freed blocks reuse their payload as the free list link
+struct FreeBlock {
+    FreeBlock *next;
 };
 
-static MemHead *memHead = nullptr;
+/**
+ * chunk header, the payload follows directly after it.
+ * chunks are calloc-ed, so every block handed out is zero filled.
+ */
+struct MemChunk {
+    MemChunk *next;
+    size_t capacity;
+    size_t used;
+};
 
-MemHead *foundOrCreateMemHead(const char *spaceTag) {
-    MemHead *p = memHead;
-    while (p != nullptr) {
-        if (p->tag == spaceTag) {
-            return p;
-        }
+#define CHUNK_HEADER_SIZE ((sizeof(MemChunk) + BLOCK_ALIGNMENT - 1) & ~((size_t) BLOCK_ALIGNMENT - 1))
+
+/**
+ * a space is owned by one thread at a time, nothing on the allocation path is locked.
+ */
+struct MemSpace {
+    //current bump chunk is always the list head
+    MemChunk *chunk;
+    //indexed by size / BLOCK_ALIGNMENT
+    FreeBlock *freeLists[SIZE_CLASS_COUNT];
+    MemSpaceStat stat;
+
+    //set by pccForkSpace
+    MemSpace *parent;
+    //forked children not merged yet
+    std::atomic<int> childCount;
+    //children handed off from worker threads, absorbed by the owner thread later
+    std::atomic<MemSpace *> handoffHead;
+    MemSpace *handoffNext;
+
+    //only used by the tag registry of the creating thread
+    MemSpace *tagNext;
+
+    //every live space, in creation order, guarded by spaceListLock
+    MemSpace *next;
+};
+
+//only taken to create, destroy or visit spaces
+static std::mutex spaceListLock;
+static MemSpace *spaceHead = nullptr;
+static MemSpace *spaceTail = nullptr;
+
+static inline size_t alignBlockSize(size_t size) {
+    return (size + BLOCK_ALIGNMENT - 1) & ~((size_t) BLOCK_ALIGNMENT - 1);
+}
+
+static inline char *chunkPayload(MemChunk *chunk) {
+    return ((char *) chunk) + CHUNK_HEADER_SIZE;
+}
+
+static MemChunk *createChunk(size_t capacity) {
+    MemChunk *chunk = (MemChunk *) calloc(1, CHUNK_HEADER_SIZE + capacity);
+    if (chunk == nullptr) {
+        loge(MSPACE_TAG, "out of memory: chunk size=%zu", capacity);
+        exit(-1);
+    }
+    chunk->next = nullptr;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    return chunk;
+}
+
+MemSpace *pccCreateSpace(const char *name) {
+    MemSpace *space = new(std::nothrow) MemSpace();
+    if (space == nullptr) {
+        loge(MSPACE_TAG, "out of memory: create space %s", name);
+        exit(-1);
+    }
+    space->stat.name = name;
+    std::lock_guard<std::mutex> guard(spaceListLock);
+    if (spaceTail == nullptr) {
+        spaceHead = space;
+    } else {
+        spaceTail->next = space;
+    }
+    spaceTail = space;
+    return space;
+}
+
+static void unlinkSpace(MemSpace *space) {
+    std::lock_guard<std::mutex> guard(spaceListLock);
+    MemSpace *pre = nullptr;
+    MemSpace *p = spaceHead;
+    while (p != nullptr && p != space) {
+        pre = p;
         p = p->next;
     }
-    MemHead *currentMemHead = (MemHead *) malloc(sizeof(MemHead));
-    currentMemHead->tag = spaceTag;
-    currentMemHead->next = nullptr;
-    currentMemHead->memNode = nullptr;
-    if (memHead == nullptr) {
-        memHead = currentMemHead;
+    if (p == nullptr) {
+        loge(MSPACE_TAG, "internal error: unknown space %s", space->stat.name);
+        exit(-1);
+    }
+    if (pre == nullptr) {
+        spaceHead = space->next;
     } else {
-        p = memHead;
-        while (p->next != nullptr) {
-            p = p->next;
+        pre->next = space->next;
+    }
+    if (spaceTail == space) {
+        spaceTail = pre;
+    }
+}
+
+static inline void recordAlloc(MemSpaceStat *stat, size_t size) {
+    stat->usedBytes += size;
+    stat->blockCount++;
+    stat->totalBytes += size;
+    stat->totalBlockCount++;
+    if (stat->usedBytes > stat->peakUsedBytes) {
+        stat->peakUsedBytes = stat->usedBytes;
+    }
+    if (stat->blockCount > stat->peakBlockCount) {
+        stat->peakBlockCount = stat->blockCount;
+    }
+}
+
+static inline void recordChunk(MemSpaceStat *stat, size_t capacity) {
+    stat->reservedBytes += capacity;
+    if (stat->reservedBytes > stat->peakReservedBytes) {
+        stat->peakReservedBytes = stat->reservedBytes;
+    }
+}
+
+static inline BlockHeader *blockHeader(void *pointer) {
+    return (BlockHeader *) (((char *) pointer) - BLOCK_HEADER_SIZE);
+}
+
+static char *bumpAlloc(MemSpace *space, size_t size) {
+    MemChunk *chunk = space->chunk;
+    if (chunk != nullptr && chunk->capacity - chunk->used >= size) {
+        char *result = chunkPayload(chunk) + chunk->used;
+        chunk->used += size;
+        return result;
+    }
+    if (size > LARGE_BLOCK_SIZE) {
+        //dedicated chunk, keep the current bump chunk at the head
+        MemChunk *largeChunk = createChunk(size);
+        recordChunk(&space->stat, size);
+        largeChunk->used = size;
+        if (chunk == nullptr) {
+            space->chunk = largeChunk;
+        } else {
+            largeChunk->next = chunk->next;
+            chunk->next = largeChunk;
+        }
+        return chunkPayload(largeChunk);
+    }
+    MemChunk *newChunk = createChunk(CHUNK_SIZE);
+    recordChunk(&space->stat, CHUNK_SIZE);
+    newChunk->next = chunk;
+    space->chunk = newChunk;
+    newChunk->used = size;
+    return chunkPayload(newChunk);
+}
+
+void *pccSpaceAlloc(MemSpace *space, size_t size) {
+    size = alignBlockSize(size == 0 ? 1 : size);
+    recordAlloc(&space->stat, size);
+    if (size <= SMALL_BLOCK_SIZE) {
+        FreeBlock *freeBlock = space->freeLists[size / BLOCK_ALIGNMENT];
+        if (freeBlock != nullptr) {
+            space->freeLists[size / BLOCK_ALIGNMENT] = freeBlock->next;
+#ifdef PCC_MSPACE_DEBUG
+            blockHeader(freeBlock)->magic = BLOCK_LIVE_MAGIC;
+#endif
+            //callers rely on zero filled memory
+            memset(freeBlock, 0, size);
+            return freeBlock;
         }
-        p->next = currentMemHead;
     }
-    return currentMemHead;
+    BlockHeader *header = (BlockHeader *) bumpAlloc(space, BLOCK_HEADER_SIZE + size);
+#ifdef PCC_MSPACE_DEBUG
+    header->owner = space;
+    header->magic = BLOCK_LIVE_MAGIC;
+#endif
+    header->size = size;
+    return ((char *) header) + BLOCK_HEADER_SIZE;
 }
 
-void appendMemNodeToHead(MemHead *currentMemHead, MemNode *currentMemNode) {
-    if (currentMemHead->memNode == nullptr) {
-        currentMemHead->memNode = currentMemNode;
+void *pccSpaceAllocArray(MemSpace *space, size_t count, size_t size) {
+    if (size != 0 && count > ((size_t) -1) / size) {
+        loge(MSPACE_TAG, "array size overflow: %zu * %zu, space=%s", count, size, space->stat.name);
+        exit(-1);
+    }
+    return pccSpaceAlloc(space, count * size);
+}
+
+void pccSpaceFree(MemSpace *space, void *pointer) {
+    if (pointer == nullptr) {
+        loge(MSPACE_TAG, "internal error: free null memory, space=%s", space->stat.name);
         return;
     }
-    MemNode *memNode = currentMemHead->memNode;
-    while (memNode->next != nullptr) {
-        memNode = memNode->next;
+    BlockHeader *header = blockHeader(pointer);
+#ifdef PCC_MSPACE_DEBUG
+    if (header->magic == BLOCK_FREE_MAGIC) {
+        loge(MSPACE_TAG, "internal error: double free %p, space=%s", pointer, space->stat.name);
+        exit(-1);
+    }
+    if (header->magic != BLOCK_LIVE_MAGIC) {
+        loge(MSPACE_TAG, "internal error: free unknown memory %p, space=%s", pointer, space->stat.name);
+        exit(-1);
+    }
+    if (header->owner != space) {
+        loge(MSPACE_TAG, "internal error: free %p of space %s from space %s",
+             pointer, header->owner->stat.name, space->stat.name);
+        exit(-1);
+    }
+    header->magic = BLOCK_FREE_MAGIC;
+    memset(pointer, BLOCK_POISON, header->size);
+#endif
+    size_t size = header->size;
+    space->stat.usedBytes -= size;
+    space->stat.blockCount--;
+    //larger blocks stay in their chunk until the space is reset
+    if (size <= SMALL_BLOCK_SIZE) {
+        FreeBlock *freeBlock = (FreeBlock *) pointer;
+        freeBlock->next = space->freeLists[size / BLOCK_ALIGNMENT];
+        space->freeLists[size / BLOCK_ALIGNMENT] = freeBlock;
     }
-    memNode->next = currentMemNode;
 }
 
-void *pccMalloc(const char *spaceTag, size_t size) {
-    MemNode *memNode = (MemNode *) malloc(sizeof(MemNode));
-    memNode->addr = malloc(size);
-    memNode->next = nullptr;
-    MemHead *currentMemHead = foundOrCreateMemHead(spaceTag);
-    appendMemNodeToHead(currentMemHead, memNode);
-    return memNode->addr;
+#ifdef PCC_MSPACE_DEBUG
+
+static void rewriteBlockOwner(MemChunk *chunk, MemSpace *owner) {
+    size_t offset = 0;
+    while (offset < chunk->used) {
+        BlockHeader *header = (BlockHeader *) (chunkPayload(chunk) + offset);
+        header->owner = owner;
+        offset += BLOCK_HEADER_SIZE + header->size;
+    }
 }
 
-void pccFree(const char *spaceTag, void *pointer) {
-    MemHead *currentMemHead = foundOrCreateMemHead(spaceTag);
-    while (currentMemHead != nullptr) {
-        if (currentMemHead->tag == spaceTag) {
-            MemNode *memNode = currentMemHead->memNode;
-            MemNode *preMemNode = nullptr;
-            while (memNode != nullptr) {
-                if (memNode->addr == pointer) {
-                    free(memNode->addr);
-
-                    if (preMemNode != nullptr) {
-                        preMemNode->next = memNode->next;
-                    }
-                    free(memNode);
-                    return;
-                }
-                preMemNode = memNode;
-                memNode = memNode->next;
-            }
-            break;
+#endif
+
+/**
+ * move every chunk and free block of child into parent, then drop the child handle.
+ * must run on the thread owning parent.
+ */
+static void absorbSpace(MemSpace *parent, MemSpace *child) {
+    MemChunk *childChunk = child->chunk;
+    if (childChunk != nullptr) {
+        MemChunk *tail = childChunk;
+#ifdef PCC_MSPACE_DEBUG
+        rewriteBlockOwner(tail, parent);
+#endif
+        while (tail->next != nullptr) {
+            tail = tail->next;
+#ifdef PCC_MSPACE_DEBUG
+            rewriteBlockOwner(tail, parent);
+#endif
         }
-        currentMemHead = currentMemHead->next;
+        //keep the bump chunk of parent at the head
+        if (parent->chunk == nullptr) {
+            parent->chunk = childChunk;
+        } else {
+            tail->next = parent->chunk->next;
+            parent->chunk->next = childChunk;
+        }
+    }
+    for (int i = 0; i < SIZE_CLASS_COUNT; i++) {
+        FreeBlock *freeBlock = child->freeLists[i];
+        while (freeBlock != nullptr) {
+            FreeBlock *next = freeBlock->next;
+            freeBlock->next = parent->freeLists[i];
+            parent->freeLists[i] = freeBlock;
+            freeBlock = next;
+        }
+    }
+    MemSpaceStat *stat = &parent->stat;
+    stat->usedBytes += child->stat.usedBytes;
+    stat->blockCount += child->stat.blockCount;
+    stat->reservedBytes += child->stat.reservedBytes;
+    stat->totalBytes += child->stat.totalBytes;
+    stat->totalBlockCount += child->stat.totalBlockCount;
+    if (stat->usedBytes > stat->peakUsedBytes) {
+        stat->peakUsedBytes = stat->usedBytes;
     }
-    loge(MSPACE_TAG, "internal error: free unknown memory, space=%s addr=%p", spaceTag, pointer);
+    if (stat->blockCount > stat->peakBlockCount) {
+        stat->peakBlockCount = stat->blockCount;
+    }
+    if (stat->reservedBytes > stat->peakReservedBytes) {
+        stat->peakReservedBytes = stat->reservedBytes;
+    }
+    parent->childCount--;
+    unlinkSpace(child);
+    delete child;
 }
 
-void pccFreeSpace(const char *spaceTag) {
-    logd(MSPACE_TAG, "free memory space: %s", spaceTag);
-    MemHead *currentMemHead = foundOrCreateMemHead(spaceTag);
-    while (currentMemHead != nullptr) {
-        if (currentMemHead->tag == spaceTag) {
-            MemNode *memNode = currentMemHead->memNode;
-            while (memNode != nullptr) {
-                free(memNode->addr);
-                MemNode *p = memNode;
-                memNode = memNode->next;
-                free(p);
-            }
-            break;
+static void absorbHandoffSpaces(MemSpace *space) {
+    MemSpace *child = space->handoffHead.exchange(nullptr, std::memory_order_acquire);
+    while (child != nullptr) {
+        MemSpace *next = child->handoffNext;
+        absorbSpace(space, child);
+        child = next;
+    }
+}
+
+MemSpace *pccForkSpace(MemSpace *parent) {
+    MemSpace *child = pccCreateSpace(parent->stat.name);
+    child->parent = parent;
+    parent->childCount++;
+    return child;
+}
+
+void pccMergeSpace(MemSpace *parent, MemSpace *child) {
+    if (child->parent != parent) {
+        loge(MSPACE_TAG, "internal error: merge space %s into %s, not its parent",
+             child->stat.name, parent->stat.name);
+        exit(-1);
+    }
+    absorbHandoffSpaces(child);
+    absorbHandoffSpaces(parent);
+    absorbSpace(parent, child);
+}
+
+void pccHandoffSpace(MemSpace *child) {
+    MemSpace *parent = child->parent;
+    if (parent == nullptr) {
+        loge(MSPACE_TAG, "internal error: hand off space %s without parent", child->stat.name);
+        exit(-1);
+    }
+    absorbHandoffSpaces(child);
+    MemSpace *head = parent->handoffHead.load(std::memory_order_relaxed);
+    do {
+        child->handoffNext = head;
+    } while (!parent->handoffHead.compare_exchange_weak(head, child,
+                                                        std::memory_order_release,
+                                                        std::memory_order_relaxed));
+}
+
+void pccResetSpace(MemSpace *space) {
+    logd(MSPACE_TAG, "free memory space: %s", space->stat.name);
+    absorbHandoffSpaces(space);
+    MemChunk *chunk = space->chunk;
+    while (chunk != nullptr) {
+        MemChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    space->chunk = nullptr;
+    memset(space->freeLists, 0, sizeof(space->freeLists));
+    space->stat.usedBytes = 0;
+    space->stat.blockCount = 0;
+    space->stat.reservedBytes = 0;
+}
+
+void pccDestroySpace(MemSpace *space) {
+    pccResetSpace(space);
+    if (space->childCount != 0) {
+        loge(MSPACE_TAG, "internal error: destroy space %s with %d forked spaces alive",
+             space->stat.name, space->childCount.load());
+        exit(-1);
+    }
+    if (space->parent != nullptr) {
+        space->parent->childCount--;
+    }
+    unlinkSpace(space);
+    delete space;
+}
+
+void pccDiscardPages(void *pointer, size_t size) {
+    static const uintptr_t pageSize = (uintptr_t) sysconf(_SC_PAGESIZE);
+    //only pages entirely inside the range, the partial ones at its ends may hold live data
+    uintptr_t start = ((uintptr_t) pointer + pageSize - 1) & ~(pageSize - 1);
+    uintptr_t end = ((uintptr_t) pointer + size) & ~(pageSize - 1);
+    if (end <= start) {
+        return;
+    }
+    if (madvise((void *) start, end - start, MADV_DONTNEED) != 0) {
+        logd(MSPACE_TAG, "discard %zu bytes failed", (size_t) (end - start));
+    }
+}
+
+void pccGetSpaceStat(MemSpace *space, MemSpaceStat *stat) {
+    absorbHandoffSpaces(space);
+    *stat = space->stat;
+}
+
+void pccVisitSpaces(MemSpaceVisitor visitor, void *arg) {
+    std::lock_guard<std::mutex> guard(spaceListLock);
+    MemSpace *p = spaceHead;
+    while (p != nullptr) {
+        visitor(&p->stat, arg);
+        p = p->next;
+    }
+}
+
+/**
+ * tag spaces are per thread, a worker using the tag api never touches the spaces of another thread.
+ * they are destroyed when the thread exits.
+ */
+struct TagSpaceRegistry {
+    MemSpace *head = nullptr;
+
+    ~TagSpaceRegistry() {
+        MemSpace *p = head;
+        while (p != nullptr) {
+            MemSpace *next = p->tagNext;
+            pccDestroySpace(p);
+            p = next;
         }
-        currentMemHead = currentMemHead->next;
     }
-}
\ No newline at end of file
+};
+
+static thread_local TagSpaceRegistry tagSpaceRegistry;
+
+static MemSpace *foundOrCreateTagSpace(const char *spaceTag) {
+    MemSpace *p = tagSpaceRegistry.head;
+    while (p != nullptr) {
+        //equal tags from different translation units may have different addresses
+        if (p->stat.name == spaceTag || strcmp(p->stat.name, spaceTag) == 0) {
+            return p;
+        }
+        p = p->tagNext;
+    }
+    MemSpace *space = pccCreateSpace(spaceTag);
+    space->tagNext = tagSpaceRegistry.head;
+    tagSpaceRegistry.head = space;
+    return space;
+}
+
+void *pccMalloc(const char *spaceTag, size_t size) {
+    return pccSpaceAlloc(foundOrCreateTagSpace(spaceTag), size);
+}
+
+void pccFree(const char *spaceTag, void *pointer) {
+    pccSpaceFree(foundOrCreateTagSpace(spaceTag), pointer);
+}
+
+void pccFreeSpace(const char *spaceTag) {
+    pccResetSpace(foundOrCreateTagSpace(spaceTag));
+}
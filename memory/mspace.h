@@ -11,6 +11,98 @@ extern "C" {
 
 #include <stdlib.h>
 
+/**
+ * a memory space is a chunked bump-pointer arena.
+ * callers keep the handle, so allocation never looks anything up.
+ * a space must only be used by one thread at a time, create, destroy and visit are thread safe.
+ */
+struct MemSpace;
+
+struct MemSpaceStat {
+    const char *name;
+    //bytes handed out since the last reset, aligned
+    size_t usedBytes;
+    size_t blockCount;
+    //bytes held by chunks
+    size_t reservedBytes;
+
+    //high-water marks, they survive resets
+    size_t peakUsedBytes;
+    size_t peakBlockCount;
+    size_t peakReservedBytes;
+
+    //bytes and blocks handed out over the whole life of the space
+    size_t totalBytes;
+    size_t totalBlockCount;
+};
+
+/**
+ * create an empty space, name is only used for logs.
+ */
+extern struct MemSpace *pccCreateSpace(const char *name);
+
+/**
+ * bump-pointer allocation from the space's current chunk, memory is zero filled.
+ */
+extern void *pccSpaceAlloc(struct MemSpace *space, size_t size);
+
+/**
+ * allocate count * size bytes, exit on overflow.
+ */
+extern void *pccSpaceAllocArray(struct MemSpace *space, size_t count, size_t size);
+
+/**
+ * O(1), small blocks go to a per-size free list and are recycled by later allocations.
+ * build with PCC_MSPACE_DEBUG to catch double frees and frees from the wrong space.
+ */
+extern void pccSpaceFree(struct MemSpace *space, void *pointer);
+
+/**
+ * release every chunk of the space at once, the handle stays valid.
+ */
+extern void pccResetSpace(struct MemSpace *space);
+
+/**
+ * release every chunk and the handle itself.
+ */
+extern void pccDestroySpace(struct MemSpace *space);
+
+/**
+ * create a space for a worker thread, its memory ends up in parent by merge or hand off.
+ */
+extern struct MemSpace *pccForkSpace(struct MemSpace *parent);
+
+/**
+ * move every block of child into parent and destroy child, blocks stay valid.
+ * called on the thread owning parent, after the worker is done with child.
+ */
+extern void pccMergeSpace(struct MemSpace *parent, struct MemSpace *child);
+
+/**
+ * called on the worker thread when it is done with child, lock free.
+ * parent absorbs child the next time its owner resets, destroys, merges or reads stats of it.
+ */
+extern void pccHandoffSpace(struct MemSpace *child);
+
+/**
+ * hand the whole pages inside [pointer, pointer + size) back to the os, for a block whose caller never reads
+ * that part again. the block keeps its address and size, it is still freed with its space.
+ */
+extern void pccDiscardPages(void *pointer, size_t size);
+
+extern void pccGetSpaceStat(struct MemSpace *space, struct MemSpaceStat *stat);
+
+typedef void (*MemSpaceVisitor)(const struct MemSpaceStat *stat, void *arg);
+
+/**
+ * visit the stat of every live space in creation order.
+ */
+extern void pccVisitSpaces(MemSpaceVisitor visitor, void *arg);
+
+/**
+ * tag based api, the tag is resolved to a space of the calling thread by name on every call.
+ * prefer keeping a MemSpace handle on hot paths.
+ */
 extern void *pccMalloc(const char *spaceTag, size_t size);
 
 extern void pccFree(const char *spaceTag, void *pointer);
@@ -19,6 +111,24 @@ extern void pccFreeSpace(const char *spaceTag);
 
 #ifdef __cplusplus
 }
+
+#include <new>
+#include <type_traits>
+
+//space memory is never destructed, only trivially destructible types may live there
+template<typename T>
+static inline T *pccNew(MemSpace *space) {
+    static_assert(std::is_trivially_destructible<T>::value, "space objects are never destructed");
+    return new(pccSpaceAlloc(space, sizeof(T))) T;
+}
+
+template<typename T>
+static inline T *pccNewArray(MemSpace *space, size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value, "space objects are never destructed");
+    static_assert(std::is_trivially_default_constructible<T>::value, "space arrays are zero filled, not constructed");
+    return (T *) pccSpaceAllocArray(space, count, sizeof(T));
+}
+
 #endif
 
 #endif //PCC_CC_MSPACE_H
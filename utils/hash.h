@@ -0,0 +1,43 @@
+//
+// Created by Park Yu on 2024/12/10.
+//
+
+#ifndef PCC_HASH_H
+#define PCC_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HASH_SEED 0xcbf29ce484222325UL
+
+/**
+ * continue a FNV-1a hash over more bytes, hashing a and then b gives the hash of a followed by b.
+ */
+static inline uint64_t hashContinue(uint64_t hash, const char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= 0x100000001b3UL;
+    }
+    return hash;
+}
+
+/**
+ * 64 bit FNV-1a, used by every string keyed table of the compiler.
+ */
+static inline uint64_t hashBytes(const char *data, size_t length) {
+    return hashContinue(HASH_SEED, data, length);
+}
+
+/**
+ * scramble an integer key (splitmix64 finalizer), so the low bits can index a power of two table.
+ */
+static inline uint64_t hashMix64(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9UL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebUL;
+    value ^= value >> 31;
+    return value;
+}
+
+#endif //PCC_HASH_H
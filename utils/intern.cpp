@@ -0,0 +1,132 @@
+//
+// Created by Park Yu on 2024/12/14.
+//
+
+#include <string.h>
+#include "intern.h"
+#include "hash.h"
+#include "mspace.h"
+
+static const char *INTERN_TAG = "intern";
+
+static MemSpace *internSpace = pccCreateSpace(INTERN_TAG);
+
+#define INIT_INTERN_TABLE_CAPACITY 4096
+#define STRING_BLOCK_SIZE 16384
+
+/**
+ * the full hash and the length sit in the slot, a probe only touches the string on a real match.
+ */
+struct InternSlot {
+    uint64_t hash;
+    const char *string;
+    uint32_t length;
+};
+
+struct InternTable {
+    InternSlot *slots;
+    uint32_t capacity;
+};
+
+static InternTable internTable = {nullptr, 0};
+static InternStat internStat;
+static char *stringBlock = nullptr;
+static size_t stringBlockLeft = 0;
+
+static void initInternTable() {
+    internTable.capacity = INIT_INTERN_TABLE_CAPACITY;
+    internTable.slots = pccNewArray<InternSlot>(internSpace, internTable.capacity);
+    internStat = {0, 0, internTable.capacity, 0, 0};
+    stringBlock = nullptr;
+    stringBlockLeft = 0;
+}
+
+static void growInternTable() {
+    InternSlot *oldSlots = internTable.slots;
+    uint32_t oldCapacity = internTable.capacity;
+    internTable.capacity = oldCapacity * 2;
+    internTable.slots = pccNewArray<InternSlot>(internSpace, internTable.capacity);
+    uint32_t mask = internTable.capacity - 1;
+    for (uint32_t i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].string == nullptr) {
+            continue;
+        }
+        uint32_t index = oldSlots[i].hash & mask;
+        while (internTable.slots[index].string != nullptr) {
+            index = (index + 1) & mask;
+        }
+        internTable.slots[index] = oldSlots[i];
+    }
+    pccSpaceFree(internSpace, oldSlots);
+    internStat.capacity = internTable.capacity;
+}
+
+static char *copyString(const char *string, size_t length) {
+    size_t size = length + 1;
+    char *copy;
+    if (size > STRING_BLOCK_SIZE / 4) {
+        copy = pccNewArray<char>(internSpace, size);
+    } else {
+        if (size > stringBlockLeft) {
+            stringBlock = pccNewArray<char>(internSpace, STRING_BLOCK_SIZE);
+            stringBlockLeft = STRING_BLOCK_SIZE;
+        }
+        copy = stringBlock;
+        stringBlock += size;
+        stringBlockLeft -= size;
+    }
+    memcpy(copy, string, length);
+    return copy;
+}
+
+const char *internString(const char *string, size_t length) {
+    if (internTable.slots == nullptr) {
+        initInternTable();
+    }
+    internStat.lookups++;
+    uint64_t hash = hashBytes(string, length);
+    uint32_t mask = internTable.capacity - 1;
+    uint32_t index = hash & mask;
+    for (;; index = (index + 1) & mask) {
+        internStat.probes++;
+        InternSlot *slot = &internTable.slots[index];
+        if (slot->string == nullptr) {
+            break;
+        }
+        if (slot->hash == hash && slot->length == length && memcmp(slot->string, string, length) == 0) {
+            return slot->string;
+        }
+    }
+    //load factor stays below 1/2, chains stay short even for names that differ only in a suffix
+    if ((internStat.stringCount + 1) * 2 > internTable.capacity) {
+        growInternTable();
+        mask = internTable.capacity - 1;
+        index = hash & mask;
+        while (internTable.slots[index].string != nullptr) {
+            index = (index + 1) & mask;
+        }
+    }
+    InternSlot *slot = &internTable.slots[index];
+    slot->hash = hash;
+    slot->string = copyString(string, length);
+    slot->length = length;
+    internStat.stringCount++;
+    internStat.stringBytes += length + 1;
+    return slot->string;
+}
+
+const char *internCString(const char *string) {
+    return internString(string, strlen(string));
+}
+
+void getInternStat(InternStat *stat) {
+    *stat = internStat;
+}
+
+void releaseInternMemory() {
+    internTable = {nullptr, 0};
+    internStat = {0, 0, 0, 0, 0};
+    stringBlock = nullptr;
+    stringBlockLeft = 0;
+    pccResetSpace(internSpace);
+}
@@ -0,0 +1,36 @@
+//
+// Created by Park Yu on 2024/12/14.
+//
+
+#ifndef PCC_INTERN_H
+#define PCC_INTERN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct InternStat {
+    //distinct spellings and their bytes, terminators included
+    uint32_t stringCount;
+    uint64_t stringBytes;
+    uint32_t capacity;
+    uint64_t lookups;
+    //slots visited by all lookups, probes / lookups is the average chain length
+    uint64_t probes;
+};
+
+/**
+ * the one copy of a spelling for the whole compilation, null terminated.
+ * every identifier, label and temp name is interned, so later phases compare names by pointer.
+ */
+extern const char *internString(const char *string, size_t length);
+
+extern const char *internCString(const char *string);
+
+extern void getInternStat(InternStat *stat);
+
+/**
+ * drop every interned string, only when no phase holds a name anymore.
+ */
+extern void releaseInternMemory();
+
+#endif //PCC_INTERN_H
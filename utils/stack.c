@@ -17,7 +17,7 @@ struct StackNode {
 };
 
 void push(struct Stack *stack, void *data) {
-    struct StackNode *newNode = (struct StackNode *) pccMalloc(stack->spaceTag, sizeof(struct StackNode));
+    struct StackNode *newNode = (struct StackNode *) pccSpaceAlloc(stack->space, sizeof(struct StackNode));
     newNode->data = data;
     newNode->next = NULL;
 
@@ -44,7 +44,7 @@ void *pop(struct Stack *stack) {
 
     stack->stackTop = topNode->next;
 
-    pccFree(stack->spaceTag, topNode);
+    pccSpaceFree(stack->space, topNode);
     stack->stackSize--;
     return data;
 }
@@ -78,9 +78,9 @@ void *iteratorNext(struct Stack *stack) {
     return result;
 }
 
-struct Stack *createStack(const char *spaceTag) {
-    struct Stack *stack = (struct Stack *) pccMalloc(spaceTag, sizeof(struct Stack));
-    stack->spaceTag = spaceTag;
+struct Stack *createStack(struct MemSpace *space) {
+    struct Stack *stack = (struct Stack *) pccSpaceAlloc(space, sizeof(struct Stack));
+    stack->space = space;
     stack->push = push;
     stack->top = top;
     stack->pop = pop;
@@ -10,9 +10,10 @@ extern "C" {
 #endif
 
 struct StackNode;
+struct MemSpace;
 
 struct Stack {
-    const char *spaceTag;
+    struct MemSpace *space;
     struct StackNode *stackTop;
     struct StackNode *it;
     int stackSize;
@@ -32,7 +33,7 @@ struct Stack {
     void *(*iteratorNext)(struct Stack *stack);
 };
 
-struct Stack *createStack(const char *spaceTag);
+struct Stack *createStack(struct MemSpace *space);
 
 #ifdef __cplusplus
 }
@@ -39,7 +39,8 @@ OptionalHeader *createOptionalHeader(uint16_t numberOfSections,
                                      uint32_t entryPoint,
                                      uint64_t imageBase,
                                      uint32_t sectionAlignment,
-                                     uint32_t fileAlignment) {
+                                     uint32_t fileAlignment,
+                                     uint32_t sizeOfImage) {
     // 分配可选头内存
     OptionalHeader *optionalHeader = (OptionalHeader *) malloc(sizeof(OptionalHeader));
     if (optionalHeader == nullptr) {
@@ -71,7 +72,7 @@ OptionalHeader *createOptionalHeader(uint16_t numberOfSections,
     optionalHeader->majorSubsystemVersion = 6; // subsystem major version
     optionalHeader->minorSubsystemVersion = 2; // subsystem minor version
     optionalHeader->win32VersionValue = 0; // Reserved, must be 0
-    optionalHeader->sizeOfImage = 0x2000; // size of image fixme
+    optionalHeader->sizeOfImage = sizeOfImage; // size of image, known after layout
     optionalHeader->sizeOfHeaders = getPeHeaderSize(); // size of headers
     optionalHeader->checkSum = 0; // Checksum (can be 0 if unused)
     optionalHeader->subsystem = 3; // subsystem (3 = Windows CUI)
@@ -124,14 +125,16 @@ void *createPeHeader(uint16_t machine,
                      uint32_t entryPoint,
                      uint64_t imageBase,
                      uint32_t sectionAlignment,
-                     uint32_t fileAlignment) {
+                     uint32_t fileAlignment,
+                     uint32_t sizeOfImage) {
     CoffHeader *coffHeader = createCoffHeader(machine, numberOfSections);
     OptionalHeader *optionalHeader = createOptionalHeader(numberOfSections,
                                                           sizeOfCode,
                                                           entryPoint,
                                                           imageBase,
                                                           sectionAlignment,
-                                                          fileAlignment);
+                                                          fileAlignment,
+                                                          sizeOfImage);
     // 返回复合头部（用户可以自行整合到文件中）
     void *peHeader = malloc(getPeHeaderSize());
     memcpy(peHeader, DOS_HEADER, DOS_HEADER_LENGTH);
@@ -195,7 +195,8 @@ void *createPeHeader(uint16_t machine,
                      uint32_t entryPoint,
                      uint64_t imageBase,
                      uint32_t sectionAlignment,
-                     uint32_t fileAlignment);
+                     uint32_t fileAlignment,
+                     uint32_t sizeOfImage);
 
 // 创建并填充节表的方法
 SectionHeader *createSectionHeader(const char *name,